@@ -0,0 +1,204 @@
+#include "barrier_tracker.hpp"
+#include <stdexcept>
+
+auto imageUseInfo( ImageUse use ) -> ImageUseInfo
+{
+  switch ( use )
+  {
+    case ImageUse::ColorAttachment:
+      return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+               VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+               VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+               true };
+    case ImageUse::DepthAttachment:
+      return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+               VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+               VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+               true };
+    case ImageUse::FragmentShaderRead:
+      return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+               VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+               false };
+    case ImageUse::TransferSrc:
+      return {
+        VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false };
+    case ImageUse::TransferDst:
+      return {
+        VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true };
+    case ImageUse::Present:
+      // the present semaphore orders everything after the transition, nothing to wait for on this queue
+      return { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false };
+  }
+  throw std::runtime_error( "unknown image use" );
+}
+
+void BarrierTracker::track( VkImage image,
+                            VkImageAspectFlags aspect,
+                            uint32_t mipLevels,
+                            uint32_t arrayLayers,
+                            VkImageLayout layout )
+{
+  TrackedImage tracked{ aspect, mipLevels, arrayLayers, {} };
+  tracked.subresources.assign( static_cast<size_t>( mipLevels ) * arrayLayers, SubresourceState{ layout } );
+  m_images[image] = std::move( tracked );
+}
+
+void BarrierTracker::forget( VkImage image )
+{
+  m_images.erase( image );
+}
+
+void BarrierTracker::discard( VkImage image, VkPipelineStageFlags2 waitStage, VkAccessFlags2 waitAccess )
+{
+  // the previous accesses still have to finish before the next write, only the layout is given up
+  for ( auto& state : m_images.at( image ).subresources )
+  {
+    state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    state.writeStage |= waitStage;
+    state.writeAccess |= waitAccess;
+  }
+}
+
+void BarrierTracker::use( VkImage image, ImageUse use )
+{
+  const auto& tracked = m_images.at( image );
+  this->use( image, use, { tracked.aspect, 0, tracked.mipLevels, 0, tracked.arrayLayers } );
+}
+
+void BarrierTracker::use( VkImage image, ImageUse use, const VkImageSubresourceRange& range )
+{
+  auto& tracked = m_images.at( image );
+  auto info = imageUseInfo( use );
+
+  auto levelCount =
+    range.levelCount == VK_REMAINING_MIP_LEVELS ? tracked.mipLevels - range.baseMipLevel : range.levelCount;
+  auto layerCount =
+    range.layerCount == VK_REMAINING_ARRAY_LAYERS ? tracked.arrayLayers - range.baseArrayLayer : range.layerCount;
+
+  bool anyBarrier = false;
+  for ( uint32_t layer = range.baseArrayLayer; layer < range.baseArrayLayer + layerCount; layer++ )
+  {
+    auto* states = &tracked.subresources[static_cast<size_t>( layer ) * tracked.mipLevels];
+
+    // mips that were in the same state before share a barrier
+    uint32_t runStart = 0;
+    uint32_t runCount = 0;
+    SubresourceState runBefore{};
+    for ( uint32_t mip = range.baseMipLevel; mip < range.baseMipLevel + levelCount; mip++ )
+    {
+      auto& state = states[mip];
+      bool transition = state.layout != info.layout || info.write;
+      if ( !transition && ( info.stage & ~state.visibleStages ) == 0 )
+      {
+        // read after read in the same layout, the write before is already visible to this stage
+        state.readStages |= info.stage;
+        continue;
+      }
+
+      if ( runCount > 0 && ( state != runBefore || runStart + runCount != mip ) )
+      {
+        queueBarrier( image, tracked, runBefore, use, runStart, runCount, layer );
+        runCount = 0;
+      }
+      if ( runCount == 0 )
+      {
+        runStart = mip;
+        runBefore = state;
+      }
+      runCount++;
+      anyBarrier = true;
+
+      if ( info.write )
+      {
+        state = { info.layout, info.stage, info.access, info.stage, VK_PIPELINE_STAGE_2_NONE };
+      }
+      else if ( transition )
+      {
+        state = { info.layout, info.stage, VK_ACCESS_2_NONE, info.stage, info.stage };
+      }
+      else
+      {
+        state.visibleStages |= info.stage;
+        state.readStages |= info.stage;
+      }
+    }
+    if ( runCount > 0 )
+    {
+      queueBarrier( image, tracked, runBefore, use, runStart, runCount, layer );
+    }
+  }
+
+  if ( !anyBarrier )
+  {
+    m_stats.elided++;
+  }
+}
+
+void BarrierTracker::flush( VkCommandBuffer cmd )
+{
+  if ( m_pending.empty() )
+    return;
+
+  VkDependencyInfo dependency{};
+  dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+  dependency.imageMemoryBarrierCount = static_cast<uint32_t>( m_pending.size() );
+  dependency.pImageMemoryBarriers = m_pending.data();
+  vkCmdPipelineBarrier2( cmd, &dependency );
+
+  m_stats.barriers += m_pending.size();
+  m_stats.batches++;
+  m_pending.clear();
+}
+
+auto BarrierTracker::layout( VkImage image, uint32_t mipLevel, uint32_t arrayLayer ) const -> VkImageLayout
+{
+  const auto& tracked = m_images.at( image );
+  return tracked.subresources.at( static_cast<size_t>( arrayLayer ) * tracked.mipLevels + mipLevel ).layout;
+}
+
+auto BarrierTracker::stats() const -> BarrierStats
+{
+  return m_stats;
+}
+
+void BarrierTracker::queueBarrier( VkImage image,
+                                   const TrackedImage& tracked,
+                                   const SubresourceState& before,
+                                   ImageUse use,
+                                   uint32_t mipLevel,
+                                   uint32_t levelCount,
+                                   uint32_t arrayLayer )
+{
+  auto info = imageUseInfo( use );
+  bool transition = before.layout != info.layout || info.write;
+
+  VkImageMemoryBarrier2 barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+  // writes and layout changes wait for the readers as well, a new reader only for the last write
+  barrier.srcStageMask = transition ? before.writeStage | before.readStages : before.writeStage;
+  barrier.srcAccessMask = before.writeAccess;
+  barrier.dstStageMask = info.stage;
+  barrier.dstAccessMask = info.access;
+  barrier.oldLayout = before.layout;
+  barrier.newLayout = info.layout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = { tracked.aspect, mipLevel, levelCount, arrayLayer, 1 };
+
+  if ( !m_pending.empty() )
+  {
+    auto& last = m_pending.back();
+    auto& lastRange = last.subresourceRange;
+    if ( last.image == image && lastRange.baseMipLevel == mipLevel && lastRange.levelCount == levelCount &&
+         lastRange.baseArrayLayer + lastRange.layerCount == arrayLayer && last.srcStageMask == barrier.srcStageMask &&
+         last.srcAccessMask == barrier.srcAccessMask && last.dstStageMask == barrier.dstStageMask &&
+         last.oldLayout == barrier.oldLayout && last.newLayout == barrier.newLayout )
+    {
+      lastRange.layerCount++;
+      return;
+    }
+  }
+  m_pending.push_back( barrier );
+}
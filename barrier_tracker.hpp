@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// what the next commands do with an image, each use maps to a fixed stage, access and layout
+enum class ImageUse
+{
+  ColorAttachment,
+  DepthAttachment,
+  FragmentShaderRead,
+  TransferSrc,
+  TransferDst,
+  Present,
+};
+
+struct ImageUseInfo
+{
+  VkPipelineStageFlags2 stage;
+  VkAccessFlags2 access;
+  VkImageLayout layout;
+  bool write;
+};
+
+auto imageUseInfo( ImageUse use ) -> ImageUseInfo;
+
+struct BarrierStats
+{
+  // image barriers handed to the driver and the vkCmdPipelineBarrier2 calls they went out in
+  uint64_t barriers;
+  uint64_t batches;
+  // uses that needed no barrier, reads of a layout the stage already sees
+  uint64_t elided;
+};
+
+// knows the layout and the last access of every subresource of the images it tracks, a use only queues the barriers
+// the previous state calls for and flush() records everything queued since the last flush in a single
+// vkCmdPipelineBarrier2
+//
+// the state carries over between command buffers, so they have to be recorded in the order they are submitted, all
+// calls belong to the thread that records the frames
+class BarrierTracker
+{
+public:
+  // layout is what the image is in right now, undefined for a freshly created one
+  void track( VkImage image,
+              VkImageAspectFlags aspect,
+              uint32_t mipLevels = 1,
+              uint32_t arrayLayers = 1,
+              VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED );
+  void forget( VkImage image );
+  // the contents are not needed anymore, the next use transitions from undefined, waitStage is where a semaphore
+  // handing the image over was waited on, like the acquire of a swapchain image, waitAccess are writes to the same
+  // memory through another image that aliases it
+  void discard( VkImage image,
+                VkPipelineStageFlags2 waitStage = VK_PIPELINE_STAGE_2_NONE,
+                VkAccessFlags2 waitAccess = VK_ACCESS_2_NONE );
+
+  // at most one use per subresource between two flushes
+  void use( VkImage image, ImageUse use );
+  void use( VkImage image, ImageUse use, const VkImageSubresourceRange& range );
+  void flush( VkCommandBuffer cmd );
+
+  auto layout( VkImage image, uint32_t mipLevel = 0, uint32_t arrayLayer = 0 ) const -> VkImageLayout;
+  auto stats() const -> BarrierStats;
+
+private:
+  struct SubresourceState
+  {
+    VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+    // stage and access of the last write, a layout transition counts as one without an access
+    VkPipelineStageFlags2 writeStage{ VK_PIPELINE_STAGE_2_NONE };
+    VkAccessFlags2 writeAccess{ VK_ACCESS_2_NONE };
+    // stages the last write is already visible to
+    VkPipelineStageFlags2 visibleStages{ VK_PIPELINE_STAGE_2_NONE };
+    // stages that read since the last write, the next write waits for them
+    VkPipelineStageFlags2 readStages{ VK_PIPELINE_STAGE_2_NONE };
+
+    bool operator==( const SubresourceState& ) const = default;
+  };
+
+  struct TrackedImage
+  {
+    VkImageAspectFlags aspect;
+    uint32_t mipLevels;
+    uint32_t arrayLayers;
+    // mip major within a layer
+    std::vector<SubresourceState> subresources;
+  };
+
+  // appends the barrier for a run of mips or widens the previous one when it covers the same mips of the layer before
+  void queueBarrier( VkImage image,
+                     const TrackedImage& tracked,
+                     const SubresourceState& before,
+                     ImageUse use,
+                     uint32_t mipLevel,
+                     uint32_t levelCount,
+                     uint32_t arrayLayer );
+
+  std::unordered_map<VkImage, TrackedImage> m_images;
+  std::vector<VkImageMemoryBarrier2> m_pending;
+  BarrierStats m_stats{};
+};
@@ -0,0 +1,391 @@
+#include "bc_encoder.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include "worker_pool.hpp"
+
+namespace
+{
+constexpr uint32_t blockTexels = 16;
+
+// appends bit fields to a block starting at the least significant bit of the first byte
+class BitWriter
+{
+public:
+  explicit BitWriter( uint8_t* out ) : m_out( out ) {}
+
+  void write( uint32_t value, uint32_t bits )
+  {
+    for ( uint32_t i = 0; i < bits; i++, m_position++ )
+    {
+      if ( value & ( 1u << i ) )
+        m_out[m_position / 8] |= static_cast<uint8_t>( 1u << ( m_position % 8 ) );
+    }
+  }
+
+private:
+  uint8_t* m_out;
+  uint32_t m_position{ 0u };
+};
+
+// direction the texels spread the most along, power iteration over the covariance of the first Channels channels
+template <size_t Channels>
+void principalAxis( const uint8_t* texels,
+                    std::array<float, Channels>& mean,
+                    std::array<float, Channels>& axis )
+{
+  mean.fill( 0.0f );
+  for ( uint32_t i = 0; i < blockTexels; i++ )
+  {
+    for ( size_t c = 0; c < Channels; c++ )
+      mean[c] += texels[i * 4 + c];
+  }
+  for ( auto& value : mean )
+    value /= blockTexels;
+
+  std::array<std::array<float, Channels>, Channels> covariance{};
+  for ( uint32_t i = 0; i < blockTexels; i++ )
+  {
+    std::array<float, Channels> d{};
+    for ( size_t c = 0; c < Channels; c++ )
+      d[c] = texels[i * 4 + c] - mean[c];
+    for ( size_t a = 0; a < Channels; a++ )
+    {
+      for ( size_t b = 0; b < Channels; b++ )
+        covariance[a][b] += d[a] * d[b];
+    }
+  }
+
+  axis.fill( 1.0f );
+  for ( int iteration = 0; iteration < 8; iteration++ )
+  {
+    std::array<float, Channels> next{};
+    for ( size_t a = 0; a < Channels; a++ )
+    {
+      for ( size_t b = 0; b < Channels; b++ )
+        next[a] += covariance[a][b] * axis[b];
+    }
+
+    float length = 0.0f;
+    for ( auto value : next )
+      length += value * value;
+    // a flat block has no direction, any axis projects it onto one point
+    if ( length < 1e-12f )
+      return;
+
+    length = std::sqrt( length );
+    for ( size_t c = 0; c < Channels; c++ )
+      axis[c] = next[c] / length;
+  }
+}
+
+// the two points on the principal axis that enclose every texel of the block
+template <size_t Channels>
+void axisEndpoints( const uint8_t* texels, std::array<float, Channels>& low, std::array<float, Channels>& high )
+{
+  std::array<float, Channels> mean{};
+  std::array<float, Channels> axis{};
+  principalAxis<Channels>( texels, mean, axis );
+
+  float minProjection = 0.0f;
+  float maxProjection = 0.0f;
+  for ( uint32_t i = 0; i < blockTexels; i++ )
+  {
+    float projection = 0.0f;
+    for ( size_t c = 0; c < Channels; c++ )
+      projection += ( texels[i * 4 + c] - mean[c] ) * axis[c];
+    minProjection = std::min( minProjection, projection );
+    maxProjection = std::max( maxProjection, projection );
+  }
+
+  for ( size_t c = 0; c < Channels; c++ )
+  {
+    low[c] = std::clamp( mean[c] + axis[c] * minProjection, 0.0f, 255.0f );
+    high[c] = std::clamp( mean[c] + axis[c] * maxProjection, 0.0f, 255.0f );
+  }
+}
+
+auto to565( const std::array<float, 3>& color ) -> uint16_t
+{
+  auto r = static_cast<uint32_t>( color[0] * 31.0f / 255.0f + 0.5f );
+  auto g = static_cast<uint32_t>( color[1] * 63.0f / 255.0f + 0.5f );
+  auto b = static_cast<uint32_t>( color[2] * 31.0f / 255.0f + 0.5f );
+  return static_cast<uint16_t>( ( r << 11 ) | ( g << 5 ) | b );
+}
+
+auto from565( uint16_t color ) -> std::array<int32_t, 3>
+{
+  auto r = ( color >> 11 ) & 31;
+  auto g = ( color >> 5 ) & 63;
+  auto b = color & 31;
+  return { ( r << 3 ) | ( r >> 2 ), ( g << 2 ) | ( g >> 4 ), ( b << 3 ) | ( b >> 2 ) };
+}
+
+// always the four color mode, BC3 ignores the endpoint order and BC1 without alpha never needs the other one
+void encodeColorBlock( const uint8_t* texels, uint8_t* out )
+{
+  std::array<float, 3> low{};
+  std::array<float, 3> high{};
+  axisEndpoints<3>( texels, low, high );
+
+  auto color0 = to565( high );
+  auto color1 = to565( low );
+  if ( color0 < color1 )
+    std::swap( color0, color1 );
+
+  uint32_t indices = 0;
+  if ( color0 != color1 )
+  {
+    auto c0 = from565( color0 );
+    auto c1 = from565( color1 );
+    std::array<std::array<int32_t, 3>, 4> palette{};
+    for ( size_t c = 0; c < 3; c++ )
+    {
+      palette[0][c] = c0[c];
+      palette[1][c] = c1[c];
+      palette[2][c] = ( 2 * c0[c] + c1[c] ) / 3;
+      palette[3][c] = ( c0[c] + 2 * c1[c] ) / 3;
+    }
+
+    for ( uint32_t i = 0; i < blockTexels; i++ )
+    {
+      uint32_t best = 0;
+      int32_t bestError = INT32_MAX;
+      for ( uint32_t p = 0; p < 4; p++ )
+      {
+        int32_t error = 0;
+        for ( size_t c = 0; c < 3; c++ )
+        {
+          auto d = texels[i * 4 + c] - palette[p][c];
+          error += d * d;
+        }
+        if ( error < bestError )
+        {
+          best = p;
+          bestError = error;
+        }
+      }
+      indices |= best << ( i * 2 );
+    }
+  }
+
+  memcpy( out, &color0, 2 );
+  memcpy( out + 2, &color1, 2 );
+  memcpy( out + 4, &indices, 4 );
+}
+
+// one channel in 8 bytes, always the eight value mode
+void encodeChannelBlock( const uint8_t* texels, uint32_t channel, uint8_t* out )
+{
+  uint8_t high = 0;
+  uint8_t low = 255;
+  for ( uint32_t i = 0; i < blockTexels; i++ )
+  {
+    high = std::max( high, texels[i * 4 + channel] );
+    low = std::min( low, texels[i * 4 + channel] );
+  }
+
+  // code 0 and 1 are the endpoints, 2 to 7 step from the first towards the second
+  std::array<int32_t, 8> palette{ high, low };
+  for ( int32_t k = 1; k < 7; k++ )
+    palette[k + 1] = ( ( 7 - k ) * high + k * low ) / 7;
+
+  uint64_t indices = 0;
+  if ( high != low )
+  {
+    for ( uint32_t i = 0; i < blockTexels; i++ )
+    {
+      uint64_t best = 0;
+      int32_t bestError = INT32_MAX;
+      for ( uint32_t p = 0; p < 8; p++ )
+      {
+        auto error = std::abs( texels[i * 4 + channel] - palette[p] );
+        if ( error < bestError )
+        {
+          best = p;
+          bestError = error;
+        }
+      }
+      indices |= best << ( i * 3 );
+    }
+  }
+
+  out[0] = high;
+  out[1] = low;
+  for ( uint32_t i = 0; i < 6; i++ )
+    out[2 + i] = static_cast<uint8_t>( indices >> ( i * 8 ) );
+}
+
+// mode 6, one subset of rgba endpoints with 7 bits and a shared p bit each, 4 bit indices
+void encodeBc7Block( const uint8_t* texels, uint8_t* out )
+{
+  constexpr std::array<int32_t, 16> weights = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+  std::array<float, 4> low{};
+  std::array<float, 4> high{};
+  axisEndpoints<4>( texels, low, high );
+
+  // the p bit is the lowest bit of all four channels of an endpoint, whichever of the two lands closer wins
+  auto quantize = []( const std::array<float, 4>& endpoint, std::array<uint32_t, 4>& value, uint32_t& pBit ) {
+    float bestError = 1e30f;
+    for ( uint32_t p = 0; p < 2; p++ )
+    {
+      std::array<uint32_t, 4> candidate{};
+      float error = 0.0f;
+      for ( size_t c = 0; c < 4; c++ )
+      {
+        auto v = std::clamp( static_cast<int32_t>( std::lround( ( endpoint[c] - p ) / 2.0f ) ), 0, 127 );
+        candidate[c] = static_cast<uint32_t>( v );
+        auto d = endpoint[c] - static_cast<float>( ( v << 1 ) | p );
+        error += d * d;
+      }
+      if ( error < bestError )
+      {
+        bestError = error;
+        value = candidate;
+        pBit = p;
+      }
+    }
+  };
+
+  std::array<uint32_t, 4> e0{};
+  std::array<uint32_t, 4> e1{};
+  uint32_t p0 = 0;
+  uint32_t p1 = 0;
+  quantize( low, e0, p0 );
+  quantize( high, e1, p1 );
+
+  std::array<std::array<int32_t, 4>, 16> palette{};
+  for ( size_t c = 0; c < 4; c++ )
+  {
+    auto a = static_cast<int32_t>( ( e0[c] << 1 ) | p0 );
+    auto b = static_cast<int32_t>( ( e1[c] << 1 ) | p1 );
+    for ( size_t w = 0; w < weights.size(); w++ )
+      palette[w][c] = ( ( 64 - weights[w] ) * a + weights[w] * b + 32 ) >> 6;
+  }
+
+  std::array<uint32_t, 16> indices{};
+  for ( uint32_t i = 0; i < blockTexels; i++ )
+  {
+    int32_t bestError = INT32_MAX;
+    for ( uint32_t p = 0; p < palette.size(); p++ )
+    {
+      int32_t error = 0;
+      for ( size_t c = 0; c < 4; c++ )
+      {
+        auto d = texels[i * 4 + c] - palette[p][c];
+        error += d * d;
+      }
+      if ( error < bestError )
+      {
+        indices[i] = p;
+        bestError = error;
+      }
+    }
+  }
+
+  // the first index is stored without its top bit, swapping the endpoints mirrors the indices to make it 0
+  if ( indices[0] & 8 )
+  {
+    std::swap( e0, e1 );
+    std::swap( p0, p1 );
+    for ( auto& index : indices )
+      index = 15 - index;
+  }
+
+  memset( out, 0, 16 );
+  BitWriter writer{ out };
+  writer.write( 1u << 6, 7 );
+  for ( size_t c = 0; c < 4; c++ )
+  {
+    writer.write( e0[c], 7 );
+    writer.write( e1[c], 7 );
+  }
+  writer.write( p0, 1 );
+  writer.write( p1, 1 );
+  for ( uint32_t i = 0; i < blockTexels; i++ )
+    writer.write( indices[i], i == 0 ? 3 : 4 );
+}
+} // namespace
+
+auto blockBytes( BlockFormat format ) -> uint32_t
+{
+  return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+auto blockVkFormat( BlockFormat format, bool srgb ) -> VkFormat
+{
+  switch ( format )
+  {
+    case BlockFormat::BC1:
+      return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case BlockFormat::BC3:
+      return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case BlockFormat::BC5:
+      return VK_FORMAT_BC5_UNORM_BLOCK;
+    case BlockFormat::BC7:
+      return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+  }
+  throw std::runtime_error( "unknown block format" );
+}
+
+void encodeBlock( BlockFormat format, const uint8_t* texels, uint8_t* out )
+{
+  switch ( format )
+  {
+    case BlockFormat::BC1:
+      encodeColorBlock( texels, out );
+      return;
+    case BlockFormat::BC3:
+      encodeChannelBlock( texels, 3, out );
+      encodeColorBlock( texels, out + 8 );
+      return;
+    case BlockFormat::BC5:
+      encodeChannelBlock( texels, 0, out );
+      encodeChannelBlock( texels, 1, out + 8 );
+      return;
+    case BlockFormat::BC7:
+      encodeBc7Block( texels, out );
+      return;
+  }
+  throw std::runtime_error( "unknown block format" );
+}
+
+auto encodeImage( BlockFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, WorkerPool* pool )
+  -> std::vector<uint8_t>
+{
+  auto blocksWide = ( width + 3 ) / 4;
+  auto blocksHigh = ( height + 3 ) / 4;
+  auto bytes = blockBytes( format );
+  std::vector<uint8_t> encoded( static_cast<size_t>( blocksWide ) * blocksHigh * bytes );
+
+  auto encodeRow = [&]( size_t blockRow ) {
+    std::array<uint8_t, blockTexels * 4> texels{};
+    for ( uint32_t blockColumn = 0; blockColumn < blocksWide; blockColumn++ )
+    {
+      for ( uint32_t y = 0; y < 4; y++ )
+      {
+        auto row = std::min<uint32_t>( static_cast<uint32_t>( blockRow ) * 4 + y, height - 1 );
+        for ( uint32_t x = 0; x < 4; x++ )
+        {
+          auto column = std::min( blockColumn * 4 + x, width - 1 );
+          memcpy( &texels[( y * 4 + x ) * 4], pixels + ( static_cast<size_t>( row ) * width + column ) * 4, 4 );
+        }
+      }
+      encodeBlock( format, texels.data(), &encoded[( blockRow * blocksWide + blockColumn ) * bytes] );
+    }
+  };
+
+  if ( pool )
+  {
+    pool->parallelFor( blocksHigh, encodeRow );
+  }
+  else
+  {
+    for ( size_t blockRow = 0; blockRow < blocksHigh; blockRow++ )
+      encodeRow( blockRow );
+  }
+  return encoded;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+class WorkerPool;
+
+// the block compressed formats the texture compressor writes, every block covers 4x4 texels
+enum class BlockFormat
+{
+  // rgb in 8 bytes, alpha is dropped
+  BC1,
+  // BC1 colors plus an 8 byte BC4 alpha block
+  BC3,
+  // two BC4 channels, red and green, for normal maps
+  BC5,
+  // rgba in 16 bytes, mode 6 only
+  BC7,
+};
+
+auto blockBytes( BlockFormat format ) -> uint32_t;
+// BC5 has no srgb variant, it always comes back unorm
+auto blockVkFormat( BlockFormat format, bool srgb ) -> VkFormat;
+
+// texels are rgba8, one 4x4 block row by row, out gets blockBytes( format ) bytes
+void encodeBlock( BlockFormat format, const uint8_t* texels, uint8_t* out );
+// a whole level of rgba8 texels, edge blocks repeat the last row and column, the rows of blocks are spread over the
+// pool when there is one
+auto encodeImage( BlockFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, WorkerPool* pool )
+  -> std::vector<uint8_t>;
@@ -0,0 +1,289 @@
+#define SDL_MAIN_HANDLED
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <glm/gtc/matrix_transform.hpp>
+#include "vulkan_backend.hpp"
+
+#ifndef ASSET_ROOT
+#define ASSET_ROOT ""
+#endif
+
+// renders a fixed set of scenes headless and writes p50/p95/p99 timings as json, renderer changes get gated on it
+constexpr const char* usage = "usage: enttTest_bench [--warmup N] [--frames N] [--size WxH] [--out bench_results.json]";
+
+struct BenchScene
+{
+  const char* name;
+  uint32_t meshes;
+  // every draw is a plane of cells x cells quads, 0 draws the demo quads
+  uint32_t cells;
+  // distinct textures the draws cycle through, only the bindless pipelines sample more than the scene texture
+  uint32_t textures;
+  VertexLayout layout{ VertexLayout::Standard };
+};
+
+// from a few heavy meshes to many light ones over a growing texture set, the compact scenes draw the same grids as
+// their standard twins so the difference is the vertex fetch bandwidth
+constexpr BenchScene benchScenes[] = { { "quads", 1, 0, 1 },
+                                       { "meshes_1k", 1000, 32, 4 },
+                                       { "meshes_10k", 10000, 8, 16 },
+                                       { "meshes_50k", 50000, 2, 64 },
+                                       { "meshes_10k_compact", 10000, 8, 16, VertexLayout::Compact },
+                                       { "meshes_50k_compact", 50000, 2, 64, VertexLayout::Compact } };
+
+struct BenchMesh
+{
+  std::vector<Vertex> vertices;
+  std::vector<uint16_t> indices;
+};
+
+struct Percentiles
+{
+  double p50;
+  double p95;
+  double p99;
+};
+
+// the size of one demo quad facing +z, the texture is stretched over the whole plane
+static auto makePlane( uint32_t cells ) -> BenchMesh
+{
+  BenchMesh mesh;
+  auto side = cells + 1;
+  for ( uint32_t y = 0; y < side; y++ )
+  {
+    for ( uint32_t x = 0; x < side; x++ )
+    {
+      auto u = static_cast<float>( x ) / cells;
+      auto v = static_cast<float>( y ) / cells;
+      mesh.vertices.push_back( { { u - 0.5f, v - 0.5f, 0.0f }, { u, v, 1.0f - u }, { u, v } } );
+    }
+  }
+
+  for ( uint32_t y = 0; y < cells; y++ )
+  {
+    for ( uint32_t x = 0; x < cells; x++ )
+    {
+      auto corner = static_cast<uint16_t>( y * side + x );
+      auto above = static_cast<uint16_t>( corner + side );
+      mesh.indices.insert( mesh.indices.end(),
+                           { corner,
+                             static_cast<uint16_t>( corner + 1 ),
+                             static_cast<uint16_t>( above + 1 ),
+                             static_cast<uint16_t>( above + 1 ),
+                             above,
+                             corner } );
+    }
+  }
+  return mesh;
+}
+
+static auto makeGrid( MeshHandle mesh, uint32_t meshes, const std::vector<TextureHandle>& textures )
+  -> std::vector<DrawCommand>
+{
+  if ( meshes == 1 )
+    return { DrawCommand{ mesh, glm::mat4( 1.0f ), textures.front() } };
+
+  // square grid over the area the demo quads cover, every cell holds a scaled down copy of the mesh
+  auto side = static_cast<uint32_t>( std::ceil( std::sqrt( static_cast<double>( meshes ) ) ) );
+  auto cell = 2.0f / static_cast<float>( side );
+
+  std::vector<DrawCommand> draws;
+  draws.reserve( meshes );
+  for ( uint32_t i = 0; i < meshes; i++ )
+  {
+    auto x = static_cast<float>( i % side );
+    auto y = static_cast<float>( i / side );
+    auto model = glm::translate( glm::mat4( 1.0f ),
+                                 glm::vec3( -1.0f + cell * ( x + 0.5f ), -1.0f + cell * ( y + 0.5f ), 0.0f ) );
+    draws.push_back( DrawCommand{ mesh, glm::scale( model, glm::vec3( cell ) ), textures[i % textures.size()] } );
+  }
+  return draws;
+}
+
+static auto summarize( std::vector<double> samples ) -> Percentiles
+{
+  return { percentile( samples, 50.0 ), percentile( samples, 95.0 ), percentile( samples, 99.0 ) };
+}
+
+// quoted, with the characters json does not allow raw escaped
+static void writeString( std::ostream& out, std::string_view text )
+{
+  out << '"';
+  for ( auto c : text )
+  {
+    if ( c == '"' || c == '\\' )
+      out << '\\' << c;
+    else if ( static_cast<unsigned char>( c ) < 0x20 )
+    {
+      constexpr char hex[] = "0123456789abcdef";
+      out << "\\u00" << hex[( c >> 4 ) & 0xf] << hex[c & 0xf];
+    }
+    else
+      out << c;
+  }
+  out << '"';
+}
+
+static void writePercentiles( std::ostream& out, const char* key, const std::vector<double>& samples )
+{
+  out << "      \"" << key << "\": ";
+  if ( samples.empty() )
+  {
+    out << "null";
+    return;
+  }
+
+  auto summary = summarize( samples );
+  out << "{ \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99 << " }";
+}
+
+int main( int argc, char** argv )
+{
+  try
+  {
+    uint32_t warmupFrames{ 64u };
+    uint32_t measuredFrames{ 256u };
+    std::string outPath{ "bench_results.json" };
+    HeadlessConfig config{};
+
+    for ( int i = 1; i < argc; i += 2 )
+    {
+      std::string_view arg{ argv[i] };
+      if ( i + 1 == argc )
+      {
+        throw std::runtime_error( std::string( arg ) + " has no value\n" + usage );
+      }
+      std::string value{ argv[i + 1] };
+      if ( arg == "--warmup" )
+        warmupFrames = static_cast<uint32_t>( std::stoul( value ) );
+      else if ( arg == "--frames" )
+        measuredFrames = static_cast<uint32_t>( std::stoul( value ) );
+      else if ( arg == "--size" )
+      {
+        auto separator = value.find( 'x' );
+        if ( separator == std::string::npos || separator == 0 || separator + 1 == value.size() )
+        {
+          throw std::runtime_error( "--size expects WxH, got " + value + "\n" + usage );
+        }
+        config.width = static_cast<uint32_t>( std::stoul( value.substr( 0, separator ) ) );
+        config.height = static_cast<uint32_t>( std::stoul( value.substr( separator + 1 ) ) );
+      }
+      else if ( arg == "--out" )
+        outPath = value;
+      else
+        std::cout << "ignoring argument " << arg << "\n";
+    }
+
+    // the frame slots grow their uniform buffers to the larger scenes during the warm-up frames
+    VulkanBase base{};
+    base.setHeadless( config );
+    base.setFixedTimestep( 1.0f / 60.0f );
+    base.initVulkan();
+
+    std::ofstream out( outPath );
+    if ( !out.is_open() )
+    {
+      throw std::runtime_error( "could not open " + outPath );
+    }
+
+    out << "{\n  \"device\": ";
+    writeString( out, base.deviceName() );
+    out << ",\n  \"width\": " << config.width
+        << ",\n  \"height\": " << config.height << ",\n  \"warmup_frames\": " << warmupFrames
+        << ",\n  \"measured_frames\": " << measuredFrames << ",\n  \"scenes\": [\n";
+
+    // separate images of the same file, the sets differ in how many textures a frame binds and keeps resident
+    uint32_t textureCount = 0;
+    for ( const auto& scene : benchScenes )
+      textureCount = std::max( textureCount, scene.textures );
+    std::vector<TextureHandle> textures;
+    for ( uint32_t i = 0; i < textureCount; i++ )
+      textures.push_back( base.loadSceneTexture( ASSET_ROOT "test.jpg" ) );
+
+    for ( size_t s = 0; s < std::size( benchScenes ); s++ )
+    {
+      const auto& scene = benchScenes[s];
+      auto mesh = base.sceneMesh( scene.layout );
+      auto vertexCount = vertices.size();
+      if ( scene.cells > 0 )
+      {
+        auto plane = makePlane( scene.cells );
+        mesh = base.addSceneMesh( plane.vertices, plane.indices, scene.layout );
+        vertexCount = plane.vertices.size();
+      }
+      std::vector<TextureHandle> sceneTextures( textures.begin(), textures.begin() + scene.textures );
+      base.setSceneDraws( makeGrid( mesh, scene.meshes, sceneTextures ) );
+
+      // the decodes of the first scene may outlast the warm-up, nothing is measured against the placeholder
+      for ( uint32_t i = 0; i < warmupFrames || base.textureStats().loadingCount > 0; i++ )
+      {
+        base.drawOffscreenFrame();
+      }
+
+      // gpu results come back a ring depth late, so these trail the cpu samples by a couple of frames
+      auto gpuFrameScope = [&base]() -> const GpuScopeStats* {
+        for ( const auto& scope : base.gpuProfiler().scopes() )
+        {
+          if ( scope.name == "frame" )
+            return &scope;
+        }
+        return nullptr;
+      };
+      auto gpuSeen = gpuFrameScope() ? gpuFrameScope()->total : 0u;
+
+      std::vector<double> cpuMs, recordMs, gpuMs;
+      for ( uint32_t i = 0; i < measuredFrames; i++ )
+      {
+        auto start = std::chrono::steady_clock::now();
+        base.drawOffscreenFrame();
+        auto frameTime = std::chrono::steady_clock::now() - start;
+
+        cpuMs.push_back( std::chrono::duration<double, std::milli>( frameTime ).count() );
+        recordMs.push_back( base.lastRecordMs() );
+
+        auto gpu = gpuFrameScope();
+        if ( gpu && gpu->total != gpuSeen )
+        {
+          // several frames can resolve between two looks, take every one the window still holds
+          auto resolved = std::min<uint64_t>( gpu->total - gpuSeen, gpu->ms.count() );
+          for ( auto age = resolved; age > 0; age-- )
+          {
+            gpuMs.push_back( gpu->ms.recent( age - 1 ) );
+          }
+          gpuSeen = gpu->total;
+        }
+      }
+
+      // derived from the mesh and not measured, every draw fetches each vertex once and the post transform cache takes
+      // care of the shared ones
+      auto vertexBytes = static_cast<uint64_t>( scene.meshes ) * vertexCount * vertexStride( scene.layout );
+      out << "    {\n      \"name\": ";
+      writeString( out, scene.name );
+      out << ",\n      \"meshes\": " << scene.meshes
+          << ",\n      \"vertices_per_mesh\": " << vertexCount << ",\n      \"textures\": " << scene.textures
+          << ",\n      \"derived_vertex_bytes\": " << vertexBytes << ",\n";
+      writePercentiles( out, "cpu_frame_ms", cpuMs );
+      out << ",\n";
+      writePercentiles( out, "record_ms", recordMs );
+      out << ",\n";
+      writePercentiles( out, "gpu_frame_ms", gpuMs );
+      out << "\n    }" << ( s + 1 < std::size( benchScenes ) ? "," : "" ) << "\n";
+
+      spdlog::info( "{}: {} meshes done", scene.name, scene.meshes );
+    }
+
+    out << "  ]\n}\n";
+    spdlog::info( "wrote {}", outPath );
+    base.cleanup();
+  }
+  catch ( std::exception& e )
+  {
+    std::cout << "something went wrong: exception-> " << e.what();
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,202 @@
+#include "bindless_table.hpp"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+
+auto BindlessTable::supported( const VkPhysicalDeviceVulkan12Features& features ) -> bool
+{
+  return features.runtimeDescriptorArray && features.descriptorBindingPartiallyBound &&
+         features.descriptorBindingSampledImageUpdateAfterBind &&
+         features.descriptorBindingStorageBufferUpdateAfterBind && features.descriptorBindingUpdateUnusedWhilePending;
+}
+
+void BindlessTable::enableFeatures( VkPhysicalDeviceVulkan12Features& features )
+{
+  features.runtimeDescriptorArray = VK_TRUE;
+  features.descriptorBindingPartiallyBound = VK_TRUE;
+  features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+  features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+}
+
+void BindlessTable::init(
+  VkDevice device, VkPhysicalDevice physicalDevice, VkSampler sampler, uint32_t maxTextures, uint32_t maxBuffers )
+{
+  m_device = device;
+
+  VkPhysicalDeviceVulkan12Properties limits{};
+  limits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &limits;
+  vkGetPhysicalDeviceProperties2( physicalDevice, &properties );
+
+  m_textureCapacity = std::min( { maxTextures,
+                                  limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                                  limits.maxPerStageDescriptorUpdateAfterBindSampledImages } );
+  m_bufferCapacity = std::min( { maxBuffers,
+                                 limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                 limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers } );
+
+  std::array<VkDescriptorSetLayoutBinding, 3> bindings{
+    VkDescriptorSetLayoutBinding{ .binding = 0,
+                                  .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+                                  .descriptorCount = m_textureCapacity,
+                                  .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT },
+    VkDescriptorSetLayoutBinding{ .binding = 1,
+                                  .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                  .descriptorCount = m_bufferCapacity,
+                                  .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT },
+    VkDescriptorSetLayoutBinding{ .binding = 2,
+                                  .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+                                  .descriptorCount = 1,
+                                  .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+                                  .pImmutableSamplers = &sampler } };
+
+  // slots nobody reads may be empty or rewritten while the set is bound, the sampler never changes
+  constexpr VkDescriptorBindingFlags arrayFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                                  VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                                  VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+  std::array<VkDescriptorBindingFlags, 3> bindingFlags{ arrayFlags, arrayFlags, 0 };
+  VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+  flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  flagsInfo.bindingCount = static_cast<uint32_t>( bindingFlags.size() );
+  flagsInfo.pBindingFlags = bindingFlags.data();
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &flagsInfo;
+  layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  layoutInfo.bindingCount = static_cast<uint32_t>( bindings.size() );
+  layoutInfo.pBindings = bindings.data();
+
+  if ( vkCreateDescriptorSetLayout( m_device, &layoutInfo, nullptr, &m_layout ) != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to create bindless descriptor set layout!" );
+  }
+
+  std::array<VkDescriptorPoolSize, 3> poolSizes{
+    VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, m_textureCapacity },
+    VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_bufferCapacity },
+    VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_SAMPLER, 1 } };
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  poolInfo.poolSizeCount = static_cast<uint32_t>( poolSizes.size() );
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = 1;
+
+  if ( vkCreateDescriptorPool( m_device, &poolInfo, nullptr, &m_pool ) != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to create bindless descriptor pool!" );
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = m_pool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &m_layout;
+
+  if ( vkAllocateDescriptorSets( m_device, &allocInfo, &m_set ) != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to allocate bindless descriptor set!" );
+  }
+}
+
+void BindlessTable::destroy()
+{
+  // the set goes with its pool
+  vkDestroyDescriptorPool( m_device, m_pool, nullptr );
+  vkDestroyDescriptorSetLayout( m_device, m_layout, nullptr );
+  m_pool = VK_NULL_HANDLE;
+  m_layout = VK_NULL_HANDLE;
+  m_set = VK_NULL_HANDLE;
+  m_texturesUsed = 0;
+  m_buffersUsed = 0;
+  m_freeTextures.clear();
+  m_freeBuffers.clear();
+}
+
+auto BindlessTable::addTexture( VkImageView view ) -> BindlessIndex
+{
+  auto index = allocate( m_freeTextures, m_texturesUsed, m_textureCapacity, "texture" );
+
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo.imageView = view;
+
+  VkWriteDescriptorSet write{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                              .dstSet = m_set,
+                              .dstBinding = 0,
+                              .dstArrayElement = index,
+                              .descriptorCount = 1,
+                              .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+                              .pImageInfo = &imageInfo };
+  vkUpdateDescriptorSets( m_device, 1, &write, 0, nullptr );
+  return index;
+}
+
+auto BindlessTable::addBuffer( VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range ) -> BindlessIndex
+{
+  auto index = allocate( m_freeBuffers, m_buffersUsed, m_bufferCapacity, "buffer" );
+
+  VkDescriptorBufferInfo bufferInfo{ buffer, offset, range };
+  VkWriteDescriptorSet write{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                              .dstSet = m_set,
+                              .dstBinding = 1,
+                              .dstArrayElement = index,
+                              .descriptorCount = 1,
+                              .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                              .pBufferInfo = &bufferInfo };
+  vkUpdateDescriptorSets( m_device, 1, &write, 0, nullptr );
+  return index;
+}
+
+void BindlessTable::removeTexture( BindlessIndex index )
+{
+  // the descriptor stays as it is, partially bound slots may hold anything nobody reads
+  m_freeTextures.push_back( index );
+}
+
+void BindlessTable::removeBuffer( BindlessIndex index )
+{
+  m_freeBuffers.push_back( index );
+}
+
+auto BindlessTable::layout() const -> VkDescriptorSetLayout
+{
+  return m_layout;
+}
+
+auto BindlessTable::set() const -> VkDescriptorSet
+{
+  return m_set;
+}
+
+auto BindlessTable::stats() const -> BindlessStats
+{
+  return { m_texturesUsed - static_cast<uint32_t>( m_freeTextures.size() ),
+           m_textureCapacity,
+           m_buffersUsed - static_cast<uint32_t>( m_freeBuffers.size() ),
+           m_bufferCapacity };
+}
+
+auto BindlessTable::allocate( std::vector<BindlessIndex>& freeSlots,
+                              uint32_t& used,
+                              uint32_t capacity,
+                              const char* what ) -> BindlessIndex
+{
+  if ( !freeSlots.empty() )
+  {
+    auto index = freeSlots.back();
+    freeSlots.pop_back();
+    return index;
+  }
+  if ( used == capacity )
+  {
+    throw std::runtime_error( std::string{ "bindless " } + what + " table is full!" );
+  }
+  return used++;
+}
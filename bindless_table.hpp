@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+using BindlessIndex = uint32_t;
+
+struct BindlessStats
+{
+  uint32_t textureCount;
+  uint32_t textureCapacity;
+  uint32_t bufferCount;
+  uint32_t bufferCapacity;
+};
+
+// one descriptor set every draw shares, sampled images and storage buffers live in two large arrays and the shaders
+// index them with what the draw carries, so draws with different textures never bind another set
+//
+// binding 0 holds the sampled images, binding 1 the storage buffers and binding 2 the immutable sampler all textures
+// are sampled with, the arrays are partially bound and update after bind, a slot can be written while frames that
+// bound the set are still in flight as long as none of them reads that slot, which is why slots are only handed back
+// through the deletion queue
+class BindlessTable
+{
+public:
+  // whether the device supports everything the table needs
+  static auto supported( const VkPhysicalDeviceVulkan12Features& features ) -> bool;
+  // turns on what the table needs in the features the device is created with
+  static void enableFeatures( VkPhysicalDeviceVulkan12Features& features );
+
+  // the capacities are clamped to the device's update after bind limits
+  void init( VkDevice device,
+             VkPhysicalDevice physicalDevice,
+             VkSampler sampler,
+             uint32_t maxTextures = defaultMaxTextures,
+             uint32_t maxBuffers = defaultMaxBuffers );
+  // nothing recorded with the set may still be in flight
+  void destroy();
+
+  // the view has to be in SHADER_READ_ONLY_OPTIMAL whenever a draw reads its slot
+  auto addTexture( VkImageView view ) -> BindlessIndex;
+  auto addBuffer( VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE ) -> BindlessIndex;
+  // no frame still in flight may read the slot, the next add can overwrite it
+  void removeTexture( BindlessIndex index );
+  void removeBuffer( BindlessIndex index );
+
+  auto layout() const -> VkDescriptorSetLayout;
+  auto set() const -> VkDescriptorSet;
+  auto stats() const -> BindlessStats;
+
+  static constexpr uint32_t defaultMaxTextures = 4096;
+  static constexpr uint32_t defaultMaxBuffers = 1024;
+
+private:
+  // a slot out of the free list, or the next one never used
+  static auto allocate( std::vector<BindlessIndex>& freeSlots, uint32_t& used, uint32_t capacity, const char* what )
+    -> BindlessIndex;
+
+  VkDevice m_device{ VK_NULL_HANDLE };
+  VkDescriptorSetLayout m_layout{ VK_NULL_HANDLE };
+  VkDescriptorPool m_pool{ VK_NULL_HANDLE };
+  VkDescriptorSet m_set{ VK_NULL_HANDLE };
+
+  uint32_t m_textureCapacity{ 0u };
+  uint32_t m_bufferCapacity{ 0u };
+  // slots below these were handed out at least once, the free lists hold the ones handed back since
+  uint32_t m_texturesUsed{ 0u };
+  uint32_t m_buffersUsed{ 0u };
+  std::vector<BindlessIndex> m_freeTextures;
+  std::vector<BindlessIndex> m_freeBuffers;
+};
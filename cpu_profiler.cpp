@@ -0,0 +1,146 @@
+#include "cpu_profiler.hpp"
+
+#ifdef ENABLE_CPU_PROFILER
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+// the last 32k zones of every thread, roughly 750 KB each
+constexpr size_t eventsPerThread = 1 << 15;
+
+struct ThreadEvents
+{
+  std::array<CpuZoneEvent, eventsPerThread> events;
+  // only the owning thread writes, the exporter reads it with acquire to see complete events
+  std::atomic<uint64_t> written{ 0u };
+  uint32_t threadId{ 0u };
+  std::string name;
+};
+
+// shared_ptr so the events of a thread that already exited still make it into the trace
+std::mutex s_registryMutex;
+std::vector<std::shared_ptr<ThreadEvents>> s_threads;
+thread_local ThreadEvents* t_events{ nullptr };
+
+// reference point for turning ticks into time, taken when the program starts
+struct TickOrigin
+{
+  int64_t ticks{ CpuProfiler::now() };
+  std::chrono::steady_clock::time_point time{ std::chrono::steady_clock::now() };
+} s_tickOrigin;
+
+auto registerThread() -> ThreadEvents*
+{
+  {
+    auto events = std::make_shared<ThreadEvents>();
+
+    std::lock_guard lock{ s_registryMutex };
+    events->threadId = static_cast<uint32_t>( s_threads.size() );
+    events->name = "thread " + std::to_string( events->threadId );
+    s_threads.push_back( events );
+    t_events = events.get();
+  }
+  return t_events;
+}
+
+auto threadEvents() -> ThreadEvents*
+{
+  return t_events ? t_events : registerThread();
+}
+
+void writeEscaped( FILE* file, const char* text )
+{
+  for ( ; *text; text++ )
+  {
+    if ( *text == '"' || *text == '\\' )
+      std::fputc( '\\', file );
+    std::fputc( *text, file );
+  }
+}
+} // namespace
+
+void CpuProfiler::setEnabled( bool enabled )
+{
+  s_enabled.store( enabled, std::memory_order_relaxed );
+}
+
+void CpuProfiler::setThreadName( const char* name )
+{
+  auto events = threadEvents();
+
+  std::lock_guard lock{ s_registryMutex };
+  events->name = name;
+}
+
+void CpuProfiler::record( const char* name, int64_t start, int64_t end )
+{
+  auto events = threadEvents();
+
+  auto index = events->written.load( std::memory_order_relaxed );
+  events->events[index % eventsPerThread] = CpuZoneEvent{ name, start, end - start };
+  events->written.store( index + 1, std::memory_order_release );
+}
+
+bool CpuProfiler::writeChromeTrace( const std::string& path )
+{
+  auto file = std::fopen( path.c_str(), "w" );
+  if ( !file )
+    return false;
+
+  std::lock_guard lock{ s_registryMutex };
+
+  // ticks per microsecond over everything since startup, 1000 when the ticks already are nanoseconds
+  auto elapsedUs = std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - s_tickOrigin.time );
+  auto ticksPerUs = elapsedUs.count() > 0.0
+                      ? static_cast<double>( CpuProfiler::now() - s_tickOrigin.ticks ) / elapsedUs.count()
+                      : 1000.0;
+
+  // timestamps are relative to the oldest event still around so the viewer doesn't start at the boot time
+  auto origin = INT64_MAX;
+  for ( const auto& thread : s_threads )
+  {
+    auto written = thread->written.load( std::memory_order_acquire );
+    auto count = std::min<uint64_t>( written, eventsPerThread );
+    for ( auto i = written - count; i < written; i++ )
+    {
+      origin = std::min( origin, thread->events[i % eventsPerThread].start );
+    }
+  }
+
+  std::fputs( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file );
+
+  bool first = true;
+  for ( const auto& thread : s_threads )
+  {
+    std::fprintf( file,
+                  "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+                  first ? "" : ",",
+                  thread->threadId );
+    writeEscaped( file, thread->name.c_str() );
+    std::fputs( "\"}}", file );
+    first = false;
+
+    auto written = thread->written.load( std::memory_order_acquire );
+    auto count = std::min<uint64_t>( written, eventsPerThread );
+    for ( auto i = written - count; i < written; i++ )
+    {
+      const auto& event = thread->events[i % eventsPerThread];
+      std::fputs( ",\n{\"name\":\"", file );
+      writeEscaped( file, event.name );
+      std::fprintf( file,
+                    "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    thread->threadId,
+                    static_cast<double>( event.start - origin ) / ticksPerUs,
+                    static_cast<double>( event.duration ) / ticksPerUs );
+    }
+  }
+
+  std::fputs( "\n]}\n", file );
+  return std::fclose( file ) == 0;
+}
+#endif
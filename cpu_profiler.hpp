@@ -0,0 +1,96 @@
+#pragma once
+
+// the zone macros expand to nothing unless ENABLE_CPU_PROFILER is defined, so a build without it pays nothing
+#ifdef ENABLE_CPU_PROFILER
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#if defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+#include <intrin.h>
+#define CPU_PROFILER_TSC
+#elif defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#define CPU_PROFILER_TSC
+#endif
+
+struct CpuZoneEvent
+{
+  // has to outlive the profiler, string literals and __func__ do
+  const char* name;
+  // in CpuProfiler::now() ticks, converted to time only when a trace gets written
+  int64_t start;
+  int64_t duration;
+};
+
+// scoped cpu zones written to a per thread ring of events without any locking, the rings get merged only when a
+// chrome trace_event json is written out, open it in chrome://tracing or ui.perfetto.dev
+class CpuProfiler
+{
+public:
+  static void setEnabled( bool enabled );
+  static bool enabled()
+  {
+    return s_enabled.load( std::memory_order_relaxed );
+  }
+
+  static void setThreadName( const char* name );
+  static void record( const char* name, int64_t start, int64_t end );
+  // meant to be called between frames, a zone finishing on another thread meanwhile may come out torn
+  static bool writeChromeTrace( const std::string& path );
+
+  // the time stamp counter is several times cheaper to read than steady_clock, which is what keeps a zone well
+  // under 50 ns, it gets calibrated against steady_clock when the trace is written
+  static auto now() -> int64_t
+  {
+#ifdef CPU_PROFILER_TSC
+    return static_cast<int64_t>( __rdtsc() );
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch() )
+      .count();
+#endif
+  }
+
+private:
+  static inline std::atomic<bool> s_enabled{ true };
+};
+
+class CpuZone
+{
+public:
+  explicit CpuZone( const char* name )
+  {
+    if ( CpuProfiler::enabled() )
+    {
+      m_name = name;
+      m_start = CpuProfiler::now();
+    }
+  }
+
+  ~CpuZone()
+  {
+    if ( m_name )
+    {
+      CpuProfiler::record( m_name, m_start, CpuProfiler::now() );
+    }
+  }
+
+  CpuZone( const CpuZone& ) = delete;
+  CpuZone& operator=( const CpuZone& ) = delete;
+
+private:
+  const char* m_name{ nullptr };
+  int64_t m_start{ 0 };
+};
+
+#define PROFILE_CONCAT_INNER( a, b ) a##b
+#define PROFILE_CONCAT( a, b ) PROFILE_CONCAT_INNER( a, b )
+#define PROFILE_ZONE( name ) CpuZone PROFILE_CONCAT( cpuZone, __LINE__ )( name )
+#define PROFILE_FUNCTION() PROFILE_ZONE( __func__ )
+#define PROFILE_THREAD( name ) CpuProfiler::setThreadName( name )
+#else
+#define PROFILE_ZONE( name )
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD( name )
+#endif
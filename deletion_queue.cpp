@@ -0,0 +1,38 @@
+#include "deletion_queue.hpp"
+
+void DeletionQueue::init( TimelineScheduler& timeline )
+{
+  m_timeline = &timeline;
+}
+
+void DeletionQueue::push( std::function<void()> destroy )
+{
+  m_entries.push_back( { m_timeline->lastSubmittedValue(), std::move( destroy ) } );
+}
+
+void DeletionQueue::collect()
+{
+  // values only grow along the queue, so the first one still pending ends the scan
+  auto completed = m_timeline->completedValue();
+  while ( !m_entries.empty() && m_entries.front().value <= completed )
+  {
+    auto destroy = std::move( m_entries.front().destroy );
+    m_entries.pop_front();
+    destroy();
+  }
+}
+
+void DeletionQueue::flush()
+{
+  while ( !m_entries.empty() )
+  {
+    auto destroy = std::move( m_entries.front().destroy );
+    m_entries.pop_front();
+    destroy();
+  }
+}
+
+auto DeletionQueue::pending() const -> size_t
+{
+  return m_entries.size();
+}
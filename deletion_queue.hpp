@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include "timeline_scheduler.hpp"
+
+// destroys what the gpu may still be using once it is done with it instead of idling the device, everything pushed
+// waits for the newest value submitted to the timeline at that point
+class DeletionQueue
+{
+public:
+  void init( TimelineScheduler& timeline );
+
+  void push( std::function<void()> destroy );
+  // runs everything whose submissions have retired, oldest first
+  void collect();
+  // runs everything, the caller made sure the gpu is idle
+  void flush();
+
+  auto pending() const -> size_t;
+
+private:
+  struct Entry
+  {
+    uint64_t value;
+    std::function<void()> destroy;
+  };
+
+  TimelineScheduler* m_timeline{ nullptr };
+  std::deque<Entry> m_entries;
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// nearest rank percentile, p in [0, 100], reorders the samples
+inline auto percentile( std::vector<double>& samples, double p ) -> double
+{
+  if ( samples.empty() )
+    return 0.0;
+
+  auto rank = static_cast<size_t>( p / 100.0 * static_cast<double>( samples.size() - 1 ) + 0.5 );
+  rank = std::min( rank, samples.size() - 1 );
+  std::nth_element( samples.begin(), samples.begin() + rank, samples.end() );
+  return samples[rank];
+}
+
+// window over the last N samples, used for the rolling numbers shown in the ui
+template <size_t N>
+class RollingStats
+{
+public:
+  void push( double sample )
+  {
+    m_samples[m_next] = sample;
+    m_next = ( m_next + 1 ) % N;
+    m_count = std::min( m_count + 1, N );
+  }
+
+  void clear()
+  {
+    m_next = 0;
+    m_count = 0;
+  }
+
+  auto count() const -> size_t
+  {
+    return m_count;
+  }
+
+  auto last() const -> double
+  {
+    return m_count == 0 ? 0.0 : m_samples[( m_next + N - 1 ) % N];
+  }
+
+  // age 0 is the last sample, has to be below count()
+  auto recent( size_t age ) const -> double
+  {
+    return m_samples[( m_next + N - 1 - age ) % N];
+  }
+
+  auto min() const -> double
+  {
+    return m_count == 0 ? 0.0 : *std::min_element( m_samples.begin(), m_samples.begin() + m_count );
+  }
+
+  auto max() const -> double
+  {
+    return m_count == 0 ? 0.0 : *std::max_element( m_samples.begin(), m_samples.begin() + m_count );
+  }
+
+  auto average() const -> double
+  {
+    if ( m_count == 0 )
+      return 0.0;
+
+    double sum = 0.0;
+    for ( size_t i = 0; i < m_count; i++ )
+    {
+      sum += m_samples[i];
+    }
+    return sum / static_cast<double>( m_count );
+  }
+
+  auto percentile( double p ) const -> double
+  {
+    std::vector<double> samples( m_samples.begin(), m_samples.begin() + m_count );
+    return ::percentile( samples, p );
+  }
+
+private:
+  std::array<double, N> m_samples{};
+  size_t m_next{ 0u };
+  size_t m_count{ 0u };
+};
@@ -0,0 +1,267 @@
+#include "geometry_pool.hpp"
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
+void GeometryPool::init( VkDevice device,
+                         GpuAllocator& allocator,
+                         UploadManager& uploads,
+                         DeletionQueue& deletions,
+                         VkDeviceSize vertexPageBytes,
+                         VkDeviceSize indexPageBytes )
+{
+  m_device = device;
+  m_allocator = &allocator;
+  m_uploads = &uploads;
+  m_deletions = &deletions;
+  m_vertexPageBytes = vertexPageBytes;
+  m_indexPageBytes = indexPageBytes;
+
+  createPage( m_vertexPageBytes, m_indexPageBytes );
+}
+
+void GeometryPool::destroy()
+{
+  for ( auto& page : m_pages )
+  {
+    vkDestroyBuffer( m_device, page.vertexBuffer, nullptr );
+    m_allocator->free( page.vertexMemory );
+    vkDestroyBuffer( m_device, page.indexBuffer, nullptr );
+    m_allocator->free( page.indexMemory );
+  }
+  m_pages.clear();
+  m_meshes.clear();
+  m_freeHandles.clear();
+}
+
+auto GeometryPool::addMesh( const void* vertices,
+                            uint32_t vertexCount,
+                            VertexLayout layout,
+                            const uint16_t* indices,
+                            uint32_t indexCount,
+                            const Dequantize& dequantize ) -> MeshHandle
+{
+  if ( vertexCount > UINT16_MAX + 1u )
+  {
+    throw std::invalid_argument( "mesh has more vertices than 16 bit indices can reach!" );
+  }
+
+  auto stride = vertexStride( layout );
+  VkDeviceSize vertexBytes = static_cast<VkDeviceSize>( vertexCount ) * stride;
+  VkDeviceSize indexBytes = static_cast<VkDeviceSize>( indexCount ) * sizeof( uint16_t );
+
+  // first page with room for both halves, vertex offsets have to land on whole vertices
+  uint32_t pageIndex = 0;
+  std::optional<uint64_t> vertexOffset;
+  std::optional<uint64_t> indexOffset;
+  for ( ; pageIndex < m_pages.size(); pageIndex++ )
+  {
+    auto& page = m_pages[pageIndex];
+    if ( !page.resident )
+      continue;
+    vertexOffset = page.vertexRanges.allocate( vertexBytes, stride );
+    if ( !vertexOffset )
+      continue;
+    indexOffset = page.indexRanges.allocate( indexBytes, sizeof( uint16_t ) );
+    if ( indexOffset )
+      break;
+    page.vertexRanges.free( *vertexOffset, vertexBytes );
+  }
+
+  if ( pageIndex == m_pages.size() )
+  {
+    pageIndex = createPage( std::max( m_vertexPageBytes, vertexBytes ), std::max( m_indexPageBytes, indexBytes ) );
+    vertexOffset = m_pages[pageIndex].vertexRanges.allocate( vertexBytes, stride );
+    indexOffset = m_pages[pageIndex].indexRanges.allocate( indexBytes, sizeof( uint16_t ) );
+  }
+
+  MeshRange range{ pageIndex,
+                   static_cast<uint32_t>( *indexOffset / sizeof( uint16_t ) ),
+                   indexCount,
+                   static_cast<int32_t>( *vertexOffset / stride ),
+                   vertexCount,
+                   layout,
+                   dequantize };
+
+  MeshHandle handle;
+  if ( !m_freeHandles.empty() )
+  {
+    handle = m_freeHandles.back();
+    m_freeHandles.pop_back();
+  }
+  else
+  {
+    handle = static_cast<MeshHandle>( m_meshes.size() );
+    m_meshes.emplace_back();
+  }
+  auto& mesh = m_meshes[handle];
+  mesh.range = range;
+  mesh.live = true;
+  mesh.vertices.assign( static_cast<const uint8_t*>( vertices ), static_cast<const uint8_t*>( vertices ) + vertexBytes );
+  mesh.indices.assign( indices, indices + indexCount );
+  writeMesh( m_pages[pageIndex], mesh );
+  return handle;
+}
+
+void GeometryPool::removeMesh( MeshHandle mesh )
+{
+  auto range = this->mesh( mesh );
+  m_meshes[mesh].live = false;
+  m_meshes[mesh].vertices = {};
+  m_meshes[mesh].indices = {};
+  m_freeHandles.push_back( mesh );
+
+  m_deletions->push( [this, range] {
+    auto& page = m_pages[range.page];
+    auto stride = vertexStride( range.layout );
+    page.vertexRanges.free( static_cast<uint64_t>( range.vertexOffset ) * stride,
+                            static_cast<uint64_t>( range.vertexCount ) * stride );
+    page.indexRanges.free( static_cast<uint64_t>( range.firstIndex ) * sizeof( uint16_t ),
+                           static_cast<uint64_t>( range.indexCount ) * sizeof( uint16_t ) );
+  } );
+}
+
+auto GeometryPool::mesh( MeshHandle mesh ) const -> const MeshRange&
+{
+  if ( mesh >= m_meshes.size() || !m_meshes[mesh].live )
+  {
+    throw std::out_of_range( "mesh handle is not in the geometry pool!" );
+  }
+  return m_meshes[mesh].range;
+}
+
+void GeometryPool::bind( VkCommandBuffer cmd, uint32_t page ) const
+{
+  VkDeviceSize offset = 0;
+  vkCmdBindVertexBuffers( cmd, 0, 1, &m_pages[page].vertexBuffer, &offset );
+  vkCmdBindIndexBuffer( cmd, m_pages[page].indexBuffer, 0, VK_INDEX_TYPE_UINT16 );
+}
+
+auto GeometryPool::stats() const -> GeometryStats
+{
+  GeometryStats stats{};
+  stats.pageCount = static_cast<uint32_t>( m_pages.size() );
+  stats.meshCount = static_cast<uint32_t>( m_meshes.size() - m_freeHandles.size() );
+  for ( const auto& page : m_pages )
+  {
+    stats.vertexCapacity += page.vertexRanges.capacity();
+    stats.vertexBytes += page.vertexRanges.capacity() - page.vertexRanges.freeBytes();
+    stats.indexCapacity += page.indexRanges.capacity();
+    stats.indexBytes += page.indexRanges.capacity() - page.indexRanges.freeBytes();
+  }
+  return stats;
+}
+
+auto GeometryPool::pageCount() const -> uint32_t
+{
+  return static_cast<uint32_t>( m_pages.size() );
+}
+
+auto GeometryPool::vertexMemory( uint32_t page ) const -> const GpuAllocation&
+{
+  return m_pages.at( page ).vertexMemory;
+}
+
+auto GeometryPool::indexMemory( uint32_t page ) const -> const GpuAllocation&
+{
+  return m_pages.at( page ).indexMemory;
+}
+
+void GeometryPool::evictPage( uint32_t page )
+{
+  auto& entry = m_pages.at( page );
+  if ( !entry.resident )
+    return;
+
+  vkDestroyBuffer( m_device, entry.vertexBuffer, nullptr );
+  m_allocator->free( entry.vertexMemory );
+  vkDestroyBuffer( m_device, entry.indexBuffer, nullptr );
+  m_allocator->free( entry.indexMemory );
+  entry.vertexBuffer = VK_NULL_HANDLE;
+  entry.indexBuffer = VK_NULL_HANDLE;
+  entry.resident = false;
+}
+
+void GeometryPool::reloadPage( uint32_t page )
+{
+  auto& entry = m_pages.at( page );
+  if ( entry.resident )
+    return;
+
+  createPageBuffers( entry, entry.vertexRanges.capacity(), entry.indexRanges.capacity() );
+  entry.resident = true;
+  for ( const auto& mesh : m_meshes )
+  {
+    if ( mesh.live && mesh.range.page == page )
+      writeMesh( entry, mesh );
+  }
+}
+
+auto GeometryPool::createPage( VkDeviceSize vertexBytes, VkDeviceSize indexBytes ) -> uint32_t
+{
+  Page page;
+  createPageBuffers( page, vertexBytes, indexBytes );
+  page.vertexRanges.init( vertexBytes );
+  page.indexRanges.init( indexBytes );
+
+  m_pages.push_back( std::move( page ) );
+  return static_cast<uint32_t>( m_pages.size() - 1 );
+}
+
+void GeometryPool::createPageBuffers( Page& page, VkDeviceSize vertexBytes, VkDeviceSize indexBytes )
+{
+  page.vertexBuffer = createBuffer(
+    vertexBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, page.vertexMemory );
+  page.indexBuffer =
+    createBuffer( indexBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, page.indexMemory );
+}
+
+void GeometryPool::writeMesh( const Page& page, const Mesh& mesh )
+{
+  auto stride = vertexStride( mesh.range.layout );
+  write( page.vertexBuffer,
+         page.vertexMemory,
+         mesh.vertices.data(),
+         mesh.vertices.size(),
+         static_cast<VkDeviceSize>( mesh.range.vertexOffset ) * stride );
+  write( page.indexBuffer,
+         page.indexMemory,
+         mesh.indices.data(),
+         mesh.indices.size() * sizeof( uint16_t ),
+         static_cast<VkDeviceSize>( mesh.range.firstIndex ) * sizeof( uint16_t ) );
+}
+
+auto GeometryPool::createBuffer( VkDeviceSize size, VkBufferUsageFlags usage, GpuAllocation& memory ) -> VkBuffer
+{
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkBuffer buffer;
+  if ( vkCreateBuffer( m_device, &bufferInfo, nullptr, &buffer ) != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to create geometry buffer!" );
+  }
+
+  memory = m_allocator->allocateBuffer( buffer, MemoryUsage::UploadOnce );
+  return buffer;
+}
+
+void GeometryPool::write( VkBuffer buffer,
+                          const GpuAllocation& memory,
+                          const void* data,
+                          VkDeviceSize size,
+                          VkDeviceSize offset )
+{
+  // a range nothing in flight reads, the other meshes of the page can keep drawing while it is written
+  if ( memory.mapped )
+  {
+    memcpy( static_cast<char*>( memory.mapped ) + offset, data, static_cast<size_t>( size ) );
+    return;
+  }
+
+  m_uploads->uploadBuffer( buffer, data, size, offset );
+}
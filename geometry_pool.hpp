@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "deletion_queue.hpp"
+#include "gpu_allocator.hpp"
+#include "range_allocator.hpp"
+#include "upload_manager.hpp"
+#include "vertex_layout.hpp"
+
+using MeshHandle = uint32_t;
+
+// where a mesh lives in the pool, the arguments of its vkCmdDrawIndexed
+struct MeshRange
+{
+  uint32_t page;
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  int32_t vertexOffset;
+  uint32_t vertexCount;
+  VertexLayout layout;
+  Dequantize dequantize;
+};
+
+struct GeometryStats
+{
+  uint32_t pageCount;
+  uint32_t meshCount;
+  VkDeviceSize vertexBytes;
+  VkDeviceSize vertexCapacity;
+  VkDeviceSize indexBytes;
+  VkDeviceSize indexCapacity;
+};
+
+// vertex and index data of all meshes in a few large buffers, every mesh is a range of each handed out by a free list,
+// so drawing any number of meshes of a page takes one bind and the offsets of each draw
+//
+// indices are 16 bit and relative to the first vertex of their mesh, vertexOffset moves them to where the mesh ended
+// up, a mesh that fits in no page gets a new one, pages are only released by destroy()
+//
+// meshes of different vertex layouts share the pages, a vertex range starts on a whole vertex of its own layout so
+// vertexOffset counts in its stride while the page stays bound at offset 0
+//
+// every mesh keeps a copy of its data in system memory, so a page can be evicted as a whole and written again when it
+// is reloaded, its ranges stay handed out in between and the meshes keep their MeshRange
+class GeometryPool
+{
+public:
+  void init( VkDevice device,
+             GpuAllocator& allocator,
+             UploadManager& uploads,
+             DeletionQueue& deletions,
+             VkDeviceSize vertexPageBytes = defaultVertexPageBytes,
+             VkDeviceSize indexPageBytes = defaultIndexPageBytes );
+  // nothing recorded with the pool may still be in flight
+  void destroy();
+
+  // vertices holds vertexCount vertices of the layout, written in place when the page is host visible and staged
+  // through the upload manager otherwise
+  auto addMesh( const void* vertices,
+                uint32_t vertexCount,
+                VertexLayout layout,
+                const uint16_t* indices,
+                uint32_t indexCount,
+                const Dequantize& dequantize = {} ) -> MeshHandle;
+  // the ranges are handed back once the frames that may still draw the mesh have retired
+  void removeMesh( MeshHandle mesh );
+
+  auto mesh( MeshHandle mesh ) const -> const MeshRange&;
+  void bind( VkCommandBuffer cmd, uint32_t page ) const;
+  auto stats() const -> GeometryStats;
+
+  auto pageCount() const -> uint32_t;
+  // empty while the page is evicted
+  auto vertexMemory( uint32_t page ) const -> const GpuAllocation&;
+  auto indexMemory( uint32_t page ) const -> const GpuAllocation&;
+  // only for pages nothing in flight reads, the buffers are destroyed right away, new meshes go to other pages
+  void evictPage( uint32_t page );
+  // new buffers with every live mesh of the page written again, anything recorded with the old ones is stale
+  void reloadPage( uint32_t page );
+
+  static constexpr VkDeviceSize defaultVertexPageBytes = 8ull * 1024 * 1024;
+  static constexpr VkDeviceSize defaultIndexPageBytes = 4ull * 1024 * 1024;
+
+private:
+  struct Page
+  {
+    VkBuffer vertexBuffer{ VK_NULL_HANDLE };
+    GpuAllocation vertexMemory;
+    RangeAllocator vertexRanges;
+    VkBuffer indexBuffer{ VK_NULL_HANDLE };
+    GpuAllocation indexMemory;
+    RangeAllocator indexRanges;
+    bool resident{ true };
+  };
+
+  struct Mesh
+  {
+    MeshRange range{};
+    bool live{ false };
+    // what reloadPage() writes again
+    std::vector<uint8_t> vertices;
+    std::vector<uint16_t> indices;
+  };
+
+  auto createPage( VkDeviceSize vertexBytes, VkDeviceSize indexBytes ) -> uint32_t;
+  void createPageBuffers( Page& page, VkDeviceSize vertexBytes, VkDeviceSize indexBytes );
+  void writeMesh( const Page& page, const Mesh& mesh );
+  auto createBuffer( VkDeviceSize size, VkBufferUsageFlags usage, GpuAllocation& memory ) -> VkBuffer;
+  void write( VkBuffer buffer, const GpuAllocation& memory, const void* data, VkDeviceSize size, VkDeviceSize offset );
+
+  VkDevice m_device{ VK_NULL_HANDLE };
+  GpuAllocator* m_allocator{ nullptr };
+  UploadManager* m_uploads{ nullptr };
+  DeletionQueue* m_deletions{ nullptr };
+  VkDeviceSize m_vertexPageBytes{ 0u };
+  VkDeviceSize m_indexPageBytes{ 0u };
+
+  std::vector<Page> m_pages;
+  // indexed by handle, removed slots are reused
+  std::vector<Mesh> m_meshes;
+  std::vector<MeshHandle> m_freeHandles;
+};
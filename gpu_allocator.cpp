@@ -0,0 +1,376 @@
+#include "gpu_allocator.hpp"
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+
+namespace
+{
+constexpr VkDeviceSize defaultBlockSize = 64ull * 1024 * 1024;
+} // namespace
+
+void GpuAllocator::init( VkDevice device, VkPhysicalDevice physicalDevice )
+{
+  m_device = device;
+  vkGetPhysicalDeviceMemoryProperties( physicalDevice, &m_memoryProperties );
+  m_placement.init( m_memoryProperties );
+}
+
+void GpuAllocator::destroy()
+{
+  std::lock_guard lock{ m_mutex };
+
+  // freeing the memory unmaps it as well, dedicated allocations are owned by whoever still holds them
+  for ( auto& block : m_blocks )
+  {
+    freeMemory( block->memory, block->ranges.capacity(), block->memoryType );
+  }
+  m_blocks.clear();
+}
+
+auto GpuAllocator::findMemoryType( uint32_t typeFilter, VkMemoryPropertyFlags properties ) const -> uint32_t
+{
+  for ( uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++ )
+  {
+    if ( ( typeFilter & ( 1 << i ) ) && ( m_memoryProperties.memoryTypes[i].propertyFlags & properties ) == properties )
+    {
+      return i;
+    }
+  }
+
+  throw std::runtime_error( "failed to find suitable memory type!" );
+}
+
+auto GpuAllocator::placement() const -> const MemoryPlacement&
+{
+  return m_placement;
+}
+
+auto GpuAllocator::allocateBuffer( VkBuffer buffer, VkMemoryPropertyFlags properties ) -> GpuAllocation
+{
+  bool dedicated{ false };
+  auto requirements = bufferRequirements( buffer, dedicated );
+  return bindBuffer( buffer, requirements, findMemoryType( requirements.memoryTypeBits, properties ), dedicated );
+}
+
+auto GpuAllocator::allocateBuffer( VkBuffer buffer, MemoryUsage usage ) -> GpuAllocation
+{
+  bool dedicated{ false };
+  auto requirements = bufferRequirements( buffer, dedicated );
+  return bindBuffer( buffer, requirements, m_placement.memoryType( usage, requirements.memoryTypeBits ), dedicated );
+}
+
+auto GpuAllocator::bufferRequirements( VkBuffer buffer, bool& dedicated ) const -> VkMemoryRequirements
+{
+  VkMemoryDedicatedRequirements dedicatedRequirements{};
+  dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+  VkMemoryRequirements2 requirements{};
+  requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+  requirements.pNext = &dedicatedRequirements;
+
+  VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+  requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+  requirementsInfo.buffer = buffer;
+  vkGetBufferMemoryRequirements2( m_device, &requirementsInfo, &requirements );
+
+  dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+  return requirements.memoryRequirements;
+}
+
+auto GpuAllocator::bindBuffer( VkBuffer buffer,
+                               const VkMemoryRequirements& requirements,
+                               uint32_t memoryType,
+                               bool dedicated ) -> GpuAllocation
+{
+  VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+  dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+  dedicatedInfo.buffer = buffer;
+
+  auto allocation = allocate( requirements, memoryType, AllocationKind::Linear, dedicated, dedicatedInfo );
+
+  vkBindBufferMemory( m_device, buffer, allocation.memory, allocation.offset );
+  return allocation;
+}
+
+auto GpuAllocator::allocateImage( VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties )
+  -> GpuAllocation
+{
+  VkMemoryDedicatedRequirements dedicatedRequirements{};
+  dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+  VkMemoryRequirements2 requirements{};
+  requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+  requirements.pNext = &dedicatedRequirements;
+
+  VkImageMemoryRequirementsInfo2 requirementsInfo{};
+  requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+  requirementsInfo.image = image;
+  vkGetImageMemoryRequirements2( m_device, &requirementsInfo, &requirements );
+
+  VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+  dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+  dedicatedInfo.image = image;
+
+  // render targets and other big images would eat most of a block on their own
+  auto memoryType = findMemoryType( requirements.memoryRequirements.memoryTypeBits, properties );
+  auto large = requirements.memoryRequirements.size >= blockSize( memoryType ) / 2;
+
+  auto allocation = allocate( requirements.memoryRequirements,
+                              memoryType,
+                              tiling == VK_IMAGE_TILING_OPTIMAL ? AllocationKind::Optimal : AllocationKind::Linear,
+                              large || dedicatedRequirements.prefersDedicatedAllocation ||
+                                dedicatedRequirements.requiresDedicatedAllocation,
+                              dedicatedInfo );
+
+  vkBindImageMemory( m_device, image, allocation.memory, allocation.offset );
+  return allocation;
+}
+
+auto GpuAllocator::allocateAliased( const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties )
+  -> GpuAllocation
+{
+  // no single owner to name, a dedicated allocation for it leaves both handles empty
+  VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+  dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+
+  auto memoryType = findMemoryType( requirements.memoryTypeBits, properties );
+  auto large = requirements.size >= blockSize( memoryType ) / 2;
+  return allocate( requirements, memoryType, AllocationKind::Optimal, large, dedicatedInfo );
+}
+
+auto GpuAllocator::allocate( const VkMemoryRequirements& requirements,
+                             uint32_t memoryType,
+                             AllocationKind kind,
+                             bool dedicated,
+                             const VkMemoryDedicatedAllocateInfo& dedicatedInfo ) -> GpuAllocation
+{
+  auto typeBits = requirements.memoryTypeBits;
+  // whatever is mapped has to stay mapped after a demotion, its users write through the pointer
+  auto hostFlags = m_memoryProperties.memoryTypes[memoryType].propertyFlags &
+                   ( VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+  while ( true )
+  {
+    try
+    {
+      return allocateFromType( requirements, memoryType, kind, dedicated, dedicatedInfo );
+    }
+    catch ( const GpuOutOfMemory& )
+    {
+      // the lock is released by now, the handler frees through this allocator
+      auto heap = m_memoryProperties.memoryTypes[memoryType].heapIndex;
+      if ( m_outOfMemory && m_outOfMemory( heap, requirements.size ) )
+        continue;
+
+      // slower memory beats failing, on discrete cards this ends up in system memory
+      for ( uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++ )
+      {
+        if ( m_memoryProperties.memoryTypes[i].heapIndex == heap )
+          typeBits &= ~( 1u << i );
+      }
+      std::optional<uint32_t> fallback;
+      for ( uint32_t i = 0; i < m_memoryProperties.memoryTypeCount && !fallback; i++ )
+      {
+        auto flags = m_memoryProperties.memoryTypes[i].propertyFlags;
+        if ( ( typeBits & ( 1u << i ) ) && ( flags & hostFlags ) == hostFlags )
+          fallback = i;
+      }
+      if ( !fallback )
+        throw;
+
+      memoryType = *fallback;
+      std::lock_guard lock{ m_mutex };
+      m_demotionCount++;
+    }
+  }
+}
+
+auto GpuAllocator::allocateFromType( const VkMemoryRequirements& requirements,
+                                     uint32_t memoryType,
+                                     AllocationKind kind,
+                                     bool dedicated,
+                                     const VkMemoryDedicatedAllocateInfo& dedicatedInfo ) -> GpuAllocation
+{
+  auto hostVisible = ( m_memoryProperties.memoryTypes[memoryType].propertyFlags &
+                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ) != 0;
+
+  std::lock_guard lock{ m_mutex };
+
+  if ( dedicated || requirements.size > blockSize( memoryType ) )
+  {
+    GpuAllocation allocation{};
+    allocation.memory = allocateMemory( requirements.size, memoryType, &dedicatedInfo );
+    allocation.size = requirements.size;
+    allocation.memoryType = memoryType;
+    if ( hostVisible )
+    {
+      vkMapMemory( m_device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped );
+    }
+
+    m_allocationCount++;
+    m_dedicatedCount++;
+    m_dedicatedBytes += requirements.size;
+    return allocation;
+  }
+
+  GpuMemoryBlock* target{ nullptr };
+  std::optional<uint64_t> offset;
+  for ( auto& block : m_blocks )
+  {
+    if ( block->memoryType != memoryType || block->kind != kind )
+      continue;
+
+    offset = block->ranges.allocate( requirements.size, requirements.alignment );
+    if ( offset )
+    {
+      target = block.get();
+      break;
+    }
+  }
+
+  if ( !target )
+  {
+    auto block = std::make_unique<GpuMemoryBlock>();
+    block->memory = allocateMemory( blockSize( memoryType ), memoryType, nullptr );
+    block->memoryType = memoryType;
+    block->kind = kind;
+    block->ranges.init( blockSize( memoryType ) );
+    if ( hostVisible )
+    {
+      vkMapMemory( m_device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped );
+    }
+
+    offset = block->ranges.allocate( requirements.size, requirements.alignment );
+    target = block.get();
+    m_blocks.push_back( std::move( block ) );
+  }
+
+  GpuAllocation allocation{};
+  allocation.memory = target->memory;
+  allocation.offset = *offset;
+  allocation.size = requirements.size;
+  allocation.memoryType = memoryType;
+  allocation.mapped = target->mapped ? static_cast<char*>( target->mapped ) + *offset : nullptr;
+  allocation.block = target;
+
+  m_allocationCount++;
+  return allocation;
+}
+
+void GpuAllocator::free( GpuAllocation& allocation )
+{
+  if ( allocation.memory == VK_NULL_HANDLE )
+    return;
+
+  std::lock_guard lock{ m_mutex };
+
+  m_allocationCount--;
+  if ( !allocation.block )
+  {
+    freeMemory( allocation.memory, allocation.size, allocation.memoryType );
+    m_dedicatedCount--;
+    m_dedicatedBytes -= allocation.size;
+    allocation = {};
+    return;
+  }
+
+  auto block = allocation.block;
+  block->ranges.free( allocation.offset, allocation.size );
+  allocation = {};
+
+  // an empty block goes back to the driver unless it is the last one of its kind, that one absorbs the churn of
+  // creating and destroying the same resources over and over
+  if ( !block->ranges.empty() )
+    return;
+
+  auto siblings = std::count_if( m_blocks.begin(), m_blocks.end(), [block]( const auto& other ) {
+    return other->memoryType == block->memoryType && other->kind == block->kind;
+  } );
+  if ( siblings > 1 )
+  {
+    freeMemory( block->memory, block->ranges.capacity(), block->memoryType );
+    std::erase_if( m_blocks, [block]( const auto& other ) { return other.get() == block; } );
+  }
+}
+
+auto GpuAllocator::stats() const -> GpuAllocatorStats
+{
+  std::lock_guard lock{ m_mutex };
+
+  GpuAllocatorStats stats{};
+  stats.blockCount = static_cast<uint32_t>( m_blocks.size() );
+  stats.dedicatedCount = m_dedicatedCount;
+  stats.allocationCount = m_allocationCount;
+  stats.reservedBytes = m_dedicatedBytes;
+  stats.usedBytes = m_dedicatedBytes;
+
+  VkDeviceSize freeBytes{ 0u };
+  VkDeviceSize largestFreeBytes{ 0u };
+  for ( const auto& block : m_blocks )
+  {
+    stats.reservedBytes += block->ranges.capacity();
+    stats.usedBytes += block->ranges.capacity() - block->ranges.freeBytes();
+    freeBytes += block->ranges.freeBytes();
+    largestFreeBytes += block->ranges.largestFreeRange();
+  }
+  stats.fragmentation =
+    freeBytes == 0 ? 0.0 : 1.0 - static_cast<double>( largestFreeBytes ) / static_cast<double>( freeBytes );
+  stats.demotionCount = m_demotionCount;
+  return stats;
+}
+
+auto GpuAllocator::memoryProperties() const -> const VkPhysicalDeviceMemoryProperties&
+{
+  return m_memoryProperties;
+}
+
+auto GpuAllocator::heapIndex( const GpuAllocation& allocation ) const -> uint32_t
+{
+  return m_memoryProperties.memoryTypes[allocation.memoryType].heapIndex;
+}
+
+auto GpuAllocator::heapUsage( uint32_t heapIndex ) const -> VkDeviceSize
+{
+  std::lock_guard lock{ m_mutex };
+  return m_heapBytes.at( heapIndex );
+}
+
+void GpuAllocator::setOutOfMemoryHandler( OutOfMemoryHandler handler )
+{
+  m_outOfMemory = std::move( handler );
+}
+
+auto GpuAllocator::allocateMemory( VkDeviceSize size, uint32_t memoryType, const void* next ) -> VkDeviceMemory
+{
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.pNext = next;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryType;
+
+  VkDeviceMemory memory;
+  auto result = vkAllocateMemory( m_device, &allocInfo, nullptr, &memory );
+  if ( result == VK_ERROR_OUT_OF_DEVICE_MEMORY )
+  {
+    throw GpuOutOfMemory( "out of gpu memory!" );
+  }
+  if ( result != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to allocate gpu memory!" );
+  }
+
+  m_heapBytes[m_memoryProperties.memoryTypes[memoryType].heapIndex] += size;
+  return memory;
+}
+
+void GpuAllocator::freeMemory( VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType )
+{
+  vkFreeMemory( m_device, memory, nullptr );
+  m_heapBytes[m_memoryProperties.memoryTypes[memoryType].heapIndex] -= size;
+}
+
+auto GpuAllocator::blockSize( uint32_t memoryType ) const -> VkDeviceSize
+{
+  // small heaps like the 256 MB bar window would be eaten by a handful of default sized blocks
+  auto heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[memoryType].heapIndex].size;
+  return std::min( defaultBlockSize, heapSize / 8 );
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "memory_placement.hpp"
+#include "range_allocator.hpp"
+
+// buffers and linear images never share a block with optimal images, so bufferImageGranularity can't bite
+enum class AllocationKind
+{
+  Linear,
+  Optimal
+};
+
+struct GpuMemoryBlock
+{
+  VkDeviceMemory memory{ VK_NULL_HANDLE };
+  uint32_t memoryType{ 0u };
+  AllocationKind kind{ AllocationKind::Linear };
+  RangeAllocator ranges;
+  // the whole block stays mapped for its lifetime when the memory type is host visible
+  void* mapped{ nullptr };
+};
+
+struct GpuAllocation
+{
+  VkDeviceMemory memory{ VK_NULL_HANDLE };
+  VkDeviceSize offset{ 0u };
+  VkDeviceSize size{ 0u };
+  uint32_t memoryType{ 0u };
+  // points at offset when the memory is host visible, never map the memory yourself, it is shared
+  void* mapped{ nullptr };
+  // owning block, null for dedicated allocations
+  GpuMemoryBlock* block{ nullptr };
+};
+
+struct GpuAllocatorStats
+{
+  uint32_t blockCount;
+  uint32_t dedicatedCount;
+  uint32_t allocationCount;
+  // everything that went through vkAllocateMemory and how much of it is handed out
+  VkDeviceSize reservedBytes;
+  VkDeviceSize usedBytes;
+  // 0 when the free space of every block is a single range, towards 1 the more it is split into small holes
+  double fragmentation;
+  // allocations that did not fit their heap and went to another one
+  uint32_t demotionCount;
+};
+
+// the driver ran out of memory in a heap, thrown before any eviction or demotion is tried
+struct GpuOutOfMemory : std::runtime_error
+{
+  using std::runtime_error::runtime_error;
+};
+
+// asked to free idle resources of a heap when it is full, returns false when there was nothing left to free
+using OutOfMemoryHandler = std::function<bool( uint32_t heapIndex, VkDeviceSize size )>;
+
+// sub-allocates buffers and images out of big vkAllocateMemory blocks, one list of blocks per memory type and
+// resource kind, large images and anything the driver asks for get a dedicated allocation instead
+class GpuAllocator
+{
+public:
+  void init( VkDevice device, VkPhysicalDevice physicalDevice );
+  void destroy();
+
+  // the policy part, which memory type a resource lands in, the allocator only decides where inside of it
+  auto findMemoryType( uint32_t typeFilter, VkMemoryPropertyFlags properties ) const -> uint32_t;
+  auto placement() const -> const MemoryPlacement&;
+
+  // allocate and bind, either with exact properties or with the type the placement picks for the usage
+  auto allocateBuffer( VkBuffer buffer, VkMemoryPropertyFlags properties ) -> GpuAllocation;
+  auto allocateBuffer( VkBuffer buffer, MemoryUsage usage ) -> GpuAllocation;
+  auto allocateImage( VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties ) -> GpuAllocation;
+  // unbound memory for optimal images, several may be bound to it as long as they are never in use at the same time
+  auto allocateAliased( const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties ) -> GpuAllocation;
+  // resets the allocation, freeing it twice is harmless
+  void free( GpuAllocation& allocation );
+
+  auto stats() const -> GpuAllocatorStats;
+  auto memoryProperties() const -> const VkPhysicalDeviceMemoryProperties&;
+  auto heapIndex( const GpuAllocation& allocation ) const -> uint32_t;
+  // bytes this allocator took from the heap with vkAllocateMemory, the accounting used without VK_EXT_memory_budget
+  auto heapUsage( uint32_t heapIndex ) const -> VkDeviceSize;
+
+  // a full heap first calls the handler and retries, then demotes the resource to another heap it may live in that
+  // keeps it host visible if it was
+  void setOutOfMemoryHandler( OutOfMemoryHandler handler );
+
+private:
+  auto bufferRequirements( VkBuffer buffer, bool& dedicated ) const -> VkMemoryRequirements;
+  auto bindBuffer( VkBuffer buffer, const VkMemoryRequirements& requirements, uint32_t memoryType, bool dedicated )
+    -> GpuAllocation;
+  auto allocate( const VkMemoryRequirements& requirements,
+                 uint32_t memoryType,
+                 AllocationKind kind,
+                 bool dedicated,
+                 const VkMemoryDedicatedAllocateInfo& dedicatedInfo ) -> GpuAllocation;
+  auto allocateFromType( const VkMemoryRequirements& requirements,
+                         uint32_t memoryType,
+                         AllocationKind kind,
+                         bool dedicated,
+                         const VkMemoryDedicatedAllocateInfo& dedicatedInfo ) -> GpuAllocation;
+  auto allocateMemory( VkDeviceSize size, uint32_t memoryType, const void* next ) -> VkDeviceMemory;
+  void freeMemory( VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType );
+  auto blockSize( uint32_t memoryType ) const -> VkDeviceSize;
+
+  VkDevice m_device{ VK_NULL_HANDLE };
+  VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+  MemoryPlacement m_placement;
+
+  std::vector<std::unique_ptr<GpuMemoryBlock>> m_blocks;
+  uint32_t m_allocationCount{ 0u };
+  uint32_t m_dedicatedCount{ 0u };
+  VkDeviceSize m_dedicatedBytes{ 0u };
+  uint32_t m_demotionCount{ 0u };
+  std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> m_heapBytes{};
+  OutOfMemoryHandler m_outOfMemory;
+
+  // uploads may come from worker threads
+  mutable std::mutex m_mutex;
+};
@@ -0,0 +1,140 @@
+#include "gpu_profiler.hpp"
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+void GpuProfiler::init( VkDevice device, float timestampPeriod, uint32_t timestampValidBits, uint32_t frameCount )
+{
+  m_device = device;
+  m_nsPerTick = timestampPeriod;
+  m_timestampMask = timestampValidBits >= 64 ? UINT64_MAX : ( uint64_t{ 1 } << timestampValidBits ) - 1;
+  m_frames.clear();
+  m_currentFrame = 0;
+
+  // the graphics queue can't write timestamps, every call below turns into a no op
+  if ( timestampValidBits == 0 )
+    return;
+
+  m_frames.resize( frameCount );
+  for ( auto& frame : m_frames )
+  {
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = maxScopesPerFrame * 2;
+
+    if ( vkCreateQueryPool( m_device, &poolInfo, nullptr, &frame.pool ) != VK_SUCCESS )
+    {
+      throw std::runtime_error( "failed to create timestamp query pool!" );
+    }
+  }
+}
+
+void GpuProfiler::destroy()
+{
+  for ( auto& frame : m_frames )
+  {
+    vkDestroyQueryPool( m_device, frame.pool, nullptr );
+  }
+  m_frames.clear();
+}
+
+void GpuProfiler::beginFrame( VkCommandBuffer cmd, uint32_t slot )
+{
+  if ( !enabled() )
+    return;
+
+  m_currentFrame = slot % m_frames.size();
+  auto& frame = m_frames[m_currentFrame];
+
+  if ( !frame.scopes.empty() )
+  {
+    std::array<uint64_t, maxScopesPerFrame * 2> timestamps{};
+    auto queryCount = static_cast<uint32_t>( frame.scopes.size() * 2 );
+
+    // no WAIT_BIT, if the results are somehow not there yet this frame's numbers are dropped instead
+    auto result = vkGetQueryPoolResults( m_device,
+                                         frame.pool,
+                                         0,
+                                         queryCount,
+                                         queryCount * sizeof( uint64_t ),
+                                         timestamps.data(),
+                                         sizeof( uint64_t ),
+                                         VK_QUERY_RESULT_64_BIT );
+    if ( result == VK_SUCCESS )
+    {
+      for ( size_t i = 0; i < frame.scopes.size(); i++ )
+      {
+        auto ticks = ( timestamps[i * 2 + 1] - timestamps[i * 2] ) & m_timestampMask;
+        auto& scope = m_scopes[frame.scopes[i]];
+        scope.ms.push( static_cast<double>( ticks ) * m_nsPerTick / 1e6 );
+        scope.total++;
+      }
+    }
+    frame.scopes.clear();
+  }
+
+  vkCmdResetQueryPool( cmd, frame.pool, 0, maxScopesPerFrame * 2 );
+}
+
+auto GpuProfiler::beginScope( VkCommandBuffer cmd, const char* name ) -> uint32_t
+{
+  if ( !enabled() )
+    return UINT32_MAX;
+
+  auto& frame = m_frames[m_currentFrame];
+  if ( frame.scopes.size() == maxScopesPerFrame )
+    return UINT32_MAX;
+
+  auto scope = static_cast<uint32_t>( frame.scopes.size() );
+  frame.scopes.push_back( findScope( name ) );
+  vkCmdWriteTimestamp2( cmd, VK_PIPELINE_STAGE_2_NONE, frame.pool, scope * 2 );
+  return scope;
+}
+
+void GpuProfiler::endScope( VkCommandBuffer cmd, uint32_t scope )
+{
+  if ( scope == UINT32_MAX )
+    return;
+
+  vkCmdWriteTimestamp2( cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_frames[m_currentFrame].pool, scope * 2 + 1 );
+}
+
+bool GpuProfiler::enabled() const
+{
+  return !m_frames.empty();
+}
+
+auto GpuProfiler::scopes() const -> const std::vector<GpuScopeStats>&
+{
+  return m_scopes;
+}
+
+bool GpuProfiler::dumpCsv( const std::string& path ) const
+{
+  std::ofstream file( path );
+  if ( !file.is_open() )
+    return false;
+
+  file << "scope,samples,min_ms,avg_ms,p99_ms,max_ms\n";
+  for ( const auto& scope : m_scopes )
+  {
+    file << scope.name << ',' << scope.ms.count() << ',' << scope.ms.min() << ',' << scope.ms.average() << ','
+         << scope.ms.percentile( 99.0 ) << ',' << scope.ms.max() << '\n';
+  }
+  return true;
+}
+
+auto GpuProfiler::findScope( const char* name ) -> uint32_t
+{
+  // a handful of scopes per frame, a linear search is cheaper than hashing the name
+  for ( size_t i = 0; i < m_scopes.size(); i++ )
+  {
+    if ( std::strcmp( m_scopes[i].name.c_str(), name ) == 0 )
+      return static_cast<uint32_t>( i );
+  }
+
+  m_scopes.push_back( GpuScopeStats{ name, {}, 0u } );
+  return static_cast<uint32_t>( m_scopes.size() - 1 );
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "frame_stats.hpp"
+
+struct GpuScopeStats
+{
+  std::string name;
+  RollingStats<256> ms;
+  // every sample ever pushed, tells a new sample apart from the window just holding the old one
+  uint64_t total{ 0u };
+};
+
+// timestamp queries around named scopes of a frame, every frame slot owns a query pool and reads it back the next
+// time the slot comes around, the slot was already waited on by then so fetching the results never stalls
+class GpuProfiler
+{
+public:
+  void init( VkDevice device, float timestampPeriod, uint32_t timestampValidBits, uint32_t frameCount );
+  void destroy();
+
+  // collects what the slot measured last time and resets its queries, has to be called outside of any rendering
+  void beginFrame( VkCommandBuffer cmd, uint32_t slot );
+  auto beginScope( VkCommandBuffer cmd, const char* name ) -> uint32_t;
+  void endScope( VkCommandBuffer cmd, uint32_t scope );
+
+  bool enabled() const;
+  auto scopes() const -> const std::vector<GpuScopeStats>&;
+  bool dumpCsv( const std::string& path ) const;
+
+private:
+  static constexpr uint32_t maxScopesPerFrame = 32;
+
+  struct FrameQueries
+  {
+    VkQueryPool pool{ VK_NULL_HANDLE };
+    // index into m_scopes for every begin/end query pair written this frame
+    std::vector<uint32_t> scopes;
+  };
+
+  auto findScope( const char* name ) -> uint32_t;
+
+  VkDevice m_device{ VK_NULL_HANDLE };
+  double m_nsPerTick{ 1.0 };
+  uint64_t m_timestampMask{ 0u };
+  std::vector<FrameQueries> m_frames;
+  uint32_t m_currentFrame{ 0u };
+  std::vector<GpuScopeStats> m_scopes;
+};
@@ -0,0 +1,313 @@
+#include "ktx2.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+constexpr std::array<uint8_t, 12> identifier = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+                                                 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+// identifier, the nine header words, the dfd and kvd offsets and lengths, the sgd offset and length
+constexpr size_t headerBytes = 80;
+constexpr size_t levelIndexBytes = 24;
+
+// khronos data format descriptor values, see the KHR_DF_* enums of the data format specification
+constexpr uint8_t colorModelRgbsda = 1;
+constexpr uint8_t colorModelBc1a = 128;
+constexpr uint8_t colorModelBc3 = 130;
+constexpr uint8_t colorModelBc5 = 132;
+constexpr uint8_t colorModelBc7 = 134;
+constexpr uint8_t primariesBt709 = 1;
+constexpr uint8_t transferLinear = 1;
+constexpr uint8_t transferSrgb = 2;
+constexpr uint8_t channelRed = 0;
+constexpr uint8_t channelGreen = 1;
+constexpr uint8_t channelBlue = 2;
+constexpr uint8_t channelAlpha = 15;
+// set on the alpha sample of srgb formats, alpha is never srgb encoded
+constexpr uint8_t sampleLinear = 0x10;
+
+struct FormatInfo
+{
+  VkFormat format;
+  TexelBlock block;
+  uint8_t colorModel;
+  bool srgb;
+};
+
+constexpr FormatInfo formats[] = {
+  { VK_FORMAT_R8G8B8A8_UNORM, { 4, 1 }, colorModelRgbsda, false },
+  { VK_FORMAT_R8G8B8A8_SRGB, { 4, 1 }, colorModelRgbsda, true },
+  { VK_FORMAT_BC1_RGB_UNORM_BLOCK, { 8, 4 }, colorModelBc1a, false },
+  { VK_FORMAT_BC1_RGB_SRGB_BLOCK, { 8, 4 }, colorModelBc1a, true },
+  { VK_FORMAT_BC3_UNORM_BLOCK, { 16, 4 }, colorModelBc3, false },
+  { VK_FORMAT_BC3_SRGB_BLOCK, { 16, 4 }, colorModelBc3, true },
+  { VK_FORMAT_BC5_UNORM_BLOCK, { 16, 4 }, colorModelBc5, false },
+  { VK_FORMAT_BC7_UNORM_BLOCK, { 16, 4 }, colorModelBc7, false },
+  { VK_FORMAT_BC7_SRGB_BLOCK, { 16, 4 }, colorModelBc7, true },
+};
+
+auto formatInfo( VkFormat format ) -> const FormatInfo&
+{
+  auto it = std::find_if(
+    std::begin( formats ), std::end( formats ), [format]( const FormatInfo& info ) { return info.format == format; } );
+  if ( it == std::end( formats ) )
+  {
+    throw std::invalid_argument( "texture format has no ktx2 support!" );
+  }
+  return *it;
+}
+
+auto levelBytes( const TexelBlock& block, uint32_t width, uint32_t height, uint32_t level ) -> size_t
+{
+  auto levelWidth = std::max( width >> level, 1u );
+  auto levelHeight = std::max( height >> level, 1u );
+  auto blocksWide = ( levelWidth + block.extent - 1 ) / block.extent;
+  auto blocksHigh = ( levelHeight + block.extent - 1 ) / block.extent;
+  return static_cast<size_t>( blocksWide ) * blocksHigh * block.bytes;
+}
+
+void put8( std::vector<uint8_t>& out, uint8_t value )
+{
+  out.push_back( value );
+}
+
+void put16( std::vector<uint8_t>& out, uint16_t value )
+{
+  out.push_back( static_cast<uint8_t>( value ) );
+  out.push_back( static_cast<uint8_t>( value >> 8 ) );
+}
+
+void put32( std::vector<uint8_t>& out, uint32_t value )
+{
+  for ( uint32_t i = 0; i < 4; i++ )
+    out.push_back( static_cast<uint8_t>( value >> ( i * 8 ) ) );
+}
+
+void put64( std::vector<uint8_t>& out, uint64_t value )
+{
+  for ( uint32_t i = 0; i < 8; i++ )
+    out.push_back( static_cast<uint8_t>( value >> ( i * 8 ) ) );
+}
+
+auto get32( const std::vector<uint8_t>& in, size_t offset ) -> uint32_t
+{
+  uint32_t value = 0;
+  for ( uint32_t i = 0; i < 4; i++ )
+    value |= static_cast<uint32_t>( in[offset + i] ) << ( i * 8 );
+  return value;
+}
+
+auto get64( const std::vector<uint8_t>& in, size_t offset ) -> uint64_t
+{
+  return get32( in, offset ) | ( static_cast<uint64_t>( get32( in, offset + 4 ) ) << 32 );
+}
+
+struct Sample
+{
+  uint16_t bitOffset;
+  // bits minus one
+  uint8_t bitLength;
+  uint8_t channel;
+  uint32_t upper;
+};
+
+// the basic descriptor block, one sample per channel of the block, BC formats describe their whole 64 bit halves
+auto dataFormatDescriptor( const FormatInfo& info ) -> std::vector<uint8_t>
+{
+  uint8_t alpha = channelAlpha | ( info.srgb ? sampleLinear : 0 );
+  std::vector<Sample> samples;
+  switch ( info.colorModel )
+  {
+    case colorModelRgbsda:
+      samples = { { 0, 7, channelRed, 255 },
+                  { 8, 7, channelGreen, 255 },
+                  { 16, 7, channelBlue, 255 },
+                  { 24, 7, alpha, 255 } };
+      break;
+    case colorModelBc1a:
+      samples = { { 0, 63, channelRed, UINT32_MAX } };
+      break;
+    case colorModelBc3:
+      samples = { { 0, 63, alpha, UINT32_MAX }, { 64, 63, channelRed, UINT32_MAX } };
+      break;
+    case colorModelBc5:
+      samples = { { 0, 63, channelRed, UINT32_MAX }, { 64, 63, channelGreen, UINT32_MAX } };
+      break;
+    case colorModelBc7:
+      samples = { { 0, 127, channelRed, UINT32_MAX } };
+      break;
+  }
+
+  auto blockSize = static_cast<uint16_t>( 24 + 16 * samples.size() );
+  std::vector<uint8_t> dfd;
+  put32( dfd, 4u + blockSize );
+  // khronos vendor, basic descriptor type, version 1.3
+  put32( dfd, 0 );
+  put16( dfd, 2 );
+  put16( dfd, blockSize );
+  put8( dfd, info.colorModel );
+  put8( dfd, primariesBt709 );
+  put8( dfd, info.srgb ? transferSrgb : transferLinear );
+  // straight alpha
+  put8( dfd, 0 );
+  put8( dfd, static_cast<uint8_t>( info.block.extent - 1 ) );
+  put8( dfd, static_cast<uint8_t>( info.block.extent - 1 ) );
+  put8( dfd, 0 );
+  put8( dfd, 0 );
+  put8( dfd, static_cast<uint8_t>( info.block.bytes ) );
+  for ( uint32_t i = 1; i < 8; i++ )
+    put8( dfd, 0 );
+
+  for ( const auto& sample : samples )
+  {
+    put16( dfd, sample.bitOffset );
+    put8( dfd, sample.bitLength );
+    put8( dfd, sample.channel );
+    // sample position, the block origin
+    put32( dfd, 0 );
+    put32( dfd, 0 );
+    put32( dfd, sample.upper );
+  }
+  return dfd;
+}
+} // namespace
+
+auto texelBlock( VkFormat format ) -> TexelBlock
+{
+  return formatInfo( format ).block;
+}
+
+void writeKtx2( const std::string& path, const Ktx2Texture& texture )
+{
+  const auto& info = formatInfo( texture.format );
+  auto levelCount = static_cast<uint32_t>( texture.levels.size() );
+  if ( levelCount == 0 || texture.width == 0 || texture.height == 0 )
+  {
+    throw std::invalid_argument( "ktx2 texture has no texels!" );
+  }
+  for ( uint32_t level = 0; level < levelCount; level++ )
+  {
+    if ( texture.levels[level].size() != levelBytes( info.block, texture.width, texture.height, level ) )
+    {
+      throw std::invalid_argument( "ktx2 level size does not match its extent!" );
+    }
+  }
+
+  auto dfd = dataFormatDescriptor( info );
+  auto dfdOffset = headerBytes + levelIndexBytes * levelCount;
+
+  // level data starts after the descriptor, smallest level first, each one aligned to the block size and to 4
+  auto alignment = std::lcm<size_t>( info.block.bytes, 4 );
+  std::vector<size_t> levelOffsets( levelCount );
+  auto end = dfdOffset + dfd.size();
+  for ( uint32_t level = levelCount; level-- > 0; )
+  {
+    end = ( end + alignment - 1 ) / alignment * alignment;
+    levelOffsets[level] = end;
+    end += texture.levels[level].size();
+  }
+
+  std::vector<uint8_t> file( identifier.begin(), identifier.end() );
+  file.reserve( end );
+  put32( file, static_cast<uint32_t>( texture.format ) );
+  // typeSize, 1 for block compressed and 8 bit formats
+  put32( file, 1 );
+  put32( file, texture.width );
+  put32( file, texture.height );
+  // pixelDepth, layerCount, faceCount, levelCount, supercompressionScheme
+  put32( file, 0 );
+  put32( file, 0 );
+  put32( file, 1 );
+  put32( file, levelCount );
+  put32( file, 0 );
+  put32( file, static_cast<uint32_t>( dfdOffset ) );
+  put32( file, static_cast<uint32_t>( dfd.size() ) );
+  // no key value data and no supercompression global data
+  put32( file, 0 );
+  put32( file, 0 );
+  put64( file, 0 );
+  put64( file, 0 );
+
+  for ( uint32_t level = 0; level < levelCount; level++ )
+  {
+    put64( file, levelOffsets[level] );
+    put64( file, texture.levels[level].size() );
+    put64( file, texture.levels[level].size() );
+  }
+  file.insert( file.end(), dfd.begin(), dfd.end() );
+
+  for ( uint32_t level = levelCount; level-- > 0; )
+  {
+    file.resize( levelOffsets[level], 0 );
+    file.insert( file.end(), texture.levels[level].begin(), texture.levels[level].end() );
+  }
+
+  std::ofstream stream( path, std::ios::binary );
+  if ( !stream.is_open() )
+  {
+    throw std::runtime_error( "failed to open ktx2 file for writing!" );
+  }
+  stream.write( reinterpret_cast<const char*>( file.data() ), static_cast<std::streamsize>( file.size() ) );
+}
+
+auto readKtx2( const std::string& path ) -> Ktx2Texture
+{
+  std::ifstream stream( path, std::ios::ate | std::ios::binary );
+  if ( !stream.is_open() )
+  {
+    throw std::runtime_error( "failed to open ktx2 file!" );
+  }
+  std::vector<uint8_t> file( static_cast<size_t>( stream.tellg() ) );
+  stream.seekg( 0 );
+  stream.read( reinterpret_cast<char*>( file.data() ), static_cast<std::streamsize>( file.size() ) );
+
+  if ( file.size() < headerBytes || !std::equal( identifier.begin(), identifier.end(), file.begin() ) )
+  {
+    throw std::runtime_error( "file is not a ktx2 texture!" );
+  }
+
+  Ktx2Texture texture;
+  texture.format = static_cast<VkFormat>( get32( file, 12 ) );
+  texture.width = get32( file, 20 );
+  texture.height = get32( file, 24 );
+  auto depth = get32( file, 28 );
+  auto layers = get32( file, 32 );
+  auto faces = get32( file, 36 );
+  // 0 asks the loader to generate the chain, the single level is all there is
+  auto levelCount = std::max( get32( file, 40 ), 1u );
+  auto supercompression = get32( file, 44 );
+
+  if ( texture.width == 0 || texture.height == 0 || depth != 0 || layers > 1 || faces != 1 )
+  {
+    throw std::runtime_error( "ktx2 file is not a single 2d texture!" );
+  }
+  if ( supercompression != 0 )
+  {
+    throw std::runtime_error( "supercompressed ktx2 files are not supported!" );
+  }
+
+  auto block = texelBlock( texture.format );
+  if ( headerBytes + levelIndexBytes * levelCount > file.size() )
+  {
+    throw std::runtime_error( "ktx2 level index is truncated!" );
+  }
+
+  texture.levels.resize( levelCount );
+  for ( uint32_t level = 0; level < levelCount; level++ )
+  {
+    auto offset = get64( file, headerBytes + levelIndexBytes * level );
+    auto length = get64( file, headerBytes + levelIndexBytes * level + 8 );
+    if ( length != levelBytes( block, texture.width, texture.height, level ) || offset > file.size() ||
+         length > file.size() - offset )
+    {
+      throw std::runtime_error( "ktx2 level is truncated!" );
+    }
+    texture.levels[level].assign( file.begin() + static_cast<ptrdiff_t>( offset ),
+                                  file.begin() + static_cast<ptrdiff_t>( offset + length ) );
+  }
+  return texture;
+}
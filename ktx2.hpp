@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// a 2d texture as a KTX2 file stores it, one layer, one face, no supercompression
+struct Ktx2Texture
+{
+  VkFormat format{ VK_FORMAT_UNDEFINED };
+  uint32_t width{ 0u };
+  uint32_t height{ 0u };
+  // the largest level first, every level tightly packed rows of texel blocks
+  std::vector<std::vector<uint8_t>> levels;
+};
+
+// how the texels of a format are grouped, 4 byte blocks of one texel for rgba8
+struct TexelBlock
+{
+  uint32_t bytes;
+  uint32_t extent;
+};
+
+// the BC1, BC3, BC5 and BC7 formats the texture compressor writes and plain rgba8, throws for anything else
+auto texelBlock( VkFormat format ) -> TexelBlock;
+
+void writeKtx2( const std::string& path, const Ktx2Texture& texture );
+// throws for files with anything this renderer would have to transcode, depth, layers, cube faces or supercompression
+auto readKtx2( const std::string& path ) -> Ktx2Texture;
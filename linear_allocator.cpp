@@ -0,0 +1,38 @@
+#include "linear_allocator.hpp"
+
+void LinearAllocator::init( void* mapped, VkDeviceSize regionOffset, VkDeviceSize regionSize, VkDeviceSize alignment )
+{
+  m_mapped = static_cast<uint8_t*>( mapped ) + regionOffset;
+  m_regionOffset = regionOffset;
+  m_regionSize = regionSize;
+  m_alignment = alignment > 0 ? alignment : 1;
+  m_head = 0;
+}
+
+void LinearAllocator::reset()
+{
+  m_head = 0;
+}
+
+auto LinearAllocator::allocate( VkDeviceSize size ) -> std::optional<LinearAllocation>
+{
+  // alignments from the device limits are powers of two
+  auto offset = ( m_head + m_alignment - 1 ) & ~( m_alignment - 1 );
+  if ( offset + size > m_regionSize )
+  {
+    return std::nullopt;
+  }
+
+  m_head = offset + size;
+  return LinearAllocation{ m_regionOffset + offset, m_mapped + offset };
+}
+
+auto LinearAllocator::used() const -> VkDeviceSize
+{
+  return m_head;
+}
+
+auto LinearAllocator::capacity() const -> VkDeviceSize
+{
+  return m_regionSize;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <vulkan/vulkan.h>
+
+struct LinearAllocation
+{
+  // relative to the start of the backing buffer, usable as a dynamic offset
+  VkDeviceSize offset;
+  void* mapped;
+};
+
+// bump allocator over a persistently mapped region of a bigger buffer, it owns no vulkan objects, reset() hands the
+// whole region out again once the gpu is done with it
+class LinearAllocator
+{
+public:
+  void init( void* mapped, VkDeviceSize regionOffset, VkDeviceSize regionSize, VkDeviceSize alignment );
+  void reset();
+
+  auto allocate( VkDeviceSize size ) -> std::optional<LinearAllocation>;
+
+  auto used() const -> VkDeviceSize;
+  auto capacity() const -> VkDeviceSize;
+
+private:
+  uint8_t* m_mapped{ nullptr };
+  VkDeviceSize m_regionOffset{ 0u };
+  VkDeviceSize m_regionSize{ 0u };
+  VkDeviceSize m_alignment{ 1u };
+  VkDeviceSize m_head{ 0u };
+};
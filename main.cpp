@@ -1,12 +1,40 @@
 ﻿#define SDL_MAIN_HANDLED
 #include <iostream>
+#include <string_view>
 #include "vulkan_backend.hpp"
 
-int main()
+// enttTest [--headless] [--frames N] [--size WxH] [--readback out.png]
+int main( int argc, char** argv )
 {
   try
   {
     VulkanBase base{};
+
+    bool headless{ false };
+    HeadlessConfig config{};
+    for ( int i = 1; i < argc; i++ )
+    {
+      std::string_view arg{ argv[i] };
+      bool hasValue = i + 1 < argc;
+      if ( arg == "--headless" )
+        headless = true;
+      else if ( arg == "--frames" && hasValue )
+        config.frameCount = static_cast<uint32_t>( std::stoul( argv[++i] ) );
+      else if ( arg == "--size" && hasValue )
+      {
+        std::string size{ argv[++i] };
+        auto separator = size.find( 'x' );
+        config.width = static_cast<uint32_t>( std::stoul( size.substr( 0, separator ) ) );
+        config.height = static_cast<uint32_t>( std::stoul( size.substr( separator + 1 ) ) );
+      }
+      else if ( arg == "--readback" && hasValue )
+        config.readbackPath = argv[++i];
+      else
+        std::cout << "ignoring argument " << arg << "\n";
+    }
+
+    if ( headless )
+      base.setHeadless( config );
     base.run();
   }
   catch ( std::exception& e )
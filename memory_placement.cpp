@@ -0,0 +1,104 @@
+#include "memory_placement.hpp"
+#include <initializer_list>
+#include <stdexcept>
+
+namespace
+{
+// the classic pci bar window, a host visible device local heap larger than this is resizable bar or unified memory
+constexpr VkDeviceSize legacyBarSize = 256ull * 1024 * 1024;
+
+constexpr VkMemoryPropertyFlags deviceLocal = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+constexpr VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+constexpr VkMemoryPropertyFlags hostWritable =
+  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+} // namespace
+
+void MemoryPlacement::init( const VkPhysicalDeviceMemoryProperties& properties )
+{
+  m_properties = properties;
+  m_directUploads = false;
+  m_unified = true;
+
+  for ( uint32_t i = 0; i < m_properties.memoryHeapCount; i++ )
+  {
+    if ( !( m_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ) )
+      m_unified = false;
+  }
+
+  for ( uint32_t i = 0; i < m_properties.memoryTypeCount; i++ )
+  {
+    const auto& type = m_properties.memoryTypes[i];
+    if ( ( type.propertyFlags & ( deviceLocal | hostWritable ) ) == ( deviceLocal | hostWritable ) &&
+         m_properties.memoryHeaps[type.heapIndex].size > legacyBarSize )
+    {
+      m_directUploads = true;
+    }
+  }
+}
+
+auto MemoryPlacement::memoryType( MemoryUsage usage, uint32_t typeFilter ) const -> uint32_t
+{
+  struct Preference
+  {
+    VkMemoryPropertyFlags required;
+    VkMemoryPropertyFlags avoided;
+  };
+
+  // best first, the last entry of every list is what any conformant driver has to offer
+  auto pick = [&]( std::initializer_list<Preference> preferences ) -> uint32_t {
+    for ( const auto& preference : preferences )
+    {
+      auto type = find( typeFilter, preference.required, preference.avoided );
+      if ( type >= 0 )
+        return static_cast<uint32_t>( type );
+    }
+    throw std::runtime_error( "failed to find suitable memory type!" );
+  };
+
+  switch ( usage )
+  {
+    case MemoryUsage::GpuOnly:
+      // keep the small bar window free for the resources the cpu actually writes
+      return pick( { { deviceLocal, hostVisible }, { deviceLocal, 0 }, { 0, 0 } } );
+    case MemoryUsage::UploadOnce:
+      if ( m_directUploads )
+        return pick( { { deviceLocal | hostWritable, 0 }, { deviceLocal, hostVisible }, { 0, 0 } } );
+      return pick( { { deviceLocal, hostVisible }, { deviceLocal, 0 }, { 0, 0 } } );
+    case MemoryUsage::Dynamic:
+      // per frame data is small, even the legacy bar window holds it and the gpu reads it from its own memory
+      return pick( { { deviceLocal | hostWritable, 0 }, { hostWritable, 0 } } );
+    case MemoryUsage::Upload:
+      // the copy engine reads system memory just as fast, the bar window stays for what the shaders read in place
+      return pick( { { hostWritable, deviceLocal }, { hostWritable, 0 } } );
+    case MemoryUsage::Readback:
+      return pick( { { hostWritable | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 0 }, { hostWritable, 0 } } );
+  }
+
+  throw std::invalid_argument( "unknown memory usage!" );
+}
+
+bool MemoryPlacement::directUploads() const
+{
+  return m_directUploads;
+}
+
+auto MemoryPlacement::describe() const -> const char*
+{
+  if ( m_unified )
+    return "unified memory";
+  return m_directUploads ? "resizable bar" : "staged uploads";
+}
+
+auto MemoryPlacement::find( uint32_t typeFilter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags avoided ) const
+  -> int32_t
+{
+  for ( uint32_t i = 0; i < m_properties.memoryTypeCount; i++ )
+  {
+    auto flags = m_properties.memoryTypes[i].propertyFlags;
+    if ( ( typeFilter & ( 1 << i ) ) && ( flags & required ) == required && !( flags & avoided ) )
+    {
+      return static_cast<int32_t>( i );
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+// what the cpu and gpu do with a resource over its lifetime, the placement turns it into a memory type
+enum class MemoryUsage
+{
+  // render targets, textures, anything only the gpu touches after creation
+  GpuOnly,
+  // written once by the cpu and read by the gpu from then on, vertex and index data
+  UploadOnce,
+  // rewritten by the cpu every frame, uniforms
+  Dynamic,
+  // written by the cpu and only read by transfer copies, the staging ring
+  Upload,
+  // written by the gpu and read back by the cpu
+  Readback
+};
+
+// picks memory types from the device's memory properties, types are tried in the order the driver lists them since
+// the spec has it sort equal capabilities by performance
+class MemoryPlacement
+{
+public:
+  void init( const VkPhysicalDeviceMemoryProperties& properties );
+
+  auto memoryType( MemoryUsage usage, uint32_t typeFilter ) const -> uint32_t;
+  // device local memory the cpu can write is big enough to hold upload once data, resizable bar or unified memory
+  // (integrated gpus, lavapipe), such resources are written in place instead of staged
+  bool directUploads() const;
+  auto describe() const -> const char*;
+
+private:
+  auto find( uint32_t typeFilter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags avoided ) const -> int32_t;
+
+  VkPhysicalDeviceMemoryProperties m_properties{};
+  bool m_directUploads{ false };
+  bool m_unified{ false };
+};
@@ -0,0 +1,91 @@
+#include "mip_chain.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+auto srgbToLinearTable() -> const std::array<float, 256>&
+{
+  static const auto table = [] {
+    std::array<float, 256> values{};
+    for ( size_t i = 0; i < values.size(); i++ )
+    {
+      auto c = static_cast<float>( i ) / 255.0f;
+      values[i] = c <= 0.04045f ? c / 12.92f : std::pow( ( c + 0.055f ) / 1.055f, 2.4f );
+    }
+    return values;
+  }();
+  return table;
+}
+
+auto linearToSrgb( float c ) -> uint8_t
+{
+  c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow( c, 1.0f / 2.4f ) - 0.055f;
+  return static_cast<uint8_t>( std::clamp( c, 0.0f, 1.0f ) * 255.0f + 0.5f );
+}
+} // namespace
+
+auto mipLevelCount( uint32_t width, uint32_t height ) -> uint32_t
+{
+  return static_cast<uint32_t>( std::bit_width( std::max( width, height ) ) );
+}
+
+auto buildMipChain( const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb )
+  -> std::vector<uint8_t>
+{
+  size_t total = 0;
+  for ( uint32_t level = 0; level < mipLevels; level++ )
+  {
+    total += static_cast<size_t>( std::max( 1u, width >> level ) ) * std::max( 1u, height >> level ) * 4;
+  }
+
+  std::vector<uint8_t> chain( total );
+  memcpy( chain.data(), pixels, static_cast<size_t>( width ) * height * 4 );
+
+  const auto& toLinear = srgbToLinearTable();
+  size_t srcOffset = 0;
+  size_t dstOffset = static_cast<size_t>( width ) * height * 4;
+  for ( uint32_t level = 1; level < mipLevels; level++ )
+  {
+    auto srcWidth = std::max( 1u, width >> ( level - 1 ) );
+    auto srcHeight = std::max( 1u, height >> ( level - 1 ) );
+    auto dstWidth = std::max( 1u, width >> level );
+    auto dstHeight = std::max( 1u, height >> level );
+    const auto* src = chain.data() + srcOffset;
+    auto* dst = chain.data() + dstOffset;
+
+    for ( uint32_t y = 0; y < dstHeight; y++ )
+    {
+      // a level one texel wide or tall repeats its edge, the odd last row or column of a level is left out
+      uint32_t rows[2] = { std::min( y * 2, srcHeight - 1 ), std::min( y * 2 + 1, srcHeight - 1 ) };
+      for ( uint32_t x = 0; x < dstWidth; x++ )
+      {
+        uint32_t columns[2] = { std::min( x * 2, srcWidth - 1 ), std::min( x * 2 + 1, srcWidth - 1 ) };
+        for ( uint32_t channel = 0; channel < 4; channel++ )
+        {
+          // alpha is never srgb encoded
+          bool linearize = srgb && channel < 3;
+          float sum = 0.0f;
+          for ( auto row : rows )
+          {
+            for ( auto column : columns )
+            {
+              auto value = src[( static_cast<size_t>( row ) * srcWidth + column ) * 4 + channel];
+              sum += linearize ? toLinear[value] : static_cast<float>( value );
+            }
+          }
+          auto average = sum * 0.25f;
+          dst[( static_cast<size_t>( y ) * dstWidth + x ) * 4 + channel] =
+            linearize ? linearToSrgb( average ) : static_cast<uint8_t>( average + 0.5f );
+        }
+      }
+    }
+
+    srcOffset = dstOffset;
+    dstOffset += static_cast<size_t>( dstWidth ) * dstHeight * 4;
+  }
+  return chain;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// levels from width x height down to 1x1
+auto mipLevelCount( uint32_t width, uint32_t height ) -> uint32_t;
+// every level of an image with 4 bytes per texel packed one after the other starting with the given one, each level
+// is a 2x2 box filter of the one before, averaged in linear space when the texels are srgb encoded, for formats the
+// gpu cannot blit with a linear filter
+auto buildMipChain( const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb )
+  -> std::vector<uint8_t>;
@@ -0,0 +1,73 @@
+#include "mip_streaming.hpp"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+auto planMipResidency( std::span<const StreamedMips> textures, uint64_t budget ) -> std::vector<uint32_t>
+{
+  std::vector<uint32_t> targets( textures.size() );
+  uint64_t used = 0;
+  for ( size_t i = 0; i < textures.size(); i++ )
+  {
+    const auto& texture = textures[i];
+    targets[i] = texture.tailLevel;
+    for ( auto level = texture.tailLevel; level < texture.levelBytes.size(); level++ )
+      used += texture.levelBytes[level];
+  }
+
+  // the budget is a target, the tails go over it rather than leaving a texture with nothing to sample
+  auto remaining = budget > used ? budget - used : 0;
+
+  // grows targets[i] one level towards stop while the levels fit, in the order of the priorities given
+  auto grow = [&]( auto priority, auto stop ) {
+    using Entry = std::pair<decltype( priority( 0 ) ), size_t>;
+    std::priority_queue<Entry> queue;
+    for ( size_t i = 0; i < textures.size(); i++ )
+    {
+      if ( targets[i] > stop( i ) )
+        queue.push( { priority( i ), i } );
+    }
+
+    while ( !queue.empty() )
+    {
+      auto i = queue.top().second;
+      queue.pop();
+
+      // a level that does not fit ends this texture, a cheaper one of another may still fit
+      auto cost = textures[i].levelBytes[targets[i] - 1];
+      if ( cost > remaining )
+        continue;
+
+      remaining -= cost;
+      targets[i]--;
+      if ( targets[i] > stop( i ) )
+        queue.push( { priority( i ), i } );
+    }
+  };
+
+  grow(
+    [&]( size_t i ) { return std::make_pair( targets[i] - textures[i].wantedLevel, textures[i].lastRequested ); },
+    [&]( size_t i ) { return textures[i].wantedLevel; } );
+  grow( [&]( size_t i ) { return textures[i].lastRequested; },
+        [&]( size_t i ) { return std::min( textures[i].residentLevel, targets[i] ); } );
+  return targets;
+}
+
+auto mipTailLevel( uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t tailExtent ) -> uint32_t
+{
+  uint32_t level = 0;
+  while ( level + 1 < mipLevels && std::max( width >> level, height >> level ) > tailExtent )
+    level++;
+  return level;
+}
+
+auto mipForScreenSize( uint32_t width, uint32_t height, uint32_t mipLevels, float screenPixels ) -> uint32_t
+{
+  auto texels = static_cast<float>( std::max( width, height ) );
+  if ( screenPixels >= texels )
+    return 0;
+
+  // level n has texels / 2^n texels across, the finest one still at or below one texel per pixel
+  auto level = static_cast<uint32_t>( std::floor( std::log2( texels / std::max( screenPixels, 1.0f ) ) ) );
+  return std::min( level, mipLevels - 1 );
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// one streamed texture as the planner sees it, levels are counted from the largest, a lower level is a finer one
+struct StreamedMips
+{
+  // bytes of every level, the largest first
+  std::vector<uint64_t> levelBytes;
+  // the coarse levels that stay resident no matter what
+  uint32_t tailLevel;
+  // finest level resident right now
+  uint32_t residentLevel;
+  // finest level the frames asked for, the tail when nothing did
+  uint32_t wantedLevel;
+  // frame of the last request, ties between textures go to the more recent one
+  uint64_t lastRequested;
+};
+
+// finest level every texture should keep resident so that all of them together fit in budget bytes
+//
+// tails come first, then the wanted levels one level at a time, the texture furthest from what it wants first, so a
+// tight budget leaves everything a little blurry rather than a few textures sharp and the rest at their tails, finer
+// levels nobody asks for anymore are kept afterwards as long as they still fit, the most recently wanted ones first
+auto planMipResidency( std::span<const StreamedMips> textures, uint64_t budget ) -> std::vector<uint32_t>;
+// first level whose larger side is at most tailExtent, the last level when even that is larger
+auto mipTailLevel( uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t tailExtent ) -> uint32_t;
+// finest level with at least one texel per pixel when the larger side of the texture covers screenPixels pixels
+auto mipForScreenSize( uint32_t width, uint32_t height, uint32_t mipLevels, float screenPixels ) -> uint32_t;
@@ -0,0 +1,105 @@
+#include "range_allocator.hpp"
+#include <algorithm>
+
+void RangeAllocator::init( uint64_t capacity )
+{
+  m_freeRanges.clear();
+  m_freeRanges.emplace( 0, capacity );
+  m_capacity = capacity;
+  m_freeBytes = capacity;
+}
+
+auto RangeAllocator::allocate( uint64_t size, uint64_t alignment ) -> std::optional<uint64_t>
+{
+  alignment = std::max<uint64_t>( alignment, 1 );
+
+  auto best = m_freeRanges.end();
+  uint64_t bestWaste{ UINT64_MAX };
+  for ( auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it )
+  {
+    auto aligned = ( it->first + alignment - 1 ) / alignment * alignment;
+    auto end = it->first + it->second;
+    if ( aligned + size > end )
+      continue;
+
+    // the smallest range that still fits leaves the big ones for big requests
+    auto waste = it->second - size;
+    if ( waste < bestWaste )
+    {
+      best = it;
+      bestWaste = waste;
+      if ( waste == 0 )
+        break;
+    }
+  }
+
+  if ( best == m_freeRanges.end() )
+    return std::nullopt;
+
+  auto rangeOffset = best->first;
+  auto rangeEnd = best->first + best->second;
+  auto offset = ( rangeOffset + alignment - 1 ) / alignment * alignment;
+  m_freeRanges.erase( best );
+
+  // the alignment padding in front and whatever is left behind stay free
+  if ( offset > rangeOffset )
+    m_freeRanges.emplace( rangeOffset, offset - rangeOffset );
+  if ( offset + size < rangeEnd )
+    m_freeRanges.emplace( offset + size, rangeEnd - offset - size );
+
+  m_freeBytes -= size;
+  return offset;
+}
+
+void RangeAllocator::free( uint64_t offset, uint64_t size )
+{
+  auto it = m_freeRanges.emplace( offset, size ).first;
+  m_freeBytes += size;
+
+  auto next = std::next( it );
+  if ( next != m_freeRanges.end() && it->first + it->second == next->first )
+  {
+    it->second += next->second;
+    m_freeRanges.erase( next );
+  }
+
+  if ( it != m_freeRanges.begin() )
+  {
+    auto previous = std::prev( it );
+    if ( previous->first + previous->second == it->first )
+    {
+      previous->second += it->second;
+      m_freeRanges.erase( it );
+    }
+  }
+}
+
+auto RangeAllocator::capacity() const -> uint64_t
+{
+  return m_capacity;
+}
+
+auto RangeAllocator::freeBytes() const -> uint64_t
+{
+  return m_freeBytes;
+}
+
+auto RangeAllocator::largestFreeRange() const -> uint64_t
+{
+  uint64_t largest{ 0u };
+  for ( const auto& [offset, size] : m_freeRanges )
+  {
+    largest = std::max( largest, size );
+  }
+  return largest;
+}
+
+auto RangeAllocator::freeRangeCount() const -> size_t
+{
+  return m_freeRanges.size();
+}
+
+bool RangeAllocator::empty() const
+{
+  return m_freeBytes == m_capacity;
+}
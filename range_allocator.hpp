@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <optional>
+
+// offset bookkeeping for one contiguous range, best fit over a free list kept sorted by offset so neighbours merge
+// back together when freed, it never touches the memory it describes
+class RangeAllocator
+{
+public:
+  void init( uint64_t capacity );
+
+  auto allocate( uint64_t size, uint64_t alignment ) -> std::optional<uint64_t>;
+  // offset and size have to be exactly what allocate handed out
+  void free( uint64_t offset, uint64_t size );
+
+  auto capacity() const -> uint64_t;
+  auto freeBytes() const -> uint64_t;
+  auto largestFreeRange() const -> uint64_t;
+  auto freeRangeCount() const -> size_t;
+  bool empty() const;
+
+private:
+  // offset -> size of every free range
+  std::map<uint64_t, uint64_t> m_freeRanges;
+  uint64_t m_capacity{ 0u };
+  uint64_t m_freeBytes{ 0u };
+};
@@ -0,0 +1,389 @@
+#include "render_graph.hpp"
+#include <algorithm>
+#include <queue>
+#include <stdexcept>
+
+void RenderGraph::init( VkDevice device, GpuAllocator& allocator, BarrierTracker& barriers, DeletionQueue& deletions )
+{
+  m_device = device;
+  m_allocator = &allocator;
+  m_barriers = &barriers;
+  m_deletions = &deletions;
+}
+
+void RenderGraph::destroy()
+{
+  forgetTransients( m_transients );
+  destroyTransients( m_transients );
+  m_transients = {};
+  begin();
+}
+
+void RenderGraph::begin()
+{
+  m_resources.clear();
+  m_passes.clear();
+  m_order.clear();
+}
+
+auto RenderGraph::importImage( std::string name, VkImage image, VkImageView view, VkPipelineStageFlags2 acquireStage )
+  -> GraphResource
+{
+  Resource resource{};
+  resource.name = std::move( name );
+  resource.image = image;
+  resource.view = view;
+  resource.acquireStage = acquireStage;
+  m_resources.push_back( std::move( resource ) );
+  return static_cast<GraphResource>( m_resources.size() - 1 );
+}
+
+auto RenderGraph::createImage( std::string name, const GraphImageDesc& desc ) -> GraphResource
+{
+  Resource resource{};
+  resource.name = std::move( name );
+  resource.transient = desc;
+  m_resources.push_back( std::move( resource ) );
+  return static_cast<GraphResource>( m_resources.size() - 1 );
+}
+
+void RenderGraph::addPass( GraphPass pass )
+{
+  m_passes.push_back( std::move( pass ) );
+}
+
+void RenderGraph::output( GraphResource resource, ImageUse finalUse )
+{
+  m_resources.at( resource ).finalUse = finalUse;
+}
+
+void RenderGraph::compile()
+{
+  sortPasses();
+  cullPasses();
+  realizeTransients();
+}
+
+void RenderGraph::execute( VkCommandBuffer cmd )
+{
+  std::vector<bool> touched( m_resources.size(), false );
+  for ( auto passIndex : m_order )
+  {
+    auto& pass = m_passes[passIndex];
+    for ( const auto& access : pass.accesses )
+    {
+      auto& resource = m_resources[access.resource];
+      auto firstUse = !touched[access.resource];
+      touched[access.resource] = true;
+
+      if ( resource.transient && firstUse )
+      {
+        // whatever was in the slot before, in this frame or the last one, has to be done with the memory
+        auto& slot = m_transients.slots[m_transients.images[resource.transientIndex].slot];
+        auto previous = slot.lastUse ? imageUseInfo( *slot.lastUse ) : ImageUseInfo{};
+        m_barriers->discard( resource.image, previous.stage, previous.write ? previous.access : VK_ACCESS_2_NONE );
+      }
+      else if ( access.discard )
+      {
+        m_barriers->discard( resource.image, firstUse ? resource.acquireStage : VK_PIPELINE_STAGE_2_NONE );
+      }
+      m_barriers->use( resource.image, access.use );
+
+      if ( resource.transient )
+      {
+        m_transients.slots[m_transients.images[resource.transientIndex].slot].lastUse = access.use;
+      }
+    }
+    // everything the pass needs goes out in one batch
+    m_barriers->flush( cmd );
+
+    pass.record( cmd );
+  }
+
+  for ( const auto& resource : m_resources )
+  {
+    if ( resource.finalUse )
+    {
+      m_barriers->use( resource.image, *resource.finalUse );
+    }
+  }
+  m_barriers->flush( cmd );
+}
+
+auto RenderGraph::image( GraphResource resource ) const -> VkImage
+{
+  return m_resources.at( resource ).image;
+}
+
+auto RenderGraph::view( GraphResource resource ) const -> VkImageView
+{
+  return m_resources.at( resource ).view;
+}
+
+auto RenderGraph::stats() const -> RenderGraphStats
+{
+  RenderGraphStats stats{};
+  stats.passCount = static_cast<uint32_t>( m_order.size() );
+  stats.culledCount = static_cast<uint32_t>( m_passes.size() - m_order.size() );
+  stats.transientCount = static_cast<uint32_t>( m_transients.images.size() );
+  stats.transientBytes = m_transients.transientBytes;
+  stats.allocatedBytes = m_transients.allocatedBytes;
+  return stats;
+}
+
+void RenderGraph::sortPasses()
+{
+  // a pass depends on the last writer of everything it touches and a writer also on the readers since then
+  std::vector<std::vector<uint32_t>> dependents( m_passes.size() );
+  std::vector<uint32_t> dependencyCount( m_passes.size(), 0u );
+  std::vector<std::optional<uint32_t>> lastWriter( m_resources.size() );
+  std::vector<std::vector<uint32_t>> readers( m_resources.size() );
+
+  auto addEdge = [&]( uint32_t from, uint32_t to ) {
+    if ( from == to )
+      return;
+    dependents[from].push_back( to );
+    dependencyCount[to]++;
+  };
+
+  for ( uint32_t pass = 0; pass < m_passes.size(); pass++ )
+  {
+    for ( const auto& access : m_passes[pass].accesses )
+    {
+      if ( lastWriter[access.resource] )
+      {
+        addEdge( *lastWriter[access.resource], pass );
+      }
+      if ( imageUseInfo( access.use ).write )
+      {
+        for ( auto reader : readers[access.resource] )
+        {
+          addEdge( reader, pass );
+        }
+        readers[access.resource].clear();
+        lastWriter[access.resource] = pass;
+      }
+      else
+      {
+        readers[access.resource].push_back( pass );
+      }
+    }
+  }
+
+  // independent passes keep the order they were declared in
+  std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<>> ready;
+  for ( uint32_t pass = 0; pass < m_passes.size(); pass++ )
+  {
+    if ( dependencyCount[pass] == 0 )
+      ready.push( pass );
+  }
+
+  m_order.clear();
+  while ( !ready.empty() )
+  {
+    auto pass = ready.top();
+    ready.pop();
+    m_order.push_back( pass );
+    for ( auto dependent : dependents[pass] )
+    {
+      if ( --dependencyCount[dependent] == 0 )
+        ready.push( dependent );
+    }
+  }
+
+  if ( m_order.size() != m_passes.size() )
+  {
+    throw std::runtime_error( "render graph has a cycle" );
+  }
+}
+
+void RenderGraph::cullPasses()
+{
+  // walking backwards, a pass stays when it writes something still needed and then needs what it reads itself
+  std::vector<bool> needed( m_resources.size(), false );
+  for ( uint32_t i = 0; i < m_resources.size(); i++ )
+  {
+    needed[i] = m_resources[i].finalUse.has_value();
+  }
+
+  std::vector<uint32_t> kept;
+  for ( auto it = m_order.rbegin(); it != m_order.rend(); ++it )
+  {
+    const auto& pass = m_passes[*it];
+    bool keep = pass.sideEffects;
+    for ( const auto& access : pass.accesses )
+    {
+      keep = keep || ( imageUseInfo( access.use ).write && needed[access.resource] );
+    }
+    if ( !keep )
+      continue;
+
+    // a full overwrite makes the earlier contents dead, anything else reads them
+    for ( const auto& access : pass.accesses )
+    {
+      if ( access.discard )
+        needed[access.resource] = false;
+    }
+    for ( const auto& access : pass.accesses )
+    {
+      if ( !access.discard )
+        needed[access.resource] = true;
+    }
+    kept.push_back( *it );
+  }
+
+  m_order.assign( kept.rbegin(), kept.rend() );
+}
+
+void RenderGraph::realizeTransients()
+{
+  std::vector<TransientKey> keys;
+  std::vector<bool> used( m_resources.size(), false );
+  for ( uint32_t position = 0; position < m_order.size(); position++ )
+  {
+    for ( const auto& access : m_passes[m_order[position]].accesses )
+    {
+      auto& resource = m_resources[access.resource];
+      if ( !resource.transient )
+        continue;
+
+      if ( !used[access.resource] )
+      {
+        used[access.resource] = true;
+        resource.transientIndex = static_cast<uint32_t>( keys.size() );
+        keys.push_back( { *resource.transient, position, position } );
+      }
+      keys[resource.transientIndex].lastPass = position;
+    }
+  }
+
+  if ( keys != m_transients.keys )
+  {
+    // the frames in flight may still render into the old ones, the tracker is done with them right away
+    forgetTransients( m_transients );
+    m_deletions->push( [this, retired = std::move( m_transients )]() mutable { destroyTransients( retired ); } );
+    m_transients = createTransients( keys );
+  }
+
+  for ( uint32_t i = 0; i < m_resources.size(); i++ )
+  {
+    if ( !used[i] )
+      continue;
+    const auto& transient = m_transients.images[m_resources[i].transientIndex];
+    m_resources[i].image = transient.image;
+    m_resources[i].view = transient.view;
+  }
+}
+
+auto RenderGraph::createTransients( const std::vector<TransientKey>& keys ) -> TransientSet
+{
+  TransientSet set{};
+  set.keys = keys;
+  set.images.resize( keys.size() );
+
+  std::vector<VkMemoryRequirements> requirements( keys.size() );
+  for ( uint32_t i = 0; i < keys.size(); i++ )
+  {
+    const auto& desc = keys[i].desc;
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { desc.extent.width, desc.extent.height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = desc.format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = desc.usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if ( vkCreateImage( m_device, &imageInfo, nullptr, &set.images[i].image ) != VK_SUCCESS )
+    {
+      throw std::runtime_error( "failed to create transient image!" );
+    }
+    vkGetImageMemoryRequirements( m_device, set.images[i].image, &requirements[i] );
+    set.transientBytes += requirements[i].size;
+  }
+
+  // biggest first, each goes to the first slot whose images are all done before it starts or start after it ends
+  std::vector<uint32_t> bySize( keys.size() );
+  for ( uint32_t i = 0; i < keys.size(); i++ )
+    bySize[i] = i;
+  std::sort( bySize.begin(), bySize.end(), [&]( uint32_t a, uint32_t b ) {
+    return requirements[a].size > requirements[b].size;
+  } );
+
+  for ( auto i : bySize )
+  {
+    auto fits = [&]( const AliasSlot& slot ) {
+      if ( ( slot.requirements.memoryTypeBits & requirements[i].memoryTypeBits ) == 0 )
+        return false;
+      return std::all_of( slot.images.begin(), slot.images.end(), [&]( uint32_t other ) {
+        return keys[other].lastPass < keys[i].firstPass || keys[i].lastPass < keys[other].firstPass;
+      } );
+    };
+    auto slot = std::find_if( set.slots.begin(), set.slots.end(), fits );
+    if ( slot == set.slots.end() )
+    {
+      set.slots.push_back( AliasSlot{ requirements[i] } );
+      slot = std::prev( set.slots.end() );
+    }
+
+    slot->requirements.size = std::max( slot->requirements.size, requirements[i].size );
+    slot->requirements.alignment = std::max( slot->requirements.alignment, requirements[i].alignment );
+    slot->requirements.memoryTypeBits &= requirements[i].memoryTypeBits;
+    slot->images.push_back( i );
+    set.images[i].slot = static_cast<uint32_t>( slot - set.slots.begin() );
+  }
+
+  for ( auto& slot : set.slots )
+  {
+    slot.memory = m_allocator->allocateAliased( slot.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+    set.allocatedBytes += slot.requirements.size;
+    for ( auto i : slot.images )
+    {
+      vkBindImageMemory( m_device, set.images[i].image, slot.memory.memory, slot.memory.offset );
+    }
+  }
+
+  for ( uint32_t i = 0; i < keys.size(); i++ )
+  {
+    const auto& desc = keys[i].desc;
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = set.images[i].image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = desc.format;
+    viewInfo.subresourceRange = { desc.aspect, 0, 1, 0, 1 };
+    if ( vkCreateImageView( m_device, &viewInfo, nullptr, &set.images[i].view ) != VK_SUCCESS )
+    {
+      throw std::runtime_error( "failed to create transient image view!" );
+    }
+    m_barriers->track( set.images[i].image, desc.aspect );
+  }
+
+  return set;
+}
+
+void RenderGraph::forgetTransients( const TransientSet& set )
+{
+  for ( const auto& image : set.images )
+  {
+    m_barriers->forget( image.image );
+  }
+}
+
+void RenderGraph::destroyTransients( TransientSet& set )
+{
+  for ( auto& image : set.images )
+  {
+    vkDestroyImageView( m_device, image.view, nullptr );
+    vkDestroyImage( m_device, image.image, nullptr );
+  }
+  for ( auto& slot : set.slots )
+  {
+    m_allocator->free( slot.memory );
+  }
+  set.images.clear();
+  set.slots.clear();
+}
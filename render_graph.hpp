@@ -0,0 +1,155 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "barrier_tracker.hpp"
+#include "deletion_queue.hpp"
+#include "gpu_allocator.hpp"
+
+using GraphResource = uint32_t;
+
+// images the graph owns, they only live between their first and last pass of a frame
+struct GraphImageDesc
+{
+  VkFormat format;
+  VkExtent2D extent;
+  VkImageUsageFlags usage;
+  VkImageAspectFlags aspect;
+
+  bool operator==( const GraphImageDesc& other ) const
+  {
+    return format == other.format && extent.width == other.extent.width && extent.height == other.extent.height &&
+           usage == other.usage && aspect == other.aspect;
+  }
+};
+
+struct GraphAccess
+{
+  GraphResource resource;
+  ImageUse use;
+  // the pass overwrites all of it, a clear for example, whatever was in there before does not have to survive
+  bool discard{ false };
+};
+
+struct GraphPass
+{
+  std::string name;
+  std::vector<GraphAccess> accesses;
+  std::function<void( VkCommandBuffer )> record;
+  // kept even when nothing downstream reads what it writes
+  bool sideEffects{ false };
+};
+
+struct RenderGraphStats
+{
+  uint32_t passCount;
+  uint32_t culledCount;
+  uint32_t transientCount;
+  // memory the transient images would take on their own and what they take sharing it
+  VkDeviceSize transientBytes;
+  VkDeviceSize allocatedBytes;
+};
+
+// the frame as passes that declare which images they read and write, the graph is declared again every frame,
+// compile() orders the passes by their dependencies, drops the ones no output depends on and lets transient images
+// whose lifetimes do not overlap share memory, execute() puts the barriers the tracker derives in front of each pass
+//
+// transient images and their memory are kept as long as the next frames declare the same ones, a set that is replaced
+// goes to the deletion queue
+class RenderGraph
+{
+public:
+  void init( VkDevice device, GpuAllocator& allocator, BarrierTracker& barriers, DeletionQueue& deletions );
+  // frees the transient images, nothing recorded with them may still be in flight
+  void destroy();
+
+  void begin();
+  // the tracker already knows the image, acquireStage as waitStage of BarrierTracker::discard
+  auto importImage( std::string name,
+                    VkImage image,
+                    VkImageView view,
+                    VkPipelineStageFlags2 acquireStage = VK_PIPELINE_STAGE_2_NONE ) -> GraphResource;
+  auto createImage( std::string name, const GraphImageDesc& desc ) -> GraphResource;
+  void addPass( GraphPass pass );
+  // what has to be in the resource once the frame ends and the use it is left in
+  void output( GraphResource resource, ImageUse finalUse );
+
+  void compile();
+  void execute( VkCommandBuffer cmd );
+
+  // valid from compile() on
+  auto image( GraphResource resource ) const -> VkImage;
+  auto view( GraphResource resource ) const -> VkImageView;
+  auto stats() const -> RenderGraphStats;
+
+private:
+  struct Resource
+  {
+    std::string name;
+    VkImage image{ VK_NULL_HANDLE };
+    VkImageView view{ VK_NULL_HANDLE };
+    VkPipelineStageFlags2 acquireStage{ VK_PIPELINE_STAGE_2_NONE };
+    std::optional<GraphImageDesc> transient;
+    std::optional<ImageUse> finalUse;
+    // into the transient images of this frame
+    uint32_t transientIndex{ 0u };
+  };
+
+  // a transient image and the positions in the compiled order it is used between
+  struct TransientKey
+  {
+    GraphImageDesc desc;
+    uint32_t firstPass;
+    uint32_t lastPass;
+
+    bool operator==( const TransientKey& ) const = default;
+  };
+
+  struct TransientImage
+  {
+    VkImage image{ VK_NULL_HANDLE };
+    VkImageView view{ VK_NULL_HANDLE };
+    uint32_t slot{ 0u };
+  };
+
+  // one block of memory and the images taking turns in it
+  struct AliasSlot
+  {
+    VkMemoryRequirements requirements{};
+    GpuAllocation memory;
+    std::vector<uint32_t> images;
+    // the use the previous image in the slot was last put to, the next one waits for it before taking over
+    std::optional<ImageUse> lastUse;
+  };
+
+  struct TransientSet
+  {
+    std::vector<TransientKey> keys;
+    std::vector<TransientImage> images;
+    std::vector<AliasSlot> slots;
+    VkDeviceSize transientBytes{ 0u };
+    VkDeviceSize allocatedBytes{ 0u };
+  };
+
+  void sortPasses();
+  void cullPasses();
+  void realizeTransients();
+  auto createTransients( const std::vector<TransientKey>& keys ) -> TransientSet;
+  void forgetTransients( const TransientSet& set );
+  void destroyTransients( TransientSet& set );
+
+  VkDevice m_device{ VK_NULL_HANDLE };
+  GpuAllocator* m_allocator{ nullptr };
+  BarrierTracker* m_barriers{ nullptr };
+  DeletionQueue* m_deletions{ nullptr };
+
+  std::vector<Resource> m_resources;
+  std::vector<GraphPass> m_passes;
+  // indices into m_passes, sorted and culled
+  std::vector<uint32_t> m_order;
+
+  TransientSet m_transients;
+};
@@ -0,0 +1,179 @@
+#include "residency_manager.hpp"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+namespace
+{
+// drivers report roughly this much of a heap as the budget, the rest goes to the os and other processes
+constexpr double fallbackBudgetFraction = 0.8;
+} // namespace
+
+void ResidencyManager::init( VkPhysicalDevice physicalDevice, GpuAllocator& allocator, bool memoryBudgetExtension )
+{
+  m_physicalDevice = physicalDevice;
+  m_allocator = &allocator;
+  m_memoryBudgetExtension = memoryBudgetExtension;
+
+  const auto& properties = m_allocator->memoryProperties();
+  m_budgets.assign( properties.memoryHeapCount, HeapBudget{} );
+  for ( uint32_t i = 0; i < properties.memoryHeapCount; i++ )
+  {
+    m_budgets[i].deviceLocal = ( properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ) != 0;
+  }
+  pollBudgets();
+}
+
+void ResidencyManager::setWatermarks( double high, double low )
+{
+  m_highWatermark = high;
+  m_lowWatermark = std::min( low, high );
+}
+
+auto ResidencyManager::add( std::string name,
+                            ResidentMemory memory,
+                            std::function<void()> evict,
+                            std::function<ResidentMemory()> reload ) -> ResidencyHandle
+{
+  Resource resource{};
+  resource.name = std::move( name );
+  resource.memory = memory;
+  resource.evict = std::move( evict );
+  resource.reload = std::move( reload );
+  resource.lastUsedFrame = m_frame;
+  m_resources.push_back( std::move( resource ) );
+  return static_cast<ResidencyHandle>( m_resources.size() - 1 );
+}
+
+void ResidencyManager::use( ResidencyHandle handle )
+{
+  auto& resource = m_resources.at( handle );
+  resource.lastUsedFrame = m_frame;
+  if ( resource.resident )
+    return;
+
+  // marked resident only afterwards, so running out of memory while reloading never evicts the resource itself
+  auto memory = resource.reload();
+  resource.memory = memory;
+  resource.resident = true;
+  m_reloads++;
+}
+
+void ResidencyManager::setMemory( ResidencyHandle handle, ResidentMemory memory )
+{
+  m_resources.at( handle ).memory = memory;
+}
+
+void ResidencyManager::update( uint64_t frame, uint32_t framesInFlight )
+{
+  m_frame = frame;
+  m_framesInFlight = framesInFlight;
+  pollBudgets();
+
+  for ( uint32_t heap = 0; heap < m_budgets.size(); heap++ )
+  {
+    auto& budget = m_budgets[heap];
+    if ( budget.usage <= static_cast<VkDeviceSize>( budget.budget * m_highWatermark ) )
+      continue;
+
+    // the reported usage only moves on the next poll, so count down what the evictions give back
+    auto target = static_cast<VkDeviceSize>( budget.budget * m_lowWatermark );
+    auto usage = budget.usage;
+    while ( usage > target )
+    {
+      auto candidate = evictionCandidate( heap );
+      if ( !candidate )
+        break;
+
+      usage -= std::min( usage, candidate->memory.bytes );
+      evict( *candidate );
+    }
+  }
+}
+
+bool ResidencyManager::makeRoom( uint32_t heapIndex, VkDeviceSize size )
+{
+  auto candidate = evictionCandidate( heapIndex );
+  if ( !candidate )
+    return false;
+
+  spdlog::warn( "heap {} is full, evicting {} to fit {} bytes", heapIndex, candidate->name, size );
+  evict( *candidate );
+  return true;
+}
+
+auto ResidencyManager::budgets() const -> const std::vector<HeapBudget>&
+{
+  return m_budgets;
+}
+
+auto ResidencyManager::stats() const -> ResidencyStats
+{
+  ResidencyStats stats{};
+  for ( const auto& resource : m_resources )
+  {
+    if ( resource.resident )
+      stats.residentCount++;
+    else
+      stats.evictedCount++;
+  }
+  stats.evictions = m_evictions;
+  stats.reloads = m_reloads;
+  stats.driverBudget = m_memoryBudgetExtension;
+  return stats;
+}
+
+void ResidencyManager::pollBudgets()
+{
+  const auto& properties = m_allocator->memoryProperties();
+  if ( m_memoryBudgetExtension )
+  {
+    // usage here includes other processes and the driver's own allocations, which our accounting can't see
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties2.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2( m_physicalDevice, &properties2 );
+
+    for ( uint32_t i = 0; i < m_budgets.size(); i++ )
+    {
+      m_budgets[i].usage = budgetProperties.heapUsage[i];
+      m_budgets[i].budget = budgetProperties.heapBudget[i];
+    }
+    return;
+  }
+
+  for ( uint32_t i = 0; i < m_budgets.size(); i++ )
+  {
+    m_budgets[i].usage = m_allocator->heapUsage( i );
+    m_budgets[i].budget = static_cast<VkDeviceSize>( properties.memoryHeaps[i].size * fallbackBudgetFraction );
+  }
+}
+
+bool ResidencyManager::idle( const Resource& resource ) const
+{
+  // the slot of the frame being built has already waited, everything older than the ring depth has retired
+  return resource.lastUsedFrame + m_framesInFlight <= m_frame;
+}
+
+auto ResidencyManager::evictionCandidate( uint32_t heapIndex ) -> Resource*
+{
+  Resource* oldest{ nullptr };
+  for ( auto& resource : m_resources )
+  {
+    if ( !resource.resident || resource.memory.heapIndex != heapIndex || !idle( resource ) )
+      continue;
+
+    if ( !oldest || resource.lastUsedFrame < oldest->lastUsedFrame )
+      oldest = &resource;
+  }
+  return oldest;
+}
+
+void ResidencyManager::evict( Resource& resource )
+{
+  resource.evict();
+  resource.resident = false;
+  m_evictions++;
+}
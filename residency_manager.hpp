@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "gpu_allocator.hpp"
+
+using ResidencyHandle = uint32_t;
+
+struct ResidentMemory
+{
+  VkDeviceSize bytes;
+  uint32_t heapIndex;
+};
+
+struct HeapBudget
+{
+  VkDeviceSize usage;
+  VkDeviceSize budget;
+  bool deviceLocal;
+};
+
+struct ResidencyStats
+{
+  uint32_t residentCount;
+  uint32_t evictedCount;
+  uint64_t evictions;
+  uint64_t reloads;
+  // true when the budget comes from VK_EXT_memory_budget, false for the allocator's own accounting
+  bool driverBudget;
+};
+
+// keeps textures and meshes under the heap budgets, whatever was not used for a while goes first once a heap crosses
+// the high watermark and comes back the next time a frame asks for it, the owner of a resource supplies how to
+// destroy and how to recreate it, the manager only decides when
+class ResidencyManager
+{
+public:
+  void init( VkPhysicalDevice physicalDevice, GpuAllocator& allocator, bool memoryBudgetExtension );
+
+  // fractions of the heap budget, eviction starts above high and stops once below low
+  void setWatermarks( double high, double low );
+
+  // evict destroys the resource and frees its memory right away, it is only called once no frame in flight uses the
+  // resource and the out of memory path retries the allocation as soon as it returns, reload recreates it and reports
+  // where it ended up
+  auto add( std::string name,
+            ResidentMemory memory,
+            std::function<void()> evict,
+            std::function<ResidentMemory()> reload ) -> ResidencyHandle;
+  // the resource is resident and used by the frame being built, evicted resources are reloaded right away
+  void use( ResidencyHandle handle );
+  // for resources that are recreated asynchronously, what reload() reported was only an estimate
+  void setMemory( ResidencyHandle handle, ResidentMemory memory );
+
+  // call once per frame before recording, frames older than framesInFlight have retired so their resources are idle
+  void update( uint64_t frame, uint32_t framesInFlight );
+  // out of memory path, evicts the least recently used idle resource of the heap
+  bool makeRoom( uint32_t heapIndex, VkDeviceSize size );
+
+  auto budgets() const -> const std::vector<HeapBudget>&;
+  auto stats() const -> ResidencyStats;
+
+private:
+  struct Resource
+  {
+    std::string name;
+    ResidentMemory memory;
+    std::function<void()> evict;
+    std::function<ResidentMemory()> reload;
+    uint64_t lastUsedFrame{ 0u };
+    bool resident{ true };
+  };
+
+  void pollBudgets();
+  bool idle( const Resource& resource ) const;
+  // least recently used idle resident resource of the heap, nullptr when there is none
+  auto evictionCandidate( uint32_t heapIndex ) -> Resource*;
+  void evict( Resource& resource );
+
+  VkPhysicalDevice m_physicalDevice{ VK_NULL_HANDLE };
+  GpuAllocator* m_allocator{ nullptr };
+  bool m_memoryBudgetExtension{ false };
+
+  double m_highWatermark{ 0.9 };
+  double m_lowWatermark{ 0.8 };
+
+  std::vector<Resource> m_resources;
+  std::vector<HeapBudget> m_budgets;
+  uint64_t m_frame{ 0u };
+  uint32_t m_framesInFlight{ 1u };
+  uint64_t m_evictions{ 0u };
+  uint64_t m_reloads{ 0u };
+};
@@ -11,10 +11,14 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
+    vec4 dequantizeScale;
+    vec4 dequantizeOffset;
+    uint textureIndex;
+    float meshExtent;
 } ubo;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition*3.0, 1.0);
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition * ubo.meshExtent, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
@@ -0,0 +1,25 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// UniformBufferoObject, the index is the same for the whole draw so it needs no nonuniformEXT
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec4 dequantizeScale;
+    vec4 dequantizeOffset;
+    uint textureIndex;
+} ubo;
+
+// BindlessTable, set 1
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 2) uniform sampler textureSampler;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(sampler2D(textures[ubo.textureIndex], textureSampler), fragTexCoord);
+}
@@ -0,0 +1,28 @@
+#version 450
+
+// CompactVertex, the vertex fetch already expanded the snorm, unorm and half attributes to floats
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) in vec2 inTexCoord;
+// octahedral normal, kept in the format for lighting but not read until a fragment shader needs it
+layout(location = 3) in vec2 inNormal;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec4 dequantizeScale;
+    vec4 dequantizeOffset;
+    uint textureIndex;
+    float meshExtent;
+} ubo;
+
+void main() {
+    vec3 position = ubo.dequantizeOffset.xyz + inPosition.xyz * ubo.dequantizeScale.xyz;
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position * ubo.meshExtent, 1.0);
+    fragColor = inColor.rgb;
+    fragTexCoord = inTexCoord;
+}
@@ -0,0 +1,97 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include <chrono>
+#include <iostream>
+#include <string_view>
+#include "stb_image.h"
+#include "bc_encoder.hpp"
+#include "ktx2.hpp"
+#include "mip_chain.hpp"
+#include "worker_pool.hpp"
+
+// block compresses an image with its whole mip chain into a ktx2 file the renderer uploads as is
+// texture_compressor in.jpg out.ktx2 [--format bc1|bc3|bc5|bc7] [--linear] [--threads N]
+//
+// colors are treated as srgb unless --linear is given, BC5 is always linear since it holds normal map xy
+
+static auto parseFormat( std::string_view name ) -> BlockFormat
+{
+  if ( name == "bc1" )
+    return BlockFormat::BC1;
+  if ( name == "bc3" )
+    return BlockFormat::BC3;
+  if ( name == "bc5" )
+    return BlockFormat::BC5;
+  if ( name == "bc7" )
+    return BlockFormat::BC7;
+  throw std::invalid_argument( "unknown block format " + std::string{ name } + "!" );
+}
+
+int main( int argc, char** argv )
+{
+  try
+  {
+    if ( argc < 3 )
+    {
+      std::cout << "usage: texture_compressor in.jpg out.ktx2 [--format bc1|bc3|bc5|bc7] [--linear] [--threads N]\n";
+      return 1;
+    }
+
+    std::string inPath{ argv[1] };
+    std::string outPath{ argv[2] };
+    auto format = BlockFormat::BC7;
+    bool srgb = true;
+    size_t threads = 0;
+    for ( int i = 3; i < argc; i++ )
+    {
+      std::string_view arg{ argv[i] };
+      if ( arg == "--linear" )
+        srgb = false;
+      else if ( arg == "--format" && i + 1 < argc )
+        format = parseFormat( argv[++i] );
+      else if ( arg == "--threads" && i + 1 < argc )
+        threads = std::stoul( argv[++i] );
+      else
+        std::cout << "ignoring argument " << arg << "\n";
+    }
+    srgb = srgb && format != BlockFormat::BC5;
+
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels = stbi_load( inPath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha );
+    if ( !pixels )
+    {
+      throw std::runtime_error( "could not load " + inPath + ": " + stbi_failure_reason() );
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Ktx2Texture texture;
+    texture.format = blockVkFormat( format, srgb );
+    texture.width = static_cast<uint32_t>( texWidth );
+    texture.height = static_cast<uint32_t>( texHeight );
+
+    auto mipLevels = mipLevelCount( texture.width, texture.height );
+    auto chain = buildMipChain( pixels, texture.width, texture.height, mipLevels, srgb );
+    stbi_image_free( pixels );
+
+    // the levels one after the other, the blocks of each level spread over the pool
+    WorkerPool pool{ threads };
+    size_t offset = 0;
+    for ( uint32_t level = 0; level < mipLevels; level++ )
+    {
+      auto levelWidth = std::max( 1u, texture.width >> level );
+      auto levelHeight = std::max( 1u, texture.height >> level );
+      texture.levels.push_back( encodeImage( format, chain.data() + offset, levelWidth, levelHeight, &pool ) );
+      offset += static_cast<size_t>( levelWidth ) * levelHeight * 4;
+    }
+    writeKtx2( outPath, texture );
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << outPath << ": " << texture.width << "x" << texture.height << ", " << mipLevels << " levels in "
+              << elapsed.count() << " ms on " << pool.size() << " threads\n";
+  }
+  catch ( std::exception& e )
+  {
+    std::cout << "something went wrong: exception-> " << e.what();
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,486 @@
+#include "texture_loader.hpp"
+#include <chrono>
+#include <filesystem>
+#include <spdlog/spdlog.h>
+#include "cpu_profiler.hpp"
+#include "mip_chain.hpp"
+#include "stb_image.h"
+
+void TextureLoader::init( VkDevice device,
+                          VkPhysicalDevice physicalDevice,
+                          GpuAllocator& allocator,
+                          UploadManager& uploads,
+                          DeletionQueue& deletions,
+                          size_t decodeThreads,
+                          VkDeviceSize uploadBytesPerFrame )
+{
+  m_device = device;
+  m_physicalDevice = physicalDevice;
+  m_allocator = &allocator;
+  m_uploads = &uploads;
+  m_deletions = &deletions;
+  m_uploadBytesPerFrame = uploadBytesPerFrame;
+  m_decoders = std::make_unique<WorkerPool>( decodeThreads );
+
+  std::array<VkFormat, 2> formats = { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB };
+  for ( size_t srgb = 0; srgb < formats.size(); srgb++ )
+  {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties( m_physicalDevice, formats[srgb], &properties );
+    m_blitMips[srgb] = ( properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT ) != 0;
+  }
+
+  createPlaceholder();
+}
+
+void TextureLoader::destroy()
+{
+  // the decode threads write into m_decoded, they have to be gone first
+  WorkerPool::waitAll( m_decodes );
+  m_decoders.reset();
+  m_decodes.clear();
+  m_decoded.clear();
+
+  for ( auto& texture : m_textures )
+  {
+    vkDestroyImageView( m_device, texture.view, nullptr );
+    vkDestroyImage( m_device, texture.image, nullptr );
+    m_allocator->free( texture.memory );
+  }
+  m_textures.clear();
+
+  vkDestroyImageView( m_device, m_placeholderView, nullptr );
+  vkDestroyImage( m_device, m_placeholderImage, nullptr );
+  m_allocator->free( m_placeholderMemory );
+  m_placeholderView = VK_NULL_HANDLE;
+  m_placeholderImage = VK_NULL_HANDLE;
+}
+
+auto TextureLoader::load( std::string path, bool srgb, bool streamed ) -> TextureHandle
+{
+  Texture texture;
+  texture.path = std::move( path );
+  texture.srgb = srgb;
+  texture.streamed = streamed;
+  m_textures.push_back( std::move( texture ) );
+
+  auto handle = static_cast<TextureHandle>( m_textures.size() - 1 );
+  submitDecode( handle );
+  return handle;
+}
+
+void TextureLoader::evict( TextureHandle texture )
+{
+  auto& entry = m_textures.at( texture );
+  entry.request++;
+  if ( entry.state == TextureState::Resident )
+  {
+    freeImage( entry );
+    m_generation++;
+  }
+  entry.state = TextureState::Evicted;
+}
+
+void TextureLoader::reload( TextureHandle texture )
+{
+  auto& entry = m_textures.at( texture );
+  if ( entry.state == TextureState::Resident || entry.state == TextureState::Loading )
+    return;
+
+  // a streamed texture still has its levels in system memory, only the tail has to go up again
+  if ( entry.streamed && !entry.source.levels.empty() )
+  {
+    entry.request++;
+    auto tail = mipTailLevel( entry.width, entry.height, entry.mipLevels, streamingTailExtent );
+    upload( entry, entry.source, tail, entry.mipLevels, canBlitMips( entry.source.format ) );
+    return;
+  }
+
+  entry.state = TextureState::Loading;
+  submitDecode( texture );
+}
+
+void TextureLoader::update()
+{
+  PROFILE_FUNCTION();
+  std::erase_if( m_decodes, []( const std::future<void>& decode ) {
+    return decode.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready;
+  } );
+
+  std::vector<Decoded> decoded;
+  {
+    std::lock_guard lock{ m_mutex };
+    decoded.swap( m_decoded );
+  }
+
+  // at least one per frame however large it is, the staging ring chunks it
+  VkDeviceSize staged = 0;
+  size_t next = 0;
+  for ( ; next < decoded.size() && staged < m_uploadBytesPerFrame; next++ )
+  {
+    auto& result = decoded[next];
+    auto& texture = m_textures[result.texture];
+    m_decodeMs.push( result.decodeMs );
+    if ( result.request != texture.request )
+      continue;
+
+    if ( !result.error.empty() )
+    {
+      spdlog::error( "failed to load {}: {}", texture.path, result.error );
+      texture.state = TextureState::Failed;
+      continue;
+    }
+
+    if ( texture.streamed )
+    {
+      texture.source = std::move( result.image );
+      const auto& source = texture.source;
+      auto tail = mipTailLevel( source.width, source.height, result.mipLevels, streamingTailExtent );
+      staged += upload( texture, source, tail, result.mipLevels, canBlitMips( source.format ) );
+      continue;
+    }
+    staged += upload( texture, result.image, 0, result.mipLevels, result.blitMips );
+  }
+
+  // the rest goes first next frame, ahead of whatever finished in between
+  if ( next < decoded.size() )
+  {
+    std::lock_guard lock{ m_mutex };
+    m_decoded.insert( m_decoded.begin(),
+                      std::make_move_iterator( decoded.begin() + static_cast<ptrdiff_t>( next ) ),
+                      std::make_move_iterator( decoded.end() ) );
+  }
+
+  stream( staged );
+  m_frame++;
+}
+
+void TextureLoader::requestLevel( TextureHandle texture, uint32_t level )
+{
+  auto& entry = m_textures.at( texture );
+  entry.requestedLevel = std::min( entry.requestedLevel, level );
+}
+
+void TextureLoader::setStreamingBudget( VkDeviceSize bytes )
+{
+  m_streamingBudget = bytes;
+}
+
+auto TextureLoader::view( TextureHandle texture ) const -> VkImageView
+{
+  const auto& entry = m_textures.at( texture );
+  return entry.state == TextureState::Resident ? entry.view : m_placeholderView;
+}
+
+auto TextureLoader::info( TextureHandle texture ) const -> TextureInfo
+{
+  const auto& entry = m_textures.at( texture );
+  return { entry.state, entry.format, entry.width, entry.height, entry.mipLevels, entry.baseLevel };
+}
+
+auto TextureLoader::memory( TextureHandle texture ) const -> const GpuAllocation&
+{
+  return m_textures.at( texture ).memory;
+}
+
+auto TextureLoader::stats() const -> TextureStats
+{
+  TextureStats stats{};
+  stats.textureCount = static_cast<uint32_t>( m_textures.size() );
+  for ( const auto& texture : m_textures )
+  {
+    if ( texture.state == TextureState::Resident )
+      stats.residentCount++;
+    else if ( texture.state == TextureState::Loading )
+      stats.loadingCount++;
+    else if ( texture.state == TextureState::Failed )
+      stats.failedCount++;
+
+    if ( texture.streamed )
+      stats.streamedBytes += texture.memory.size;
+  }
+  stats.decodeMs = m_decodeMs.average();
+  stats.streamingBudget = m_streamingBudget;
+  stats.mipUploads = m_mipUploads;
+  stats.mipDrops = m_mipDrops;
+  return stats;
+}
+
+auto TextureLoader::generation() const -> uint64_t
+{
+  return m_generation;
+}
+
+auto TextureLoader::decode( const std::string& path, bool srgb, bool blitMips ) -> Decoded
+{
+  PROFILE_FUNCTION();
+  auto start = std::chrono::steady_clock::now();
+  Decoded decoded{};
+  try
+  {
+    if ( std::filesystem::path( path ).extension() == ".ktx2" )
+    {
+      decoded.image = readKtx2( path );
+      decoded.mipLevels = static_cast<uint32_t>( decoded.image.levels.size() );
+    }
+    else
+    {
+      int texWidth, texHeight, texChannels;
+      std::unique_ptr<stbi_uc, void ( * )( void* )> pixels{
+        stbi_load( path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha ), stbi_image_free };
+      if ( !pixels )
+      {
+        throw std::runtime_error( stbi_failure_reason() );
+      }
+
+      auto& image = decoded.image;
+      image.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+      image.width = static_cast<uint32_t>( texWidth );
+      image.height = static_cast<uint32_t>( texHeight );
+      decoded.mipLevels = mipLevelCount( image.width, image.height );
+      decoded.blitMips = blitMips;
+
+      if ( blitMips )
+      {
+        image.levels.emplace_back( pixels.get(), pixels.get() + static_cast<size_t>( image.width ) * image.height * 4 );
+      }
+      else
+      {
+        auto chain = buildMipChain( pixels.get(), image.width, image.height, decoded.mipLevels, srgb );
+        size_t offset = 0;
+        for ( uint32_t level = 0; level < decoded.mipLevels; level++ )
+        {
+          auto bytes =
+            static_cast<size_t>( std::max( 1u, image.width >> level ) ) * std::max( 1u, image.height >> level ) * 4;
+          image.levels.emplace_back( chain.begin() + static_cast<ptrdiff_t>( offset ),
+                                     chain.begin() + static_cast<ptrdiff_t>( offset + bytes ) );
+          offset += bytes;
+        }
+      }
+    }
+  }
+  catch ( const std::exception& e )
+  {
+    decoded.error = e.what();
+  }
+
+  decoded.decodeMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+  return decoded;
+}
+
+void TextureLoader::submitDecode( TextureHandle texture )
+{
+  auto& entry = m_textures[texture];
+  auto request = ++entry.request;
+  // streamed textures upload their levels from system memory, so all of them have to be built there
+  auto blitMips = m_blitMips[entry.srgb ? 1 : 0] && !entry.streamed;
+  m_decodes.push_back(
+    m_decoders->submit( [this, texture, request, path = entry.path, srgb = entry.srgb, blitMips]() {
+      auto decoded = decode( path, srgb, blitMips );
+      decoded.texture = texture;
+      decoded.request = request;
+
+      std::lock_guard lock{ m_mutex };
+      m_decoded.push_back( std::move( decoded ) );
+    } ) );
+}
+
+auto TextureLoader::upload(
+  Texture& texture, const Ktx2Texture& image, uint32_t baseLevel, uint32_t mipLevels, bool blitMips ) -> VkDeviceSize
+{
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties( m_physicalDevice, image.format, &properties );
+  if ( !( properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT ) )
+  {
+    spdlog::error( "failed to load {}: the device cannot sample its format", texture.path );
+    texture.state = TextureState::Failed;
+    return 0;
+  }
+
+  // frames in flight keep sampling the old image until it retires
+  if ( texture.image != VK_NULL_HANDLE )
+  {
+    destroyImage( texture );
+  }
+
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  if ( blitMips )
+  {
+    usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  }
+  auto levelCount = mipLevels - baseLevel;
+  auto width = std::max( 1u, image.width >> baseLevel );
+  auto height = std::max( 1u, image.height >> baseLevel );
+  texture.image = createImage( image.format, width, height, levelCount, usage, texture.memory );
+
+  VkDeviceSize staged = 0;
+  if ( blitMips )
+  {
+    staged = image.levels[baseLevel].size();
+    m_uploads->uploadImage( texture.image, image.levels[baseLevel].data(), staged, width, height, levelCount );
+  }
+  else
+  {
+    std::vector<ImageLevel> levels;
+    for ( uint32_t level = 0; level < levelCount; level++ )
+    {
+      const auto& source = image.levels[baseLevel + level];
+      levels.push_back( { source.data(), std::max( 1u, width >> level ), std::max( 1u, height >> level ) } );
+      staged += source.size();
+    }
+    auto block = texelBlock( image.format );
+    m_uploads->uploadImageLevels( texture.image, levels, block.bytes, block.extent );
+  }
+
+  texture.view = createImageView( texture.image, image.format, levelCount );
+  texture.format = image.format;
+  texture.width = image.width;
+  texture.height = image.height;
+  texture.mipLevels = mipLevels;
+  texture.baseLevel = baseLevel;
+  texture.state = TextureState::Resident;
+  m_generation++;
+  return staged;
+}
+
+void TextureLoader::stream( VkDeviceSize& staged )
+{
+  std::vector<StreamedMips> mips;
+  std::vector<TextureHandle> handles;
+  for ( TextureHandle handle = 0; handle < m_textures.size(); handle++ )
+  {
+    auto& texture = m_textures[handle];
+    if ( !texture.streamed || texture.state != TextureState::Resident )
+      continue;
+
+    StreamedMips entry{};
+    for ( const auto& level : texture.source.levels )
+      entry.levelBytes.push_back( level.size() );
+    entry.tailLevel = mipTailLevel( texture.width, texture.height, texture.mipLevels, streamingTailExtent );
+    entry.residentLevel = texture.baseLevel;
+    entry.wantedLevel = std::min( texture.requestedLevel, entry.tailLevel );
+    if ( texture.requestedLevel != UINT32_MAX )
+      texture.lastRequested = m_frame;
+    entry.lastRequested = texture.lastRequested;
+    texture.requestedLevel = UINT32_MAX;
+
+    mips.push_back( std::move( entry ) );
+    handles.push_back( handle );
+  }
+  if ( mips.empty() )
+    return;
+
+  auto targets = planMipResidency( mips, m_streamingBudget );
+
+  // drops first, they only shrink, then finer levels as long as this frame's upload allowance lasts
+  for ( size_t i = 0; i < handles.size(); i++ )
+  {
+    auto& texture = m_textures[handles[i]];
+    if ( targets[i] > texture.baseLevel )
+    {
+      staged += upload( texture, texture.source, targets[i], texture.mipLevels, canBlitMips( texture.source.format ) );
+      m_mipDrops++;
+    }
+  }
+  for ( size_t i = 0; i < handles.size() && staged < m_uploadBytesPerFrame; i++ )
+  {
+    auto& texture = m_textures[handles[i]];
+    if ( targets[i] < texture.baseLevel )
+    {
+      staged += upload( texture, texture.source, targets[i], texture.mipLevels, canBlitMips( texture.source.format ) );
+      m_mipUploads++;
+    }
+  }
+}
+
+bool TextureLoader::canBlitMips( VkFormat format ) const
+{
+  if ( format == VK_FORMAT_R8G8B8A8_SRGB )
+    return m_blitMips[1];
+  if ( format == VK_FORMAT_R8G8B8A8_UNORM )
+    return m_blitMips[0];
+  return false;
+}
+
+void TextureLoader::destroyImage( Texture& texture )
+{
+  m_deletions->push( [this, image = texture.image, view = texture.view, memory = texture.memory]() mutable {
+    vkDestroyImageView( m_device, view, nullptr );
+    vkDestroyImage( m_device, image, nullptr );
+    m_allocator->free( memory );
+  } );
+  texture.image = VK_NULL_HANDLE;
+  texture.view = VK_NULL_HANDLE;
+  texture.memory = {};
+}
+
+void TextureLoader::freeImage( Texture& texture )
+{
+  vkDestroyImageView( m_device, texture.view, nullptr );
+  vkDestroyImage( m_device, texture.image, nullptr );
+  m_allocator->free( texture.memory );
+  texture.image = VK_NULL_HANDLE;
+  texture.view = VK_NULL_HANDLE;
+  texture.memory = {};
+}
+
+auto TextureLoader::createImage( VkFormat format,
+                                 uint32_t width,
+                                 uint32_t height,
+                                 uint32_t mipLevels,
+                                 VkImageUsageFlags usage,
+                                 GpuAllocation& memory ) -> VkImage
+{
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent = { width, height, 1 };
+  imageInfo.mipLevels = mipLevels;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = usage;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkImage image;
+  if ( vkCreateImage( m_device, &imageInfo, nullptr, &image ) != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to create texture image!" );
+  }
+
+  memory = m_allocator->allocateImage( image, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+  return image;
+}
+
+auto TextureLoader::createImageView( VkImage image, VkFormat format, uint32_t mipLevels ) -> VkImageView
+{
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = format;
+  viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+
+  VkImageView view;
+  if ( vkCreateImageView( m_device, &viewInfo, nullptr, &view ) != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to create texture image view!" );
+  }
+  return view;
+}
+
+void TextureLoader::createPlaceholder()
+{
+  // opaque white, the meshes draw flat white until the real texels arrive
+  const uint32_t white = 0xFFFFFFFF;
+  m_placeholderImage = createImage( VK_FORMAT_R8G8B8A8_UNORM,
+                                    1,
+                                    1,
+                                    1,
+                                    VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                    m_placeholderMemory );
+  m_uploads->uploadImage( m_placeholderImage, &white, sizeof( white ), 1, 1 );
+  m_placeholderView = createImageView( m_placeholderImage, VK_FORMAT_R8G8B8A8_UNORM, 1 );
+}
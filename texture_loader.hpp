@@ -0,0 +1,199 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "deletion_queue.hpp"
+#include "frame_stats.hpp"
+#include "gpu_allocator.hpp"
+#include "ktx2.hpp"
+#include "mip_streaming.hpp"
+#include "upload_manager.hpp"
+#include "worker_pool.hpp"
+
+using TextureHandle = uint32_t;
+
+enum class TextureState
+{
+  // decoding or waiting for its upload to be recorded, the placeholder stands in
+  Loading,
+  Resident,
+  // the image was destroyed, reload() brings it back
+  Evicted,
+  // the file could not be decoded, stays on the placeholder
+  Failed,
+};
+
+struct TextureInfo
+{
+  TextureState state;
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipLevels;
+  // finest level resident, the view starts there, always 0 unless the texture is streamed
+  uint32_t baseLevel;
+};
+
+struct TextureStats
+{
+  uint32_t textureCount;
+  uint32_t residentCount;
+  uint32_t loadingCount;
+  uint32_t failedCount;
+  // per file, on a decode thread
+  double decodeMs;
+  uint64_t streamedBytes;
+  uint64_t streamingBudget;
+  // streamed textures that got finer levels or gave some up
+  uint64_t mipUploads;
+  uint64_t mipDrops;
+};
+
+// decodes image files on its own worker threads and hands them to the upload manager from the frame loop, load()
+// returns a handle right away and view() gives out a 1x1 placeholder until the image is resident
+//
+// the decode threads are separate from the pool that records the scene, a burst of loads never delays the frame's
+// own parallel work behind it, and at most uploadBytesPerFrame of decoded texels are staged per frame
+//
+// jpg and png get their mips blitted on the gpu when the format filters linearly and box filtered on the decode
+// thread otherwise, ktx2 files bring all of their levels
+//
+// streamed textures keep every level in system memory and start out with only the levels up to streamingTailExtent
+// resident, finer ones come in as requestLevel() asks for them and are dropped again when the streamed textures
+// together outgrow the budget, see planMipResidency(), every change of levels is a new image with the levels it keeps
+// uploaded again, the old one retires through the deletion queue, when the format blits only the finest resident
+// level is staged and the coarser ones are blitted from it on the gpu like a non streamed jpg
+class TextureLoader
+{
+public:
+  // decodeThreads 0 picks one per core, leaving one for the main thread
+  void init( VkDevice device,
+             VkPhysicalDevice physicalDevice,
+             GpuAllocator& allocator,
+             UploadManager& uploads,
+             DeletionQueue& deletions,
+             size_t decodeThreads = 0,
+             VkDeviceSize uploadBytesPerFrame = defaultUploadBytesPerFrame );
+  // waits for the decodes still running, nothing recorded with the views may still be in flight
+  void destroy();
+
+  auto load( std::string path, bool srgb = true, bool streamed = false ) -> TextureHandle;
+  // only for textures no frame in flight samples, the image is freed right away so an allocation retried after the
+  // eviction can use the memory, a decode still running for it is dropped when it lands
+  void evict( TextureHandle texture );
+  void reload( TextureHandle texture );
+
+  // call once per frame from the thread that submits, before the uploads are flushed, turns finished decodes into
+  // images and records their uploads, frames submitted after the flush may sample them
+  void update();
+  // finest level some draw of this frame wants to sample, only streamed textures care
+  void requestLevel( TextureHandle texture, uint32_t level );
+  void setStreamingBudget( VkDeviceSize bytes );
+
+  // the placeholder until the texture is resident
+  auto view( TextureHandle texture ) const -> VkImageView;
+  auto info( TextureHandle texture ) const -> TextureInfo;
+  // empty unless the texture is resident
+  auto memory( TextureHandle texture ) const -> const GpuAllocation&;
+  auto stats() const -> TextureStats;
+  // bumped whenever what view() returns changes, descriptors written before that are stale
+  auto generation() const -> uint64_t;
+
+  static constexpr VkDeviceSize defaultUploadBytesPerFrame = 64ull * 1024 * 1024;
+  static constexpr VkDeviceSize defaultStreamingBudget = 256ull * 1024 * 1024;
+  // 64x64 rgba8 and everything below is 21 KB, cheap enough to keep for every texture
+  static constexpr uint32_t streamingTailExtent = 64;
+
+private:
+  struct Texture
+  {
+    std::string path;
+    bool srgb{ true };
+    TextureState state{ TextureState::Loading };
+    // bumped by every load, reload and evict, a decode that finishes for an older one is thrown away
+    uint32_t request{ 0u };
+    VkImage image{ VK_NULL_HANDLE };
+    GpuAllocation memory;
+    VkImageView view{ VK_NULL_HANDLE };
+    VkFormat format{ VK_FORMAT_UNDEFINED };
+    uint32_t width{ 0u };
+    uint32_t height{ 0u };
+    uint32_t mipLevels{ 0u };
+    uint32_t baseLevel{ 0u };
+
+    bool streamed{ false };
+    // every level, the upload source of streamed textures
+    Ktx2Texture source;
+    // finest level asked for since the last update, UINT32_MAX for none
+    uint32_t requestedLevel{ UINT32_MAX };
+    uint64_t lastRequested{ 0u };
+  };
+
+  struct Decoded
+  {
+    TextureHandle texture;
+    uint32_t request;
+    // only level 0 when blitMips is set, the gpu fills in the rest
+    Ktx2Texture image;
+    uint32_t mipLevels;
+    bool blitMips;
+    double decodeMs;
+    std::string error;
+  };
+
+  // runs on a decode thread, failures end up in error
+  static auto decode( const std::string& path, bool srgb, bool blitMips ) -> Decoded;
+  void submitDecode( TextureHandle texture );
+  // creates the image and view for the levels from baseLevel on and records their upload, with blitMips only baseLevel
+  // is staged and the gpu fills in the rest, any image the texture had goes to the deletion queue, returns the staged
+  // bytes
+  auto upload( Texture& texture, const Ktx2Texture& image, uint32_t baseLevel, uint32_t mipLevels, bool blitMips )
+    -> VkDeviceSize;
+  // applies planMipResidency() to the resident streamed textures
+  void stream( VkDeviceSize& staged );
+  // rgba8 in a format that filters linearly, the levels below the finest can be blitted
+  bool canBlitMips( VkFormat format ) const;
+  void destroyImage( Texture& texture );
+  // for images nothing in flight reads anymore
+  void freeImage( Texture& texture );
+  auto createImage( VkFormat format,
+                    uint32_t width,
+                    uint32_t height,
+                    uint32_t mipLevels,
+                    VkImageUsageFlags usage,
+                    GpuAllocation& memory ) -> VkImage;
+  auto createImageView( VkImage image, VkFormat format, uint32_t mipLevels ) -> VkImageView;
+  void createPlaceholder();
+
+  VkDevice m_device{ VK_NULL_HANDLE };
+  VkPhysicalDevice m_physicalDevice{ VK_NULL_HANDLE };
+  GpuAllocator* m_allocator{ nullptr };
+  UploadManager* m_uploads{ nullptr };
+  DeletionQueue* m_deletions{ nullptr };
+  VkDeviceSize m_uploadBytesPerFrame{ 0u };
+  // whether the rgba8 formats can be blitted with a linear filter, indexed by srgb
+  std::array<bool, 2> m_blitMips{};
+
+  std::unique_ptr<WorkerPool> m_decoders;
+  std::vector<std::future<void>> m_decodes;
+  // filled by the decode threads, drained by update()
+  std::vector<Decoded> m_decoded;
+  std::mutex m_mutex;
+
+  std::vector<Texture> m_textures;
+  VkImage m_placeholderImage{ VK_NULL_HANDLE };
+  GpuAllocation m_placeholderMemory;
+  VkImageView m_placeholderView{ VK_NULL_HANDLE };
+  uint64_t m_generation{ 1u };
+  RollingStats<64> m_decodeMs;
+
+  VkDeviceSize m_streamingBudget{ defaultStreamingBudget };
+  uint64_t m_frame{ 0u };
+  uint64_t m_mipUploads{ 0u };
+  uint64_t m_mipDrops{ 0u };
+};
@@ -0,0 +1,157 @@
+#include "timeline_scheduler.hpp"
+#include <stdexcept>
+#include <vector>
+
+void TimelineScheduler::init( VkDevice device )
+{
+  m_device = device;
+
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+
+  if ( vkCreateSemaphore( m_device, &semaphoreInfo, nullptr, &m_semaphore ) != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to create timeline semaphore!" );
+  }
+
+  m_lastSubmitted = 0;
+  m_lastCompleted = 0;
+}
+
+void TimelineScheduler::destroy()
+{
+  vkDestroySemaphore( m_device, m_semaphore, nullptr );
+  m_semaphore = VK_NULL_HANDLE;
+}
+
+auto TimelineScheduler::submit( VkQueue queue,
+                                std::span<const VkCommandBuffer> commandBuffers,
+                                std::span<const SemaphoreWait> waits,
+                                std::span<const VkSemaphore> binarySignals ) -> uint64_t
+{
+  std::vector<VkSemaphoreSubmitInfo> waitInfos;
+  for ( const auto& wait : waits )
+  {
+    VkSemaphoreSubmitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    waitInfo.semaphore = wait.semaphore;
+    waitInfo.value = wait.value;
+    waitInfo.stageMask = wait.stage;
+    waitInfos.push_back( waitInfo );
+  }
+
+  std::vector<VkCommandBufferSubmitInfo> commandBufferInfos;
+  for ( auto commandBuffer : commandBuffers )
+  {
+    VkCommandBufferSubmitInfo commandBufferInfo{};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+    commandBufferInfo.commandBuffer = commandBuffer;
+    commandBufferInfos.push_back( commandBufferInfo );
+  }
+
+  std::lock_guard lock{ m_submitMutex };
+  auto value = m_lastSubmitted.load() + 1;
+
+  // the timeline goes first, binary semaphores ignore their signal value, both signal once all commands are done
+  std::vector<VkSemaphoreSubmitInfo> signalInfos;
+  VkSemaphoreSubmitInfo signalInfo{};
+  signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+  signalInfo.semaphore = m_semaphore;
+  signalInfo.value = value;
+  signalInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+  signalInfos.push_back( signalInfo );
+  for ( auto binary : binarySignals )
+  {
+    signalInfo.semaphore = binary;
+    signalInfo.value = 0;
+    signalInfos.push_back( signalInfo );
+  }
+
+  VkSubmitInfo2 submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+  submitInfo.waitSemaphoreInfoCount = static_cast<uint32_t>( waitInfos.size() );
+  submitInfo.pWaitSemaphoreInfos = waitInfos.data();
+  submitInfo.commandBufferInfoCount = static_cast<uint32_t>( commandBufferInfos.size() );
+  submitInfo.pCommandBufferInfos = commandBufferInfos.data();
+  submitInfo.signalSemaphoreInfoCount = static_cast<uint32_t>( signalInfos.size() );
+  submitInfo.pSignalSemaphoreInfos = signalInfos.data();
+
+  if ( vkQueueSubmit2( queue, 1, &submitInfo, VK_NULL_HANDLE ) != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to submit to the timeline!" );
+  }
+
+  m_lastSubmitted = value;
+  return value;
+}
+
+auto TimelineScheduler::completedValue() -> uint64_t
+{
+  uint64_t value{ 0u };
+  vkGetSemaphoreCounterValue( m_device, m_semaphore, &value );
+  updateCompleted( value );
+  return value;
+}
+
+auto TimelineScheduler::lastSubmittedValue() const -> uint64_t
+{
+  return m_lastSubmitted.load();
+}
+
+bool TimelineScheduler::isComplete( uint64_t value )
+{
+  // the cached value saves the driver call for everything we already know has retired
+  if ( value <= m_lastCompleted.load() )
+    return true;
+
+  return value <= completedValue();
+}
+
+bool TimelineScheduler::wait( uint64_t value, uint64_t timeout )
+{
+  if ( value <= m_lastCompleted.load() )
+    return true;
+
+  VkSemaphoreWaitInfo waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &m_semaphore;
+  waitInfo.pValues = &value;
+
+  auto result = vkWaitSemaphores( m_device, &waitInfo, timeout );
+  if ( result == VK_TIMEOUT )
+    return false;
+
+  if ( result != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to wait on the timeline!" );
+  }
+
+  updateCompleted( value );
+  return true;
+}
+
+void TimelineScheduler::waitIdle()
+{
+  wait( lastSubmittedValue() );
+}
+
+auto TimelineScheduler::semaphore() const -> VkSemaphore
+{
+  return m_semaphore;
+}
+
+void TimelineScheduler::updateCompleted( uint64_t value )
+{
+  // another thread may have seen a newer value meanwhile, never move the cache backwards
+  auto completed = m_lastCompleted.load();
+  while ( completed < value && !m_lastCompleted.compare_exchange_weak( completed, value ) )
+  {
+  }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <vulkan/vulkan.h>
+
+struct SemaphoreWait
+{
+  VkSemaphore semaphore;
+  // ignored for binary semaphores
+  uint64_t value;
+  VkPipelineStageFlags2 stage;
+};
+
+// gpu progress counter built on a vulkan 1.2 timeline semaphore, every submission gets the next value and signals it
+// when it retires, so anything can wait on or poll "gpu reached value X" instead of idling the whole queue
+class TimelineScheduler
+{
+public:
+  void init( VkDevice device );
+  void destroy();
+
+  auto submit( VkQueue queue,
+               std::span<const VkCommandBuffer> commandBuffers,
+               std::span<const SemaphoreWait> waits = {},
+               std::span<const VkSemaphore> binarySignals = {} ) -> uint64_t;
+
+  auto completedValue() -> uint64_t;
+  auto lastSubmittedValue() const -> uint64_t;
+  bool isComplete( uint64_t value );
+  bool wait( uint64_t value, uint64_t timeout = UINT64_MAX );
+  void waitIdle();
+
+  auto semaphore() const -> VkSemaphore;
+
+private:
+  void updateCompleted( uint64_t value );
+
+  VkDevice m_device{ VK_NULL_HANDLE };
+  VkSemaphore m_semaphore{ VK_NULL_HANDLE };
+
+  // values have to be signaled in increasing order, so reserving one and submitting it happens under the same lock
+  std::mutex m_submitMutex;
+  std::atomic<uint64_t> m_lastSubmitted{ 0u };
+  std::atomic<uint64_t> m_lastCompleted{ 0u };
+};
@@ -0,0 +1,689 @@
+#include "upload_manager.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include "cpu_profiler.hpp"
+
+namespace
+{
+// a multiple of every texel and block size, copies out of the ring start on it
+constexpr VkDeviceSize stagingAlignment = 16;
+
+// every way the renderer reads uploaded data, the acquire has to name them without knowing the resource
+constexpr VkPipelineStageFlags2 bufferConsumerStages = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT |
+                                                       VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+                                                       VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+constexpr VkAccessFlags2 bufferConsumerAccess = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT |
+                                                VK_ACCESS_2_UNIFORM_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT;
+constexpr VkPipelineStageFlags2 imageConsumerStages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+constexpr VkAccessFlags2 imageConsumerAccess = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+
+auto alignUp( VkDeviceSize value, VkDeviceSize alignment ) -> VkDeviceSize
+{
+  return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+auto createPool( VkDevice device, uint32_t family ) -> VkCommandPool
+{
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = family;
+
+  VkCommandPool pool;
+  if ( vkCreateCommandPool( device, &poolInfo, nullptr, &pool ) != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to create upload command pool!" );
+  }
+  return pool;
+}
+
+void pipelineBarrier( VkCommandBuffer cmd,
+                      std::span<const VkBufferMemoryBarrier2> bufferBarriers,
+                      std::span<const VkImageMemoryBarrier2> imageBarriers )
+{
+  VkDependencyInfo dependency{};
+  dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+  dependency.bufferMemoryBarrierCount = static_cast<uint32_t>( bufferBarriers.size() );
+  dependency.pBufferMemoryBarriers = bufferBarriers.data();
+  dependency.imageMemoryBarrierCount = static_cast<uint32_t>( imageBarriers.size() );
+  dependency.pImageMemoryBarriers = imageBarriers.data();
+  vkCmdPipelineBarrier2( cmd, &dependency );
+}
+} // namespace
+
+void UploadManager::init( VkDevice device,
+                          GpuAllocator& allocator,
+                          TimelineScheduler& graphicsTimeline,
+                          const UploadQueues& queues,
+                          VkDeviceSize stagingSize )
+{
+  m_device = device;
+  m_allocator = &allocator;
+  m_graphicsTimeline = &graphicsTimeline;
+  m_queues = queues;
+
+  m_transferTimeline.init( m_device );
+  m_transferPool = createPool( m_device, m_queues.transferFamily );
+  if ( dedicatedTransferQueue() )
+  {
+    m_acquirePool = createPool( m_device, m_queues.graphicsFamily );
+  }
+
+  auto timestampBits = m_queues.transferTimestampBits;
+  m_nsPerTick = m_queues.timestampPeriod;
+  m_timestampMask = timestampBits >= 64 ? UINT64_MAX : ( uint64_t{ 1 } << timestampBits ) - 1;
+  if ( timestampBits > 0 )
+  {
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = maxTimedBatches * 2;
+    if ( vkCreateQueryPool( m_device, &poolInfo, nullptr, &m_timestamps ) != VK_SUCCESS )
+    {
+      throw std::runtime_error( "failed to create upload timestamp query pool!" );
+    }
+    for ( uint32_t query = 0; query < maxTimedBatches * 2; query += 2 )
+    {
+      m_freeQueries.push_back( query );
+    }
+  }
+
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = stagingSize;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if ( vkCreateBuffer( m_device, &bufferInfo, nullptr, &m_ring ) != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to create staging ring!" );
+  }
+  m_ringMemory = m_allocator->allocateBuffer( m_ring, MemoryUsage::Upload );
+  m_ringSize = stagingSize;
+  m_ringHead = 0;
+  m_ringTail = 0;
+}
+
+void UploadManager::destroy()
+{
+  {
+    std::lock_guard lock{ m_mutex };
+    if ( m_hasOpen )
+    {
+      // never submitted, the command buffer is still recording and goes away with the pool
+      m_open.transferCommands = VK_NULL_HANDLE;
+      releaseBatch( m_open );
+      m_hasOpen = false;
+      m_ringTail = m_ringHead;
+    }
+  }
+
+  if ( !m_inFlight.empty() )
+  {
+    m_graphicsTimeline->wait( m_inFlight.back().value );
+  }
+  collect();
+
+  vkDestroyCommandPool( m_device, m_transferPool, nullptr );
+  if ( m_acquirePool != VK_NULL_HANDLE )
+  {
+    vkDestroyCommandPool( m_device, m_acquirePool, nullptr );
+    m_acquirePool = VK_NULL_HANDLE;
+  }
+  m_freeTransferCommands.clear();
+  m_freeAcquireCommands.clear();
+  m_transferTimeline.destroy();
+
+  if ( m_timestamps != VK_NULL_HANDLE )
+  {
+    vkDestroyQueryPool( m_device, m_timestamps, nullptr );
+    m_timestamps = VK_NULL_HANDLE;
+  }
+  m_freeQueries.clear();
+
+  vkDestroyBuffer( m_device, m_ring, nullptr );
+  m_allocator->free( m_ringMemory );
+  m_ring = VK_NULL_HANDLE;
+}
+
+void UploadManager::uploadBuffer( VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset )
+{
+  std::lock_guard lock{ m_mutex };
+  auto bytes = static_cast<const char*>( data );
+  for ( VkDeviceSize copied = 0; copied < size; )
+  {
+    auto chunk = std::min( size - copied, stagingChunk() );
+    memcpy( stageBufferLocked( dst, chunk, dstOffset + copied ), bytes + copied, static_cast<size_t>( chunk ) );
+    copied += chunk;
+  }
+}
+
+auto UploadManager::stageBuffer( VkBuffer dst, VkDeviceSize size, VkDeviceSize dstOffset ) -> void*
+{
+  if ( size > stagingChunk() )
+  {
+    throw std::invalid_argument( "staged write is larger than a staging chunk!" );
+  }
+
+  std::lock_guard lock{ m_mutex };
+  return stageBufferLocked( dst, size, dstOffset );
+}
+
+auto UploadManager::stagingChunk() const -> VkDeviceSize
+{
+  // small enough that the ring can hold the chunk being written next to the ones still in flight
+  return m_ringSize / 4;
+}
+
+auto UploadManager::stageBufferLocked( VkBuffer dst, VkDeviceSize size, VkDeviceSize dstOffset ) -> void*
+{
+  auto ringOffset = reserve( size, stagingAlignment );
+  auto& batch = openBatch();
+  batch.stagedBytes += size;
+
+  VkBufferCopy region{};
+  region.srcOffset = ringOffset % m_ringSize;
+  region.dstOffset = dstOffset;
+  region.size = size;
+  vkCmdCopyBuffer( batch.transferCommands, m_ring, dst, 1, &region );
+
+  VkBufferMemoryBarrier2 barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = dst;
+  barrier.offset = dstOffset;
+  barrier.size = size;
+  batch.bufferBarriers.push_back( barrier );
+
+  return mappedAt( ringOffset );
+}
+
+void UploadManager::uploadImage( VkImage image,
+                                 const void* pixels,
+                                 VkDeviceSize size,
+                                 uint32_t width,
+                                 uint32_t height,
+                                 uint32_t mipLevels )
+{
+  std::lock_guard lock{ m_mutex };
+  if ( size != static_cast<VkDeviceSize>( width ) * height * 4 )
+  {
+    throw std::invalid_argument( "image size does not match 4 bytes per texel!" );
+  }
+
+  beginImageLocked( image, mipLevels );
+  copyImageLevelLocked( image, static_cast<const char*>( pixels ), width, height, 0 );
+
+  if ( mipLevels > 1 )
+  {
+    openBatch().mipChains.push_back( { image, width, height, mipLevels } );
+    return;
+  }
+
+  // the layout change is part of the ownership transfer, release and acquire both have to spell it out
+  VkImageMemoryBarrier2 barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  // a single queue keeps these, the dedicated transfer queue turns them into the ownership transfer
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+  openBatch().imageBarriers.push_back( barrier );
+}
+
+void UploadManager::uploadImageLevels( VkImage image,
+                                       std::span<const ImageLevel> levels,
+                                       uint32_t blockBytes,
+                                       uint32_t blockExtent )
+{
+  std::lock_guard lock{ m_mutex };
+  auto mipLevels = static_cast<uint32_t>( levels.size() );
+  beginImageLocked( image, mipLevels );
+
+  for ( uint32_t level = 0; level < mipLevels; level++ )
+  {
+    const auto& source = levels[level];
+    copyImageLevelLocked(
+      image, static_cast<const char*>( source.data ), source.width, source.height, level, blockBytes, blockExtent );
+  }
+
+  VkImageMemoryBarrier2 barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+  openBatch().imageBarriers.push_back( barrier );
+}
+
+void UploadManager::beginImageLocked( VkImage image, uint32_t mipLevels )
+{
+  VkImageMemoryBarrier2 toTransfer{};
+  toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+  toTransfer.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+  toTransfer.srcAccessMask = VK_ACCESS_2_NONE;
+  toTransfer.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+  toTransfer.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.image = image;
+  toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+  pipelineBarrier( openBatch().transferCommands, {}, { &toTransfer, 1 } );
+}
+
+void UploadManager::copyImageLevelLocked( VkImage image,
+                                          const char* pixels,
+                                          uint32_t width,
+                                          uint32_t height,
+                                          uint32_t mipLevel,
+                                          uint32_t blockBytes,
+                                          uint32_t blockExtent )
+{
+  auto blocksHigh = ( height + blockExtent - 1 ) / blockExtent;
+  VkDeviceSize rowBytes = static_cast<VkDeviceSize>( ( width + blockExtent - 1 ) / blockExtent ) * blockBytes;
+  if ( rowBytes > m_ringSize )
+  {
+    throw std::invalid_argument( "image row is larger than the staging ring!" );
+  }
+
+  // chunks are whole rows of blocks, a full ring may submit the batch in between so it is looked up again for every
+  // chunk, the last chunk ends on the edge of the level even when that cuts through its blocks
+  auto rowsPerChunk = static_cast<uint32_t>( std::max<VkDeviceSize>( 1, stagingChunk() / rowBytes ) );
+  for ( uint32_t blockRow = 0; blockRow < blocksHigh; blockRow += rowsPerChunk )
+  {
+    auto blockRows = std::min( rowsPerChunk, blocksHigh - blockRow );
+    auto row = blockRow * blockExtent;
+    auto rows = std::min( blockRows * blockExtent, height - row );
+    auto chunk = blockRows * rowBytes;
+    auto ringOffset = reserve( chunk, stagingAlignment );
+    memcpy( mappedAt( ringOffset ), pixels + blockRow * rowBytes, static_cast<size_t>( chunk ) );
+
+    auto& batch = openBatch();
+    batch.stagedBytes += chunk;
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = ringOffset % m_ringSize;
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, 0, 1 };
+    region.imageOffset = { 0, static_cast<int32_t>( row ), 0 };
+    region.imageExtent = { width, rows, 1 };
+    vkCmdCopyBufferToImage(
+      batch.transferCommands, m_ring, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region );
+  }
+}
+
+auto UploadManager::mipChainBarrier( const MipChain& chain ) const -> VkImageMemoryBarrier2
+{
+  VkImageMemoryBarrier2 barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = m_queues.transferFamily;
+  barrier.dstQueueFamilyIndex = m_queues.graphicsFamily;
+  barrier.image = chain.image;
+  barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, chain.mipLevels, 0, 1 };
+  return barrier;
+}
+
+void UploadManager::recordMipChain( VkCommandBuffer cmd, const MipChain& chain ) const
+{
+  // each level is read by the blit into the next one and handed to the fragment shader right after, level 0 was
+  // written by the copy and the others by the blit before them
+  VkImageMemoryBarrier2 barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = chain.image;
+  barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+  auto width = static_cast<int32_t>( chain.width );
+  auto height = static_cast<int32_t>( chain.height );
+  for ( uint32_t level = 1; level < chain.mipLevels; level++ )
+  {
+    barrier.subresourceRange.baseMipLevel = level - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+    pipelineBarrier( cmd, {}, { &barrier, 1 } );
+
+    auto nextWidth = std::max( 1, width / 2 );
+    auto nextHeight = std::max( 1, height / 2 );
+    VkImageBlit blit{};
+    blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+    blit.srcOffsets[1] = { width, height, 1 };
+    blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+    blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+    vkCmdBlitImage( cmd,
+                    chain.image,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    chain.image,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    1,
+                    &blit,
+                    VK_FILTER_LINEAR );
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+    barrier.dstStageMask = imageConsumerStages;
+    barrier.dstAccessMask = imageConsumerAccess;
+    pipelineBarrier( cmd, {}, { &barrier, 1 } );
+
+    width = nextWidth;
+    height = nextHeight;
+  }
+
+  // the smallest level was only ever written
+  barrier.subresourceRange.baseMipLevel = chain.mipLevels - 1;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT;
+  barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  barrier.dstStageMask = imageConsumerStages;
+  barrier.dstAccessMask = imageConsumerAccess;
+  pipelineBarrier( cmd, {}, { &barrier, 1 } );
+}
+
+auto UploadManager::flush() -> uint64_t
+{
+  PROFILE_FUNCTION();
+  std::lock_guard lock{ m_mutex };
+  return flushLocked();
+}
+
+auto UploadManager::flushLocked() -> uint64_t
+{
+  if ( !m_hasOpen )
+    return 0;
+
+  auto batch = std::move( m_open );
+  m_hasOpen = false;
+  m_totalUploads += batch.bufferBarriers.size() + batch.imageBarriers.size() + batch.mipChains.size();
+  batch.ringEnd = m_ringHead;
+  endTimestamp( batch );
+
+  if ( !dedicatedTransferQueue() )
+  {
+    // one queue does it all, a plain barrier makes the copies visible to everything submitted after
+    for ( auto& barrier : batch.bufferBarriers )
+    {
+      barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+      barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+      barrier.dstStageMask = bufferConsumerStages;
+      barrier.dstAccessMask = bufferConsumerAccess;
+    }
+    for ( auto& barrier : batch.imageBarriers )
+    {
+      barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+      barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+      barrier.dstStageMask = imageConsumerStages;
+      barrier.dstAccessMask = imageConsumerAccess;
+    }
+    pipelineBarrier( batch.transferCommands, batch.bufferBarriers, batch.imageBarriers );
+    // the copies into level 0 are on the same queue, the blits only wait for them
+    for ( const auto& chain : batch.mipChains )
+    {
+      recordMipChain( batch.transferCommands, chain );
+    }
+    vkEndCommandBuffer( batch.transferCommands );
+
+    batch.value = m_graphicsTimeline->submit( m_queues.graphicsQueue, { &batch.transferCommands, 1 } );
+    m_inFlight.push_back( std::move( batch ) );
+    return m_inFlight.back().value;
+  }
+
+  // release, the destination stage and access are ignored on this side
+  for ( auto& barrier : batch.bufferBarriers )
+  {
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    barrier.dstAccessMask = VK_ACCESS_2_NONE;
+    barrier.srcQueueFamilyIndex = m_queues.transferFamily;
+    barrier.dstQueueFamilyIndex = m_queues.graphicsFamily;
+  }
+  for ( auto& barrier : batch.imageBarriers )
+  {
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    barrier.dstAccessMask = VK_ACCESS_2_NONE;
+    barrier.srcQueueFamilyIndex = m_queues.transferFamily;
+    barrier.dstQueueFamilyIndex = m_queues.graphicsFamily;
+  }
+  // images whose mips are blitted on the graphics queue move over in TRANSFER_DST_OPTIMAL
+  std::vector<VkImageMemoryBarrier2> mipChainBarriers;
+  for ( const auto& chain : batch.mipChains )
+  {
+    mipChainBarriers.push_back( mipChainBarrier( chain ) );
+    mipChainBarriers.back().srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    mipChainBarriers.back().srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  }
+  auto releaseImages = batch.imageBarriers;
+  releaseImages.insert( releaseImages.end(), mipChainBarriers.begin(), mipChainBarriers.end() );
+  pipelineBarrier( batch.transferCommands, batch.bufferBarriers, releaseImages );
+  vkEndCommandBuffer( batch.transferCommands );
+  auto transferValue = m_transferTimeline.submit( m_queues.transferQueue, { &batch.transferCommands, 1 } );
+
+  // acquire, the semaphore wait covers the source side so the barrier only has to make the data visible
+  batch.acquireCommands = takeCommandBuffer( m_acquirePool, m_freeAcquireCommands );
+  for ( auto& barrier : batch.bufferBarriers )
+  {
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    barrier.srcAccessMask = VK_ACCESS_2_NONE;
+    barrier.dstStageMask = bufferConsumerStages;
+    barrier.dstAccessMask = bufferConsumerAccess;
+  }
+  for ( auto& barrier : batch.imageBarriers )
+  {
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    barrier.srcAccessMask = VK_ACCESS_2_NONE;
+    barrier.dstStageMask = imageConsumerStages;
+    barrier.dstAccessMask = imageConsumerAccess;
+  }
+  pipelineBarrier( batch.acquireCommands, batch.bufferBarriers, batch.imageBarriers );
+  if ( !mipChainBarriers.empty() )
+  {
+    for ( auto& barrier : mipChainBarriers )
+    {
+      barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+      barrier.srcAccessMask = VK_ACCESS_2_NONE;
+      barrier.dstStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT;
+      barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    }
+    pipelineBarrier( batch.acquireCommands, {}, mipChainBarriers );
+    for ( const auto& chain : batch.mipChains )
+    {
+      recordMipChain( batch.acquireCommands, chain );
+    }
+  }
+  vkEndCommandBuffer( batch.acquireCommands );
+
+  SemaphoreWait transferDone{ m_transferTimeline.semaphore(), transferValue, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT };
+  batch.value =
+    m_graphicsTimeline->submit( m_queues.graphicsQueue, { &batch.acquireCommands, 1 }, { &transferDone, 1 } );
+  m_inFlight.push_back( std::move( batch ) );
+  return m_inFlight.back().value;
+}
+
+void UploadManager::collect()
+{
+  std::lock_guard lock{ m_mutex };
+  collectLocked();
+}
+
+void UploadManager::collectLocked()
+{
+  // the acquire waits on the transfer, so the graphics value retiring means both sides are done
+  while ( !m_inFlight.empty() && m_graphicsTimeline->isComplete( m_inFlight.front().value ) )
+  {
+    auto& batch = m_inFlight.front();
+    if ( batch.query != UINT32_MAX && batch.stagedBytes > 0 )
+    {
+      // retired, so the results are there without waiting
+      std::array<uint64_t, 2> timestamps{};
+      auto result = vkGetQueryPoolResults( m_device,
+                                           m_timestamps,
+                                           batch.query,
+                                           2,
+                                           sizeof( timestamps ),
+                                           timestamps.data(),
+                                           sizeof( uint64_t ),
+                                           VK_QUERY_RESULT_64_BIT );
+      auto ticks = ( timestamps[1] - timestamps[0] ) & m_timestampMask;
+      if ( result == VK_SUCCESS && ticks > 0 )
+      {
+        auto seconds = static_cast<double>( ticks ) * m_nsPerTick / 1e9;
+        m_stagingMbPerSecond.push( batch.stagedBytes / ( 1024.0 * 1024.0 ) / seconds );
+      }
+    }
+    m_totalStagedBytes += batch.stagedBytes;
+
+    m_ringTail = batch.ringEnd;
+    releaseBatch( batch );
+    m_inFlight.pop_front();
+  }
+}
+
+bool UploadManager::dedicatedTransferQueue() const
+{
+  return m_queues.transferFamily != m_queues.graphicsFamily;
+}
+
+auto UploadManager::pendingUploads() const -> uint32_t
+{
+  std::lock_guard lock{ m_mutex };
+  return static_cast<uint32_t>( m_open.bufferBarriers.size() + m_open.imageBarriers.size() + m_open.mipChains.size() );
+}
+
+auto UploadManager::batchesInFlight() const -> uint32_t
+{
+  std::lock_guard lock{ m_mutex };
+  return static_cast<uint32_t>( m_inFlight.size() );
+}
+
+auto UploadManager::totalUploads() const -> uint64_t
+{
+  std::lock_guard lock{ m_mutex };
+  return m_totalUploads;
+}
+
+auto UploadManager::stagingStats() const -> StagingStats
+{
+  std::lock_guard lock{ m_mutex };
+  return { m_ringSize, m_ringHead - m_ringTail, m_totalStagedBytes, m_stagingMbPerSecond.average() };
+}
+
+auto UploadManager::reserve( VkDeviceSize size, VkDeviceSize alignment ) -> VkDeviceSize
+{
+  while ( true )
+  {
+    auto offset = alignUp( m_ringHead, alignment );
+    // a region never wraps around, the rest of the lap is skipped instead
+    if ( offset % m_ringSize + size > m_ringSize )
+    {
+      offset = alignUp( offset, m_ringSize );
+    }
+
+    if ( offset + size - m_ringTail <= m_ringSize )
+    {
+      m_ringHead = offset + size;
+      return offset;
+    }
+
+    // full, wait for the oldest batch or submit the open one when it holds the whole ring by itself
+    if ( !m_inFlight.empty() )
+    {
+      m_graphicsTimeline->wait( m_inFlight.front().value );
+      collectLocked();
+    }
+    else
+    {
+      flushLocked();
+    }
+  }
+}
+
+auto UploadManager::mappedAt( VkDeviceSize ringOffset ) const -> void*
+{
+  return static_cast<char*>( m_ringMemory.mapped ) + ringOffset % m_ringSize;
+}
+
+auto UploadManager::openBatch() -> UploadBatch&
+{
+  if ( !m_hasOpen )
+  {
+    m_open = UploadBatch{};
+    m_open.transferCommands = takeCommandBuffer( m_transferPool, m_freeTransferCommands );
+    m_hasOpen = true;
+
+    if ( !m_freeQueries.empty() )
+    {
+      m_open.query = m_freeQueries.back();
+      m_freeQueries.pop_back();
+      vkResetQueryPool( m_device, m_timestamps, m_open.query, 2 );
+      vkCmdWriteTimestamp2( m_open.transferCommands, VK_PIPELINE_STAGE_2_NONE, m_timestamps, m_open.query );
+    }
+  }
+  return m_open;
+}
+
+auto UploadManager::takeCommandBuffer( VkCommandPool pool, std::vector<VkCommandBuffer>& freeList )
+  -> VkCommandBuffer
+{
+  VkCommandBuffer commandBuffer;
+  if ( !freeList.empty() )
+  {
+    commandBuffer = freeList.back();
+    freeList.pop_back();
+    vkResetCommandBuffer( commandBuffer, 0 );
+  }
+  else
+  {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = pool;
+    allocInfo.commandBufferCount = 1;
+    if ( vkAllocateCommandBuffers( m_device, &allocInfo, &commandBuffer ) != VK_SUCCESS )
+    {
+      throw std::runtime_error( "failed to allocate upload command buffer!" );
+    }
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer( commandBuffer, &beginInfo );
+
+  return commandBuffer;
+}
+
+void UploadManager::endTimestamp( const UploadBatch& batch )
+{
+  if ( batch.query != UINT32_MAX )
+  {
+    vkCmdWriteTimestamp2( batch.transferCommands, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, m_timestamps, batch.query + 1 );
+  }
+}
+
+void UploadManager::releaseBatch( UploadBatch& batch )
+{
+  if ( batch.query != UINT32_MAX )
+    m_freeQueries.push_back( batch.query );
+  if ( batch.transferCommands != VK_NULL_HANDLE )
+    m_freeTransferCommands.push_back( batch.transferCommands );
+  if ( batch.acquireCommands != VK_NULL_HANDLE )
+    m_freeAcquireCommands.push_back( batch.acquireCommands );
+}
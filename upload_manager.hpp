@@ -0,0 +1,178 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "frame_stats.hpp"
+#include "gpu_allocator.hpp"
+#include "timeline_scheduler.hpp"
+
+struct UploadQueues
+{
+  VkQueue graphicsQueue;
+  uint32_t graphicsFamily;
+  // same as the graphics pair when the device has no separate transfer family
+  VkQueue transferQueue;
+  uint32_t transferFamily;
+  // of the transfer family, 0 when it cannot write timestamps and the staging rate is not measured
+  uint32_t transferTimestampBits;
+  float timestampPeriod;
+};
+
+// one level of an image as the caller has it in memory, tightly packed rows of texel blocks
+struct ImageLevel
+{
+  const void* data;
+  uint32_t width;
+  uint32_t height;
+};
+
+struct StagingStats
+{
+  VkDeviceSize capacity;
+  // written but not yet retired by the gpu
+  VkDeviceSize inUse;
+  uint64_t totalBytes;
+  // staged bytes over the time the gpu spent on the batch's copies, between timestamps written on the transfer queue
+  double mbPerSecond;
+};
+
+// batches buffer and image uploads into a single transfer queue submission, when the transfer family differs from
+// the graphics one the resources are released by the transfer queue and acquired by a small graphics submission that
+// waits on the transfer timeline, so neither queue nor the cpu ever idles on a copy
+//
+// all payloads go through one persistently mapped staging ring, a region is handed back once the timeline value of
+// the batch that read it retires and anything bigger than a quarter of the ring is copied in chunks
+class UploadManager
+{
+public:
+  void init( VkDevice device,
+             GpuAllocator& allocator,
+             TimelineScheduler& graphicsTimeline,
+             const UploadQueues& queues,
+             VkDeviceSize stagingSize = defaultStagingSize );
+  void destroy();
+
+  // record into the open batch from the thread that submits frames, a full ring submits the open batch on the spot
+  // and waits for the oldest one to retire
+  void uploadBuffer( VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0 );
+  // whole image with 4 bytes per texel, ends up in SHADER_READ_ONLY_OPTIMAL, the levels below the first are blitted
+  // down from it on the graphics queue, so the format has to support linear filtering when mipLevels is above 1
+  void uploadImage( VkImage image,
+                    const void* pixels,
+                    VkDeviceSize size,
+                    uint32_t width,
+                    uint32_t height,
+                    uint32_t mipLevels = 1 );
+  // every level supplied by the caller starting with the largest, nothing is blitted so block compressed formats work
+  // too, blockBytes is the size of a blockExtent x blockExtent block of texels
+  void uploadImageLevels( VkImage image,
+                          std::span<const ImageLevel> levels,
+                          uint32_t blockBytes = 4,
+                          uint32_t blockExtent = 1 );
+  // lets the caller write straight into the ring, at most stagingChunk() bytes, the copy is already recorded so the
+  // memory has to be filled before the next flush
+  auto stageBuffer( VkBuffer dst, VkDeviceSize size, VkDeviceSize dstOffset = 0 ) -> void*;
+  auto stagingChunk() const -> VkDeviceSize;
+
+  // submits the open batch, graphics work submitted afterwards sees the uploads, call it from the thread that
+  // submits frames since it shares the graphics queue, returns the graphics timeline value of the batch or 0
+  auto flush() -> uint64_t;
+  // hands back staging space and command buffers of retired batches
+  void collect();
+
+  bool dedicatedTransferQueue() const;
+  auto pendingUploads() const -> uint32_t;
+  auto batchesInFlight() const -> uint32_t;
+  auto totalUploads() const -> uint64_t;
+  auto stagingStats() const -> StagingStats;
+
+  static constexpr VkDeviceSize defaultStagingSize = 32ull * 1024 * 1024;
+
+private:
+  // batches in flight beyond this many are not timed
+  static constexpr uint32_t maxTimedBatches = 16;
+
+  // levels of an image that are generated on the graphics queue once level 0 arrived
+  struct MipChain
+  {
+    VkImage image;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+  };
+
+  struct UploadBatch
+  {
+    VkCommandBuffer transferCommands{ VK_NULL_HANDLE };
+    VkCommandBuffer acquireCommands{ VK_NULL_HANDLE };
+    // recorded as the release on the transfer queue and again as the acquire on the graphics one
+    std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+    std::vector<VkImageMemoryBarrier2> imageBarriers;
+    std::vector<MipChain> mipChains;
+    uint64_t value{ 0u };
+    // ring head when the batch was closed, everything before it is free once the batch retires
+    VkDeviceSize ringEnd{ 0u };
+    VkDeviceSize stagedBytes{ 0u };
+    // first of the two timestamps around the copies, UINT32_MAX when the batch is not timed
+    uint32_t query{ UINT32_MAX };
+  };
+
+  // ring offsets grow forever and are wrapped on use, so head - tail is always the space in use
+  auto reserve( VkDeviceSize size, VkDeviceSize alignment ) -> VkDeviceSize;
+  auto mappedAt( VkDeviceSize ringOffset ) const -> void*;
+  auto stageBufferLocked( VkBuffer dst, VkDeviceSize size, VkDeviceSize dstOffset ) -> void*;
+  // starts an image upload, every level goes to TRANSFER_DST_OPTIMAL
+  void beginImageLocked( VkImage image, uint32_t mipLevels );
+  void copyImageLevelLocked( VkImage image,
+                             const char* pixels,
+                             uint32_t width,
+                             uint32_t height,
+                             uint32_t mipLevel,
+                             uint32_t blockBytes = 4,
+                             uint32_t blockExtent = 1 );
+  // ownership of all levels goes over to the graphics queue, still in TRANSFER_DST_OPTIMAL
+  auto mipChainBarrier( const MipChain& chain ) const -> VkImageMemoryBarrier2;
+  void recordMipChain( VkCommandBuffer cmd, const MipChain& chain ) const;
+  // after the copies and before the barriers, so only the copies are timed
+  void endTimestamp( const UploadBatch& batch );
+  auto flushLocked() -> uint64_t;
+  void collectLocked();
+  auto openBatch() -> UploadBatch&;
+  auto takeCommandBuffer( VkCommandPool pool, std::vector<VkCommandBuffer>& freeList ) -> VkCommandBuffer;
+  void releaseBatch( UploadBatch& batch );
+
+  VkDevice m_device{ VK_NULL_HANDLE };
+  GpuAllocator* m_allocator{ nullptr };
+  TimelineScheduler* m_graphicsTimeline{ nullptr };
+  UploadQueues m_queues{};
+
+  // only submits when the transfer queue is its own, otherwise everything goes through the graphics timeline
+  TimelineScheduler m_transferTimeline;
+  VkCommandPool m_transferPool{ VK_NULL_HANDLE };
+  VkCommandPool m_acquirePool{ VK_NULL_HANDLE };
+  std::vector<VkCommandBuffer> m_freeTransferCommands;
+  std::vector<VkCommandBuffer> m_freeAcquireCommands;
+
+  // maxTimedBatches pairs, reset from the host since the transfer queue cannot reset queries
+  VkQueryPool m_timestamps{ VK_NULL_HANDLE };
+  std::vector<uint32_t> m_freeQueries;
+  double m_nsPerTick{ 1.0 };
+  uint64_t m_timestampMask{ 0u };
+
+  VkBuffer m_ring{ VK_NULL_HANDLE };
+  GpuAllocation m_ringMemory;
+  VkDeviceSize m_ringSize{ 0u };
+  VkDeviceSize m_ringHead{ 0u };
+  VkDeviceSize m_ringTail{ 0u };
+
+  UploadBatch m_open;
+  bool m_hasOpen{ false };
+  std::deque<UploadBatch> m_inFlight;
+  uint64_t m_totalUploads{ 0u };
+  uint64_t m_totalStagedBytes{ 0u };
+  RollingStats<64> m_stagingMbPerSecond;
+
+  mutable std::mutex m_mutex;
+};
@@ -0,0 +1,82 @@
+#include "vertex_layout.hpp"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <glm/gtc/packing.hpp>
+
+auto vertexStride( VertexLayout layout ) -> uint32_t
+{
+  return vertexInputDescription( layout ).binding.stride;
+}
+
+auto vertexInputDescription( VertexLayout layout ) -> VertexInputDescription
+{
+  switch ( layout )
+  {
+    case VertexLayout::Standard:
+    {
+      auto attributes = Vertex::getAttributeDescriptions();
+      return { Vertex::getBindingDescription(), { attributes.begin(), attributes.end() } };
+    }
+    case VertexLayout::Compact:
+    {
+      auto attributes = CompactVertex::getAttributeDescriptions();
+      return { CompactVertex::getBindingDescription(), { attributes.begin(), attributes.end() } };
+    }
+  }
+  throw std::runtime_error( "unknown vertex layout" );
+}
+
+auto quantizeVertices( const std::vector<Vertex>& vertices, const std::vector<glm::vec3>& normals )
+  -> QuantizedVertices
+{
+  QuantizedVertices quantized{};
+  if ( vertices.empty() )
+    return quantized;
+
+  glm::vec3 min{ vertices[0].pos };
+  glm::vec3 max{ vertices[0].pos };
+  for ( const auto& vertex : vertices )
+  {
+    min = glm::min( min, vertex.pos );
+    max = glm::max( max, vertex.pos );
+  }
+
+  // the bounds map onto [-1, 1] on every axis, a flat axis keeps a scale of 1 so nothing divides by zero
+  quantized.dequantize.offset = ( min + max ) * 0.5f;
+  quantized.dequantize.scale = glm::max( ( max - min ) * 0.5f, glm::vec3( 1e-6f ) );
+
+  quantized.vertices.reserve( vertices.size() );
+  for ( size_t i = 0; i < vertices.size(); i++ )
+  {
+    const auto& vertex = vertices[i];
+    auto position = ( vertex.pos - quantized.dequantize.offset ) / quantized.dequantize.scale;
+    auto normal = encodeOctahedral( normals.empty() ? glm::vec3( 0.0f, 0.0f, 1.0f ) : normals[i] );
+    auto color = glm::packUnorm4x8( glm::vec4( vertex.color, 1.0f ) );
+
+    CompactVertex compact{};
+    compact.pos[0] = static_cast<int16_t>( glm::packSnorm1x16( position.x ) );
+    compact.pos[1] = static_cast<int16_t>( glm::packSnorm1x16( position.y ) );
+    compact.pos[2] = static_cast<int16_t>( glm::packSnorm1x16( position.z ) );
+    compact.normal[0] = static_cast<int16_t>( glm::packSnorm1x16( normal.x ) );
+    compact.normal[1] = static_cast<int16_t>( glm::packSnorm1x16( normal.y ) );
+    compact.texCoord[0] = glm::packHalf1x16( vertex.texCoord.x );
+    compact.texCoord[1] = glm::packHalf1x16( vertex.texCoord.y );
+    memcpy( compact.color, &color, sizeof( compact.color ) );
+    quantized.vertices.push_back( compact );
+  }
+  return quantized;
+}
+
+auto encodeOctahedral( glm::vec3 normal ) -> glm::vec2
+{
+  // project onto the octahedron, then fold the lower half over the diagonals of the upper one
+  normal /= std::abs( normal.x ) + std::abs( normal.y ) + std::abs( normal.z );
+  glm::vec2 encoded{ normal.x, normal.y };
+  if ( normal.z < 0.0f )
+  {
+    glm::vec2 sign{ encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f };
+    encoded = ( glm::vec2( 1.0f ) - glm::abs( glm::vec2( encoded.y, encoded.x ) ) ) * sign;
+  }
+  return encoded;
+}
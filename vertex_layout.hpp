@@ -0,0 +1,136 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+// how a mesh stores its vertices, every layout has its own pipeline and vertex shader
+enum class VertexLayout
+{
+  // 32 bytes of floats
+  Standard,
+  // 20 bytes, see CompactVertex
+  Compact,
+};
+
+constexpr uint32_t vertexLayoutCount = 2;
+
+struct Vertex
+{
+  glm::vec3 pos;
+  glm::vec3 color;
+  glm::vec2 texCoord;
+
+  static VkVertexInputBindingDescription getBindingDescription()
+  {
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof( Vertex );
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+  }
+
+  static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
+  {
+    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[0].offset = offsetof( Vertex, pos );
+
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[1].offset = offsetof( Vertex, color );
+
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[2].offset = offsetof( Vertex, texCoord );
+
+    return attributeDescriptions;
+  }
+};
+
+// the fixed function vertex fetch expands everything back to floats, the normal is stored but no shader reads it yet
+struct CompactVertex
+{
+  // snorm inside the bounds of the mesh, the dequantize transform of the mesh maps it back, w only pads
+  int16_t pos[4];
+  // snorm octahedral encoding of the unit normal
+  int16_t normal[2];
+  // half floats
+  uint16_t texCoord[2];
+  // unorm
+  uint8_t color[4];
+
+  static VkVertexInputBindingDescription getBindingDescription()
+  {
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof( CompactVertex );
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+  }
+
+  static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions()
+  {
+    std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+    attributeDescriptions[0].offset = offsetof( CompactVertex, pos );
+
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+    attributeDescriptions[1].offset = offsetof( CompactVertex, color );
+
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+    attributeDescriptions[2].offset = offsetof( CompactVertex, texCoord );
+
+    attributeDescriptions[3].binding = 0;
+    attributeDescriptions[3].location = 3;
+    attributeDescriptions[3].format = VK_FORMAT_R16G16_SNORM;
+    attributeDescriptions[3].offset = offsetof( CompactVertex, normal );
+
+    return attributeDescriptions;
+  }
+};
+
+struct VertexInputDescription
+{
+  VkVertexInputBindingDescription binding;
+  std::vector<VkVertexInputAttributeDescription> attributes;
+};
+
+auto vertexStride( VertexLayout layout ) -> uint32_t;
+auto vertexInputDescription( VertexLayout layout ) -> VertexInputDescription;
+
+// from the snorm positions of a mesh back to the ones it came with, applied by the vertex shader before the model
+// matrix, the identity for float positions
+struct Dequantize
+{
+  glm::vec3 scale{ 1.0f };
+  glm::vec3 offset{ 0.0f };
+};
+
+struct QuantizedVertices
+{
+  std::vector<CompactVertex> vertices;
+  Dequantize dequantize;
+};
+
+// normals may be empty, the vertices then face +z like the demo quads do
+auto quantizeVertices( const std::vector<Vertex>& vertices, const std::vector<glm::vec3>& normals )
+  -> QuantizedVertices;
+// unit vector to a point of the [-1, 1] square, the decode is the usual octahedral unfold
+auto encodeOctahedral( glm::vec3 normal ) -> glm::vec2;
@@ -1,124 +1,618 @@
 #define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "vulkan_backend.hpp"
 #include <chrono>
 #include <algorithm>
+#include <bit>
 #include <filesystem>
 #include <fstream>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <set>
+#include <string_view>
 #include <spdlog/spdlog.h>
 #include "stb_image.h"
+#include "stb_image_write.h"
+
+// set by cmake to the source directory, the texture is loaded relative to it
+#ifndef ASSET_ROOT
+#define ASSET_ROOT ""
+#endif
+// set by cmake to the build directory, the shaders are compiled into it
+#ifndef SHADER_ROOT
+#define SHADER_ROOT ""
+#endif
 
 void VulkanBase::initVulkan()
 {
-  initWindow();
+  if ( !m_headless )
+  {
+    initWindow();
+  }
 
   createInstance();
   setupDebug();
 
-  createSurface();
+  if ( !m_headless )
+  {
+    createSurface();
+  }
   pickPhysicalDevice();
   createLogicalDevice();
 
-  createSwapChain();
-  createImageViews();
+  if ( m_headless )
+  {
+    setupOffscreenTarget();
+  }
+  else
+  {
+    createSwapChain();
+    createImageViews();
+  }
 
   createCommandPool();
-  createCommandBuffer();
 
-  createDepthResources();
   createViewport();
-  createUniformBuffers();
-  createTextureImage();
-  createTextureImageView();
+  loadTextures();
   createTextureSamplers();
   createDescriptorSetLayout();
   createDescriptorPool();
-  createDescriptorSets();
+  createFrameContexts();
 
   createGraphicsPipeline();
 
-  createVertexBuffer();
-  createIndexBuffer();
+  createSceneGeometry();
+  setSceneDraws( { DrawCommand{ sceneMesh() } } );
+  registerResidentResources();
+
+  if ( !m_headless )
+  {
+    initImgui();
+  }
+}
 
+void VulkanBase::setHeadless( const HeadlessConfig& config )
+{
+  m_headless = true;
+  m_headlessConfig = config;
+}
+
+void VulkanBase::setupOffscreenTarget()
+{
+  // the viewport image doubles as the render target, it takes the place of the swapchain's extent and format
+  m_swapChainExtent = { m_headlessConfig.width, m_headlessConfig.height };
+  m_swapChainImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+void VulkanBase::createFrameContexts()
+{
+  PROFILE_FUNCTION();
+  m_frames.resize( m_framesInFlight );
+
+  createCommandBuffer();
+  createUniformBuffers();
+  createDescriptorSets();
   createSyncObj();
-  initImgui();
+
+  // new secondaries and descriptor sets, and after a resize the viewport and depth image changed as well
+  invalidateScenePass();
+}
+
+void VulkanBase::destroyFrameContexts()
+{
+  for ( auto& frame : m_frames )
+  {
+    // destroying the pools frees the command buffers allocated from them
+    vkDestroyCommandPool( m_device, frame.commandPool, nullptr );
+    for ( auto pool : frame.workerPools )
+    {
+      vkDestroyCommandPool( m_device, pool, nullptr );
+    }
+
+    vkFreeDescriptorSets( m_device, m_descriptorPool, 1, &frame.descriptorSet );
+
+    destroyFrameUniforms( frame );
+
+    vkDestroySemaphore( m_device, frame.imageAvailableSemaphore, nullptr );
+  }
+  m_frames.clear();
+}
+
+void VulkanBase::setFramesInFlight( uint32_t count )
+{
+  // the descriptor pool and imgui are sized for MAX_FRAMES_IN_FLIGHT, so that is the upper bound
+  m_requestedFramesInFlight = std::clamp( count, 1u, static_cast<uint32_t>( MAX_FRAMES_IN_FLIGHT ) );
 }
 
 void VulkanBase::createUniformBuffers()
 {
-  VkDeviceSize bufferSize = sizeof( UniformBufferoObject );
-  m_uniformBuffers.resize( MAX_FRAMES_IN_FLIGHT );
-  m_uniformBuffersMemory.resize( MAX_FRAMES_IN_FLIGHT );
-  m_uniformBuffersMapped.resize( MAX_FRAMES_IN_FLIGHT );
+  // a buffer per slot, so one slot can grow while the others are still in flight
+  for ( auto& frame : m_frames )
+  {
+    createFrameUniforms( frame, m_frameUniformBytes );
+  }
+}
+
+void VulkanBase::createFrameUniforms( FrameContext& frame, VkDeviceSize bytes )
+{
+  // every slot bump allocates out of its own buffer, the offsets it hands out are aligned for use as dynamic offsets
+  auto alignment = m_physicalDeviceProps.limits.minUniformBufferOffsetAlignment;
+  VkDeviceSize size = ( bytes + alignment - 1 ) & ~( alignment - 1 );
+  createBuffer(
+    size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, MemoryUsage::Dynamic, frame.uniformBuffer, frame.uniformMemory );
+
+  // host visible memory stays mapped for as long as it is allocated
+  frame.uniformAllocator.init( frame.uniformMemory.mapped, 0, size, alignment );
+}
+
+void VulkanBase::destroyFrameUniforms( FrameContext& frame )
+{
+  vkDestroyBuffer( m_device, frame.uniformBuffer, nullptr );
+  m_allocator.free( frame.uniformMemory );
+}
+
+void VulkanBase::growFrameUniforms( FrameContext& frame, VkDeviceSize bytes )
+{
+  // only this slot's submissions read the buffer and the set, and its previous one has retired
+  destroyFrameUniforms( frame );
+  createFrameUniforms( frame, bytes );
+  m_frameUniformBytes = std::max( m_frameUniformBytes, frame.uniformAllocator.capacity() );
+
+  VkDescriptorBufferInfo bufferInfo{ frame.uniformBuffer, 0, sizeof( UniformBufferoObject ) };
+  VkWriteDescriptorSet write{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                              .dstSet = frame.descriptorSet,
+                              .dstBinding = 0,
+                              .dstArrayElement = 0,
+                              .descriptorCount = 1,
+                              .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                              .pBufferInfo = &bufferInfo };
+  vkUpdateDescriptorSets( m_device, 1, &write, 0, nullptr );
+
+  // secondaries that bound the set are invalid once it is updated, the slot's generation can never match again
+  frame.sceneGeneration = 0;
+}
+
+void VulkanBase::recordScenePass( VkCommandBuffer cmd,
+                                  const FrameContext& frame,
+                                  size_t firstDraw,
+                                  size_t drawCount )
+{
+  VkViewport viewport{ 0, 0, (float)m_swapChainExtent.width, (float)m_swapChainExtent.height, 0.0f, 1.0f };
+  vkCmdSetViewport( cmd, 0, 1, &viewport );
+
+  VkRect2D scissor{ { 0, 0 }, m_swapChainExtent };
+  vkCmdSetScissor( cmd, 0, 1, &scissor );
+
+  // rebinding set 0 below leaves set 1 alone, the table stays bound for every draw of the pass
+  if ( m_bindless )
+  {
+    auto table = m_bindlessTable.set();
+    vkCmdBindDescriptorSets( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 1, 1, &table, 0, nullptr );
+  }
+
+  // draws of the same page and layout share the binds, only the offsets of each mesh change between them
+  std::optional<uint32_t> boundPage;
+  std::optional<VertexLayout> boundLayout;
+  for ( auto i = firstDraw; i < firstDraw + drawCount; i++ )
+  {
+    // the offsets only depend on the draw order, so a cached scene pass still points at the right data
+    auto uniformOffset = frame.drawUniformOffsets[i];
+    vkCmdBindDescriptorSets(
+      cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &frame.descriptorSet, 1, &uniformOffset );
+
+    const auto& mesh = m_geometry.mesh( m_sceneDraws[i].mesh );
+    if ( boundLayout != mesh.layout )
+    {
+      vkCmdBindPipeline(
+        cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_scenePipelines[static_cast<size_t>( mesh.layout )] );
+      boundLayout = mesh.layout;
+    }
+    if ( boundPage != mesh.page )
+    {
+      m_geometry.bind( cmd, mesh.page );
+      boundPage = mesh.page;
+    }
+    vkCmdDrawIndexed( cmd, mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, 0 );
+  }
+}
+
+void VulkanBase::recordSceneChunk( FrameContext& frame,
+                                   size_t chunk,
+                                   size_t firstDraw,
+                                   size_t drawCount,
+                                   VkFormat depthFormat )
+{
+  PROFILE_FUNCTION();
+  // the chunk index picks the pool, so a pool is never used by two threads at once
+  vkResetCommandPool( m_device, frame.workerPools[chunk], 0 );
+
+  VkCommandBufferInheritanceRenderingInfo renderingInheritance{};
+  renderingInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+  renderingInheritance.colorAttachmentCount = 1;
+  renderingInheritance.pColorAttachmentFormats = &m_swapChainImageFormat;
+  renderingInheritance.depthAttachmentFormat = depthFormat;
+  renderingInheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkCommandBufferInheritanceInfo inheritance{};
+  inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance.pNext = &renderingInheritance;
+
+  // no ONE_TIME_SUBMIT, a cached scene pass is replayed until it gets invalidated
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritance;
+
+  auto cmd = frame.workerCommandBuffers[chunk];
+  vkBeginCommandBuffer( cmd, &beginInfo );
+  recordScenePass( cmd, frame, firstDraw, drawCount );
+  vkEndCommandBuffer( cmd );
+}
+
+auto VulkanBase::recordSceneSecondaries( FrameContext& frame, size_t maxChunks ) -> std::vector<std::future<void>>
+{
+  // below this a chunk costs more in pool resets and vkCmdExecuteCommands than it saves
+  constexpr size_t minDrawsPerChunk = 64;
+
+  auto drawCount = m_sceneDraws.size();
+  auto chunks = std::clamp<size_t>( ( drawCount + minDrawsPerChunk - 1 ) / minDrawsPerChunk, 1, maxChunks );
+  auto drawsPerChunk = ( drawCount + chunks - 1 ) / chunks;
+  auto depthFormat = findDepthFormat();
+
+  frame.sceneChunks = static_cast<uint32_t>( chunks );
+  m_sceneRecordCount++;
+
+  std::vector<std::future<void>> tasks;
+  if ( chunks == 1 )
+  {
+    recordSceneChunk( frame, 0, 0, drawCount, depthFormat );
+    return tasks;
+  }
+
+  for ( size_t chunk = 0; chunk < chunks; chunk++ )
+  {
+    auto firstDraw = std::min( chunk * drawsPerChunk, drawCount );
+    auto chunkDraws = std::min( drawsPerChunk, drawCount - firstDraw );
+
+    tasks.push_back( m_workers.submit( [this, &frame, chunk, firstDraw, chunkDraws, depthFormat]() {
+      recordSceneChunk( frame, chunk, firstDraw, chunkDraws, depthFormat );
+    } ) );
+  }
+  return tasks;
+}
+
+void VulkanBase::setFrameUniformBytes( VkDeviceSize bytes )
+{
+  m_frameUniformBytes = bytes;
+}
+
+void VulkanBase::setFixedTimestep( float seconds )
+{
+  m_fixedTimestep = seconds;
+}
 
-  for ( size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++ )
+auto VulkanBase::lastRecordMs() const -> double
+{
+  return m_recordMs.last();
+}
+
+auto VulkanBase::gpuProfiler() const -> const GpuProfiler&
+{
+  return m_gpuProfiler;
+}
+
+auto VulkanBase::deviceName() const -> const char*
+{
+  return m_physicalDeviceProps.deviceName;
+}
+
+void VulkanBase::invalidateScenePass()
+{
+  m_sceneGeneration++;
+}
+
+void VulkanBase::setSceneDraws( std::vector<DrawCommand> draws )
+{
+  m_sceneDraws = std::move( draws );
+
+  m_scenePages.clear();
+  for ( const auto& draw : m_sceneDraws )
+  {
+    m_scenePages.push_back( m_geometry.mesh( draw.mesh ).page );
+  }
+  std::sort( m_scenePages.begin(), m_scenePages.end() );
+  m_scenePages.erase( std::unique( m_scenePages.begin(), m_scenePages.end() ), m_scenePages.end() );
+
+  invalidateScenePass();
+}
+
+auto VulkanBase::sceneMesh( VertexLayout layout ) const -> MeshHandle
+{
+  return m_sceneMeshes[static_cast<size_t>( layout )];
+}
+
+void VulkanBase::buildImgui()
+{
+  imguiBegin();
+  ImGui::Begin( "Viewport" );
+  // a resize replaces the viewport image, the set pointing at it is made again on the next frame
+  if ( m_viewportTexture == VK_NULL_HANDLE )
   {
-    createBuffer( bufferSize,
-                  VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                  m_uniformBuffers[i],
-                  m_uniformBuffersMemory[i] );
+    m_viewportTexture =
+      ImGui_ImplVulkan_AddTexture( m_textureSampler, m_viewport.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL );
+  }
+  ImVec2 viewportPanelSize = ImGui::GetContentRegionAvail();
+  ImGui::Image( m_viewportTexture, ImVec2{ viewportPanelSize.x, viewportPanelSize.y } );
 
-    vkMapMemory( m_device, m_uniformBuffersMemory[i], 0, bufferSize, 0, &m_uniformBuffersMapped[i] );
+  ImGui::End();
+  ImGui::Begin( "Test2" );
+  ImGui::Text( "Test window 2" );
+  int framesInFlight = static_cast<int>( m_requestedFramesInFlight );
+  if ( ImGui::SliderInt( "Frames in flight", &framesInFlight, 1, MAX_FRAMES_IN_FLIGHT ) )
+  {
+    setFramesInFlight( static_cast<uint32_t>( framesInFlight ) );
+  }
+
+  bool lowLatency = m_latencyMode == LatencyMode::LowLatency;
+  bool capQueuedFrames = m_capQueuedFrames;
+  bool latencyChanged = ImGui::Checkbox( "Low latency", &lowLatency );
+  latencyChanged |= ImGui::Checkbox( "Cap queued frames to 1", &capQueuedFrames );
+  if ( latencyChanged )
+  {
+    setLatencyMode( lowLatency ? LatencyMode::LowLatency : LatencyMode::Throughput, capQueuedFrames );
+  }
+  ImGui::Text( "Input to submit: avg %.2f ms, p99 %.2f ms",
+               m_inputToSubmitMs.average(),
+               m_inputToSubmitMs.percentile( 99.0 ) );
+
+  bool parallelRecording = m_recordingMode == RecordingMode::Parallel;
+  if ( ImGui::Checkbox( "Parallel recording", &parallelRecording ) )
+  {
+    m_recordingMode = parallelRecording ? RecordingMode::Parallel : RecordingMode::Serial;
+    m_recordMs.clear();
+    invalidateScenePass();
+  }
+  if ( ImGui::Checkbox( "Cache scene pass", &m_cacheScenePass ) )
+  {
+    m_recordMs.clear();
+    invalidateScenePass();
+  }
+  ImGui::Text( "Record: avg %.3f ms, %zu draws, %zu workers",
+               m_recordMs.average(),
+               m_sceneDraws.size(),
+               m_workers.size() );
+  ImGui::Text( "Scene pass recorded %llu times", static_cast<unsigned long long>( m_sceneRecordCount ) );
+  auto barriers = m_barriers.stats();
+  auto frames = static_cast<double>( std::max<uint64_t>( m_frameNumber, 1u ) );
+  ImGui::Text( "Barriers: %.1f in %.1f batches per frame, %llu uses elided",
+               barriers.barriers / frames,
+               barriers.batches / frames,
+               static_cast<unsigned long long>( barriers.elided ) );
+  ImGui::Text( "Swapchain: recreated %u times, %zu deletions pending",
+               m_swapchainRecreations,
+               m_deletionQueue.pending() );
+  auto graph = m_renderGraph.stats();
+  ImGui::Text( "Graph: %u passes, %u culled, %u transient images in %.1f of %.1f MB",
+               graph.passCount,
+               graph.culledCount,
+               graph.transientCount,
+               graph.allocatedBytes / ( 1024.0 * 1024.0 ),
+               graph.transientBytes / ( 1024.0 * 1024.0 ) );
+  ImGui::Text( "Uniforms: %llu of %llu bytes this frame",
+               static_cast<unsigned long long>( m_uniformBytesUsed ),
+               static_cast<unsigned long long>( m_frames[m_currentFrame].uniformAllocator.capacity() ) );
+
+#ifdef ENABLE_CPU_PROFILER
+  bool cpuZones = CpuProfiler::enabled();
+  if ( ImGui::Checkbox( "CPU zones (F12 writes cpu_trace.json)", &cpuZones ) )
+  {
+    CpuProfiler::setEnabled( cpuZones );
+  }
+#endif
+
+  auto memory = m_allocator.stats();
+  ImGui::Text( "Placement: %s", m_allocator.placement().describe() );
+  ImGui::Text( "GPU memory: %.1f of %.1f MB in %u blocks, %u dedicated",
+               memory.usedBytes / ( 1024.0 * 1024.0 ),
+               memory.reservedBytes / ( 1024.0 * 1024.0 ),
+               memory.blockCount,
+               memory.dedicatedCount );
+  ImGui::Text( "%u allocations, %.0f%% fragmented", memory.allocationCount, memory.fragmentation * 100.0 );
+  ImGui::Text( "Uploads: %llu on the %s queue, %u batches in flight",
+               static_cast<unsigned long long>( m_uploads.totalUploads() ),
+               m_uploads.dedicatedTransferQueue() ? "transfer" : "graphics",
+               m_uploads.batchesInFlight() );
+  auto staging = m_uploads.stagingStats();
+  ImGui::Text( "Staging: %.1f of %.1f MB in use, %.1f MB total, %.0f MB/s",
+               staging.inUse / ( 1024.0 * 1024.0 ),
+               staging.capacity / ( 1024.0 * 1024.0 ),
+               staging.totalBytes / ( 1024.0 * 1024.0 ),
+               staging.mbPerSecond );
+  // the workers may still be reading the draw list, drawFrame switches it once this frame is recorded
+  ImGui::Checkbox( "Compact vertices", &m_compactVertices );
+  auto geometry = m_geometry.stats();
+  ImGui::Text( "Geometry: %u meshes in %u pages, %.2f of %.1f MB vertices, %.2f of %.1f MB indices",
+               geometry.meshCount,
+               geometry.pageCount,
+               geometry.vertexBytes / ( 1024.0 * 1024.0 ),
+               geometry.vertexCapacity / ( 1024.0 * 1024.0 ),
+               geometry.indexBytes / ( 1024.0 * 1024.0 ),
+               geometry.indexCapacity / ( 1024.0 * 1024.0 ) );
+  auto texture = m_textures.info( m_sceneTexture );
+  auto textures = m_textures.stats();
+  const char* textureFormat = texture.format == VK_FORMAT_R8G8B8A8_SRGB ? "rgba8" : "block compressed";
+  ImGui::Text( "Texture: %u of %u mip levels, %s, anisotropic filtering %s",
+               texture.mipLevels - texture.baseLevel,
+               texture.mipLevels,
+               texture.state == TextureState::Resident ? textureFormat : "placeholder",
+               m_samplerAnisotropy ? "on" : "unsupported" );
+  if ( m_bindless )
+  {
+    auto table = m_bindlessTable.stats();
+    ImGui::Text( "Descriptors: bindless, %u of %u texture slots, %u of %u buffer slots",
+                 table.textureCount,
+                 table.textureCapacity,
+                 table.bufferCount,
+                 table.bufferCapacity );
   }
+  else
+  {
+    ImGui::Text( "Descriptors: one texture per frame slot set" );
+  }
+  ImGui::Text( "Textures: %u of %u resident, %u loading, %u failed, %.2f ms decode",
+               textures.residentCount,
+               textures.textureCount,
+               textures.loadingCount,
+               textures.failedCount,
+               textures.decodeMs );
+  ImGui::Text( "Streaming: %.1f of %.0f MB, %llu mip uploads, %llu drops",
+               textures.streamedBytes / ( 1024.0 * 1024.0 ),
+               textures.streamingBudget / ( 1024.0 * 1024.0 ),
+               static_cast<unsigned long long>( textures.mipUploads ),
+               static_cast<unsigned long long>( textures.mipDrops ) );
+  if ( ImGui::SliderInt( "Texture budget", &m_textureBudgetMb, 1, 1024, "%d MB" ) )
+  {
+    m_textures.setStreamingBudget( static_cast<VkDeviceSize>( m_textureBudgetMb ) * 1024 * 1024 );
+  }
+
+  ImGui::SeparatorText( "Residency" );
+  const auto& properties = m_allocator.memoryProperties();
+  const auto& budgets = m_residency.budgets();
+  for ( uint32_t heap = 0; heap < budgets.size(); heap++ )
+  {
+    ImGui::Text( "Heap %u (%s): %.1f of %.1f MB budget, %.1f MB heap",
+                 heap,
+                 budgets[heap].deviceLocal ? "device" : "host",
+                 budgets[heap].usage / ( 1024.0 * 1024.0 ),
+                 budgets[heap].budget / ( 1024.0 * 1024.0 ),
+                 properties.memoryHeaps[heap].size / ( 1024.0 * 1024.0 ) );
+  }
+  auto residency = m_residency.stats();
+  ImGui::Text( "%s budget, %u resident, %u evicted, %llu evictions, %llu reloads, %u demoted",
+               residency.driverBudget ? "Driver" : "Estimated",
+               residency.residentCount,
+               residency.evictedCount,
+               static_cast<unsigned long long>( residency.evictions ),
+               static_cast<unsigned long long>( residency.reloads ),
+               memory.demotionCount );
+  if ( ImGui::SliderFloat( "Evict above", &m_residencyHighWatermark, 0.1f, 1.0f, "%.2f of budget" ) )
+  {
+    setResidencyWatermarks( m_residencyHighWatermark, m_residencyHighWatermark - 0.1f );
+  }
+
+  if ( m_gpuProfiler.enabled() )
+  {
+    ImGui::SeparatorText( "GPU" );
+    for ( const auto& scope : m_gpuProfiler.scopes() )
+    {
+      ImGui::Text( "%s: min %.3f ms, avg %.3f ms, p99 %.3f ms",
+                   scope.name.c_str(),
+                   scope.ms.min(),
+                   scope.ms.average(),
+                   scope.ms.percentile( 99.0 ) );
+    }
+    if ( ImGui::Button( "Dump GPU timings" ) )
+    {
+      if ( m_gpuProfiler.dumpCsv( "gpu_timings.csv" ) )
+        spdlog::info( "wrote gpu_timings.csv" );
+      else
+        spdlog::warn( "could not write gpu_timings.csv" );
+    }
+  }
+  else
+  {
+    ImGui::Text( "GPU timestamps are not supported on the graphics queue" );
+  }
+  ImGui::End();
+
+  ImGui::Render();
 }
 
-void VulkanBase::recordCommandBuffer( VkCommandBuffer& cmd, uint32_t imageIndex )
+void VulkanBase::recordCommandBuffer( FrameContext& frame, uint32_t imageIndex )
 {
+  PROFILE_FUNCTION();
+  auto recordStart = std::chrono::steady_clock::now();
+
+  // the ui can switch modes, stick to the one we started this frame with
+  auto recordingMode = m_recordingMode;
+  auto sceneInSecondaries = recordingMode == RecordingMode::Parallel || m_cacheScenePass;
+
+  // the scene goes to the workers while this thread builds the imgui frame, imgui itself is not thread safe, a cached
+  // scene pass is only recorded again once something invalidated it
+  std::vector<std::future<void>> sceneTasks;
+  if ( sceneInSecondaries && ( !m_cacheScenePass || frame.sceneGeneration != m_sceneGeneration ) )
+  {
+    auto maxChunks = recordingMode == RecordingMode::Parallel ? frame.workerCommandBuffers.size() : 1;
+    sceneTasks = recordSceneSecondaries( frame, maxChunks );
+    frame.sceneGeneration = m_sceneGeneration;
+  }
+
+  if ( !m_headless )
+  {
+    buildImgui();
+  }
+
+  auto& cmd = frame.commandBuffer;
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
   vkBeginCommandBuffer( cmd, &beginInfo );
 
-  VkImageMemoryBarrier textureToColor = {};
-  textureToColor.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  textureToColor.srcAccessMask = 0;
-  textureToColor.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-  textureToColor.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  textureToColor.subresourceRange.levelCount = 1;
-  textureToColor.subresourceRange.layerCount = 1;
-
-  textureToColor.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  textureToColor.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-  textureToColor.image = m_viewport.image;
-
-  VkImageMemoryBarrier depthBarrier = {};
-  depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  depthBarrier.srcAccessMask = 0;
-  depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-  depthBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-  depthBarrier.subresourceRange.levelCount = 1;
-  depthBarrier.subresourceRange.layerCount = 1;
-
-  depthBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
-  depthBarrier.image = m_depthImage;
-
-  vkCmdPipelineBarrier( cmd,
-                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                        0,
-                        0,
-                        nullptr,
-                        0,
-                        nullptr,
-                        1,
-                        &textureToColor );
-
-  vkCmdPipelineBarrier( cmd,
-                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-                        0,
-                        0,
-                        nullptr,
-                        0,
-                        nullptr,
-                        1,
-                        &depthBarrier );
+  m_gpuProfiler.beginFrame( cmd, m_currentFrame );
+  auto frameScope = m_gpuProfiler.beginScope( cmd, "frame" );
+
+  // declared again every frame, only the swapchain image changes so the transient depth image stays the same
+  m_renderGraph.begin();
+  auto viewport = m_renderGraph.importImage( "viewport", m_viewport.image, m_viewport.imageView );
+  auto depth = m_renderGraph.createImage(
+    "depth",
+    { findDepthFormat(), m_swapChainExtent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT } );
+
+  // both attachments are cleared
+  m_renderGraph.addPass(
+    { "scene",
+      { { viewport, ImageUse::ColorAttachment, true }, { depth, ImageUse::DepthAttachment, true } },
+      [&]( VkCommandBuffer passCmd ) {
+        recordViewportPass( passCmd, frame, m_renderGraph.view( depth ), sceneInSecondaries, sceneTasks );
+      } } );
+
+  // headless has nothing to present, the frame ends with the viewport image ready to be read
+  if ( m_headless )
+  {
+    m_renderGraph.output( viewport, ImageUse::FragmentShaderRead );
+  }
+  else
+  {
+    // the swapchain image comes with undefined contents once the acquire semaphore waited on at color output signals
+    auto swapchain = m_renderGraph.importImage( "swapchain",
+                                                m_swapChainImages[imageIndex],
+                                                m_swapChainImageViews[imageIndex],
+                                                VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT );
+    m_renderGraph.addPass(
+      { "imgui",
+        { { viewport, ImageUse::FragmentShaderRead }, { swapchain, ImageUse::ColorAttachment, true } },
+        [this, imageIndex]( VkCommandBuffer passCmd ) { recordPresentPass( passCmd, imageIndex ); } } );
+    m_renderGraph.output( swapchain, ImageUse::Present );
+  }
+
+  m_renderGraph.compile();
+  m_renderGraph.execute( cmd );
 
+  m_gpuProfiler.endScope( cmd, frameScope );
+  vkEndCommandBuffer( cmd );
+
+  auto recordTime = std::chrono::steady_clock::now() - recordStart;
+  m_recordMs.push( std::chrono::duration<double, std::milli>( recordTime ).count() );
+}
+
+void VulkanBase::recordViewportPass( VkCommandBuffer cmd,
+                                     FrameContext& frame,
+                                     VkImageView depthView,
+                                     bool sceneInSecondaries,
+                                     std::vector<std::future<void>>& sceneTasks )
+{
   VkRenderingAttachmentInfo depthAttachment{ .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
-                                             .imageView = m_depthView,
+                                             .imageView = depthView,
                                              .imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
                                              .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
                                              .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
@@ -139,90 +633,32 @@ void VulkanBase::recordCommandBuffer( VkCommandBuffer& cmd, uint32_t imageIndex
   renderingInfo.colorAttachmentCount = 1;
   renderingInfo.pColorAttachments = &colorAttachment;
   renderingInfo.pDepthAttachment = &depthAttachment;
+  if ( sceneInSecondaries )
+  {
+    renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+  }
 
+  auto sceneScope = m_gpuProfiler.beginScope( cmd, "scene" );
   vkCmdBeginRendering( cmd, &renderingInfo );
 
-  vkCmdBindPipeline( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline );
-
-  VkViewport viewport{ 0, 0, (float)m_swapChainExtent.width, (float)m_swapChainExtent.height, 0.0f, 1.0f };
-  vkCmdSetViewport( cmd, 0, 1, &viewport );
-
-  VkRect2D scissor{ { 0, 0 }, m_swapChainExtent };
-  vkCmdSetScissor( cmd, 0, 1, &scissor );
-
-  VkBuffer vertexBuffers[] = { m_vertexBuffer };
-  VkDeviceSize offsets[] = { 0 };
-
-  vkCmdBindVertexBuffers( cmd, 0, 1, vertexBuffers, offsets );
-  vkCmdBindIndexBuffer( cmd, m_indicesBuffer, 0, VK_INDEX_TYPE_UINT16 );
-  vkCmdBindDescriptorSets(
-    cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[imageIndex], 0, nullptr );
-
-  vkCmdDrawIndexed( cmd, static_cast<uint32_t>( indices.size() ), 1, 0, 0, 0 );
+  if ( sceneInSecondaries )
+  {
+    WorkerPool::waitAll( sceneTasks );
+    vkCmdExecuteCommands( cmd, frame.sceneChunks, frame.workerCommandBuffers.data() );
+  }
+  else
+  {
+    recordScenePass( cmd, frame, 0, m_sceneDraws.size() );
+  }
 
   vkCmdEndRendering( cmd );
+  m_gpuProfiler.endScope( cmd, sceneScope );
+}
 
-  VkImageMemoryBarrier textureToShader = {};
-  textureToShader.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  textureToShader.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-  textureToShader.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  textureToShader.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  textureToShader.subresourceRange.baseMipLevel = 0;
-  textureToShader.subresourceRange.levelCount = 1;
-  textureToShader.subresourceRange.baseArrayLayer = 0;
-  textureToShader.subresourceRange.layerCount = 1;
-
-  textureToShader.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-  textureToShader.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  textureToShader.image = m_viewport.image;
-
-  // Fix the pipeline stages too!
-  vkCmdPipelineBarrier( cmd,
-                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                        0,
-                        0,
-                        nullptr,
-                        0,
-                        nullptr,
-                        1,
-                        &textureToShader );
-  vkCmdPipelineBarrier( cmd,
-                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                        0,
-                        0,
-                        nullptr,
-                        0,
-                        nullptr,
-                        1,
-                        &textureToShader );
-
-  VkImageMemoryBarrier swapchainToColor = {};
-  swapchainToColor.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  swapchainToColor.srcAccessMask = 0;
-  swapchainToColor.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-  swapchainToColor.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  swapchainToColor.subresourceRange.baseMipLevel = 0;
-  swapchainToColor.subresourceRange.levelCount = 1;
-  swapchainToColor.subresourceRange.baseArrayLayer = 0;
-  swapchainToColor.subresourceRange.layerCount = 1;
-  swapchainToColor.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  swapchainToColor.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-  swapchainToColor.image = m_swapChainImages[imageIndex];
-
-  vkCmdPipelineBarrier( cmd,
-                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                        0,
-                        0,
-                        nullptr,
-                        0,
-                        nullptr,
-                        1,
-                        &swapchainToColor );
-
+void VulkanBase::recordPresentPass( VkCommandBuffer cmd, uint32_t imageIndex )
+{
   VkRenderingAttachmentInfo imguiColorAttachment{};
+  imguiColorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
   imguiColorAttachment.imageView = m_swapChainImageViews[imageIndex];
   imguiColorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
@@ -234,81 +670,67 @@ void VulkanBase::recordCommandBuffer( VkCommandBuffer& cmd, uint32_t imageIndex
   imguiRenderingInfo.pColorAttachments = &imguiColorAttachment;
   imguiRenderingInfo.pDepthAttachment = nullptr;
 
+  auto imguiScope = m_gpuProfiler.beginScope( cmd, "imgui" );
   vkCmdBeginRendering( cmd, &imguiRenderingInfo );
-  imguiBegin();
-  ImGui::Begin( "Viewport" );
-  static auto viewportDescriptorSet =
-    ImGui_ImplVulkan_AddTexture( m_textureSampler, m_viewport.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL );
-  ImVec2 viewportPanelSize = ImGui::GetContentRegionAvail();
-  ImGui::Image( viewportDescriptorSet, ImVec2{ viewportPanelSize.x, viewportPanelSize.y } );
-
-  ImGui::End();
-  ImGui::Begin( "Test2" );
-  ImGui::Text( "Test window 2" );
-  ImGui::End();
-
-  ImGui::Render();
-
   ImGui_ImplVulkan_RenderDrawData( ImGui::GetDrawData(), cmd );
   vkCmdEndRendering( cmd );
-  VkImageMemoryBarrier swapchainToPresent{};
-  swapchainToPresent.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  swapchainToPresent.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-  swapchainToPresent.dstAccessMask = 0;
-  swapchainToPresent.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  swapchainToPresent.subresourceRange.baseMipLevel = 0;
-  swapchainToPresent.subresourceRange.levelCount = 1;
-  swapchainToPresent.subresourceRange.baseArrayLayer = 0;
-  swapchainToPresent.subresourceRange.layerCount = 1;
-
-  swapchainToPresent.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-  swapchainToPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-  swapchainToPresent.image = m_swapChainImages[imageIndex];
-
-  vkCmdPipelineBarrier( cmd,
-                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // src: after color attachment
-                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,          // dst: before present
-                        0,
-                        0,
-                        nullptr,
-                        0,
-                        nullptr,
-                        1,
-                        &swapchainToPresent );
-  vkCmdPipelineBarrier( cmd,
-                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                        0,
-                        0,
-                        nullptr,
-                        0,
-                        nullptr,
-                        1,
-                        &swapchainToPresent );
-
-  vkEndCommandBuffer( cmd );
+  m_gpuProfiler.endScope( cmd, imguiScope );
 }
 
 void VulkanBase::createCommandBuffer()
 {
-  m_commandBuffers.resize( MAX_FRAMES_IN_FLIGHT );
-  for ( auto i = 0u; i < MAX_FRAMES_IN_FLIGHT; i++ )
+  QueueFamilyIndices queueFamilyIndices = findQueueFamilies( m_physicalDevice );
+
+  // the pools are reset as a whole once the frame slot retires, no per buffer reset needed
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+  for ( auto& frame : m_frames )
   {
+    if ( vkCreateCommandPool( m_device, &poolInfo, nullptr, &frame.commandPool ) != VK_SUCCESS )
+    {
+      throw std::runtime_error( "failed to create command pool!" );
+    }
+
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = m_commandPool;
+    allocInfo.commandPool = frame.commandPool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     allocInfo.commandBufferCount = 1;
 
-    if ( vkAllocateCommandBuffers( m_device, &allocInfo, &m_commandBuffers.at( i ) ) != VK_SUCCESS )
+    if ( vkAllocateCommandBuffers( m_device, &allocInfo, &frame.commandBuffer ) != VK_SUCCESS )
     {
       throw std::runtime_error( "failed to allocate command buffers!" );
     }
+
+    frame.workerPools.resize( m_workers.size() );
+    frame.workerCommandBuffers.resize( m_workers.size() );
+    for ( auto i = 0u; i < m_workers.size(); i++ )
+    {
+      if ( vkCreateCommandPool( m_device, &poolInfo, nullptr, &frame.workerPools.at( i ) ) != VK_SUCCESS )
+      {
+        throw std::runtime_error( "failed to create command pool!" );
+      }
+
+      VkCommandBufferAllocateInfo secondaryInfo{};
+      secondaryInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      secondaryInfo.commandPool = frame.workerPools.at( i );
+      secondaryInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      secondaryInfo.commandBufferCount = 1;
+
+      if ( vkAllocateCommandBuffers( m_device, &secondaryInfo, &frame.workerCommandBuffers.at( i ) ) != VK_SUCCESS )
+      {
+        throw std::runtime_error( "failed to allocate command buffers!" );
+      }
+    }
   }
 }
 
 void VulkanBase::createCommandPool()
 {
+  PROFILE_FUNCTION();
   QueueFamilyIndices queueFamilyIndices = findQueueFamilies( m_physicalDevice );
 
   VkCommandPoolCreateInfo poolInfo{};
@@ -338,29 +760,20 @@ static auto readFile( const std::string& filePath ) -> std::vector<char>
   return buffer;
 }
 
-void VulkanBase::copyBuffer( VkBuffer src, VkBuffer dst, VkDeviceSize size )
-{
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-  VkBufferCopy copyRegion{};
-  copyRegion.size = size;
-  vkCmdCopyBuffer( commandBuffer, src, dst, 1, &copyRegion );
-
-  endSingleTimeCommands( commandBuffer );
-}
-
 void VulkanBase::createViewport()
 {
+  PROFILE_FUNCTION();
   createImage( m_swapChainExtent.width,
                m_swapChainExtent.height,
                m_swapChainImageFormat,
                VK_IMAGE_TILING_OPTIMAL,
-               VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+               VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                m_viewport.image,
                m_viewport.memory );
 
   m_viewport.imageView = createImageView( m_viewport.image, m_swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT );
+  m_barriers.track( m_viewport.image, VK_IMAGE_ASPECT_COLOR_BIT );
 }
 
 void VulkanBase::setupDockspace( ImGuiViewport* viewport )
@@ -393,6 +806,7 @@ void VulkanBase::setupDockspace( ImGuiViewport* viewport )
 
 void VulkanBase::imguiBegin()
 {
+  PROFILE_FUNCTION();
   ImGui_ImplVulkan_NewFrame();
   ImGui_ImplSDL2_NewFrame();
   ImGui::NewFrame();
@@ -419,6 +833,7 @@ void VulkanBase::imguiBegin()
 
 void VulkanBase::initImgui()
 {
+  PROFILE_FUNCTION();
   VkDescriptorPoolSize pool_sizes[] = {
     { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, IMGUI_IMPL_VULKAN_MINIMUM_IMAGE_SAMPLER_POOL_SIZE },
   };
@@ -431,6 +846,13 @@ void VulkanBase::initImgui()
   pool_info.poolSizeCount = (uint32_t)IM_COUNTOF( pool_sizes );
   pool_info.pPoolSizes = pool_sizes;
 
+  // imgui's font and textures, the viewport texture among them, stay out of the pool the frame slots are sized for,
+  // resizes retire viewport textures through the deletion queue while already adding the next one
+  if ( vkCreateDescriptorPool( m_device, &pool_info, nullptr, &m_imguiPool ) != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to create imgui descriptor pool!" );
+  }
+
   IMGUI_CHECKVERSION();
   ImGui::CreateContext();
   ImGuiIO& io = ImGui::GetIO();
@@ -448,9 +870,10 @@ void VulkanBase::initImgui()
   init_info.Device = m_device;
   init_info.QueueFamily = queue.graphicsFamily.value();
   init_info.Queue = m_graphicsQueue;
-  init_info.DescriptorPool = m_descriptorPool;
+  init_info.DescriptorPool = m_imguiPool;
   init_info.MinImageCount = 2;
-  init_info.ImageCount = 2;
+  // imgui rotates its vertex/index buffers over ImageCount, it has to cover every frame slot we can have in flight
+  init_info.ImageCount = MAX_FRAMES_IN_FLIGHT;
   init_info.UseDynamicRendering = true;
   init_info.PipelineInfoMain.PipelineRenderingCreateInfo = { .sType =
                                                                VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO };
@@ -465,107 +888,259 @@ void VulkanBase::initImgui()
 
 void VulkanBase::recreateSwapchain()
 {
+  PROFILE_FUNCTION();
   int width = 0, height = 0;
   SDL_GetWindowSize( window, &width, &height );
   if ( width == 0 || height == 0 )
     return;
 
-  vkDeviceWaitIdle( m_device );
-  cleanSwapchain();
+  // only what depends on the window size is rebuilt, the frames already submitted keep rendering with the old pieces
+  // and those go to the deletion queue until the last of them retires, the old swapchain and its semaphores wait for
+  // the presents as well, see retireSwapchains()
+  auto oldSwapchain = m_swapChain;
+  m_retiredSwapchains.push_back( { m_swapChain,
+                                   std::move( m_swapChainImageViews ),
+                                   std::move( m_renderingFinishedSemaphores ),
+                                   m_framesInFlight } );
+  auto oldViewport = m_viewport;
+  auto oldViewportTexture = m_viewportTexture;
+  m_swapChainImageViews.clear();
+  m_renderingFinishedSemaphores.clear();
+  m_imagesInFlight.clear();
+  m_viewportTexture = VK_NULL_HANDLE;
+
+  for ( auto image : m_swapChainImages )
+  {
+    m_barriers.forget( image );
+  }
+  m_barriers.forget( oldViewport.image );
+
+  m_deletionQueue.push( [=, this]() mutable {
+    if ( oldViewportTexture != VK_NULL_HANDLE )
+    {
+      ImGui_ImplVulkan_RemoveTexture( oldViewportTexture );
+    }
+    vkDestroyImageView( m_device, oldViewport.imageView, nullptr );
+    vkDestroyImage( m_device, oldViewport.image, nullptr );
+    m_allocator.free( oldViewport.memory );
+  } );
 
-  createSwapChain();
+  createSwapChain( oldSwapchain );
   createImageViews();
-  createDepthResources();
-  createTextureImage();
-  createTextureImageView();
-  createTextureSamplers();
+  createPresentSemaphores();
+  createViewport();
 
-  createUniformBuffers();
-  createDescriptorSetLayout();
-  createDescriptorPool();
-  createDescriptorSets();
+  // the depth image follows on the next frame, its description in the render graph changed with the extent, the
+  // recorded scene pass has the old viewport and scissor baked in
+  invalidateScenePass();
+  m_swapchainRecreations++;
+}
 
-  createCommandBuffer();
+void VulkanBase::createSceneGeometry()
+{
+  PROFILE_FUNCTION();
+  m_geometry.init( m_device, m_allocator, m_uploads, m_deletionQueue );
+  m_sceneMeshes[static_cast<size_t>( VertexLayout::Standard )] =
+    addSceneMesh( vertices, indices, VertexLayout::Standard );
+  m_sceneMeshes[static_cast<size_t>( VertexLayout::Compact )] =
+    addSceneMesh( vertices, indices, VertexLayout::Compact );
 }
 
-void VulkanBase::createVertexBuffer()
+auto VulkanBase::addSceneMesh( const std::vector<Vertex>& meshVertices,
+                               const std::vector<uint16_t>& meshIndices,
+                               VertexLayout layout ) -> MeshHandle
 {
-  VkDeviceSize bufferSize = sizeof( vertices[0] ) * vertices.size();
-  createBuffer( bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                m_stageBuffer,
-                m_stageBufferMemory );
+  // new pages are registered for residency by the next frame's updateResidency()
+  if ( layout == VertexLayout::Standard )
+  {
+    return m_geometry.addMesh( meshVertices.data(),
+                               static_cast<uint32_t>( meshVertices.size() ),
+                               layout,
+                               meshIndices.data(),
+                               static_cast<uint32_t>( meshIndices.size() ) );
+  }
+
+  auto compact = quantizeVertices( meshVertices, {} );
+  return m_geometry.addMesh( compact.vertices.data(),
+                             static_cast<uint32_t>( compact.vertices.size() ),
+                             layout,
+                             meshIndices.data(),
+                             static_cast<uint32_t>( meshIndices.size() ),
+                             compact.dequantize );
+}
 
-  void* data;
-  vkMapMemory( m_device, m_stageBufferMemory, 0, bufferSize, 0, &data );
-  memcpy( data, vertices.data(), (size_t)bufferSize );
-  vkUnmapMemory( m_device, m_stageBufferMemory );
+auto VulkanBase::loadSceneTexture( std::string path ) -> TextureHandle
+{
+  return m_textures.load( std::move( path ), true, false );
+}
 
-  createBuffer( bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                m_vertexBuffer,
-                m_vertexBufferMemory );
+auto VulkanBase::textureStats() const -> TextureStats
+{
+  return m_textures.stats();
+}
 
-  copyBuffer( m_stageBuffer, m_vertexBuffer, bufferSize );
+void VulkanBase::registerResidentResources()
+{
+  auto residentMemory = [this]( const GpuAllocation& allocation ) {
+    return ResidentMemory{ allocation.size, m_allocator.heapIndex( allocation ) };
+  };
 
-  vkDestroyBuffer( m_device, m_stageBuffer, nullptr );
-  vkFreeMemory( m_device, m_stageBufferMemory, nullptr );
+  // the texture is usually still decoding here, updateTextures() reports its memory once it is resident, the frame
+  // slots move over to the placeholder and back on their own as the loader's generation changes
+  m_textureResidency = m_residency.add(
+    "texture",
+    residentMemory( m_textures.memory( m_sceneTexture ) ),
+    [this] { m_textures.evict( m_sceneTexture ); },
+    [this, residentMemory] {
+      m_textures.reload( m_sceneTexture );
+      return residentMemory( m_textures.memory( m_sceneTexture ) );
+    } );
+
+  registerGeometryPages();
 }
 
-void VulkanBase::createIndexBuffer()
+void VulkanBase::registerGeometryPages()
 {
-  VkDeviceSize bufferSize = sizeof( indices[0] ) * indices.size();
-
-  createBuffer( bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                m_stageBuffer,
-                m_stageBufferMemory );
+  // both halves of a page come from the same usage and land on the same heap
+  auto pageMemory = [this]( uint32_t page ) {
+    const auto& vertexMemory = m_geometry.vertexMemory( page );
+    return ResidentMemory{ vertexMemory.size + m_geometry.indexMemory( page ).size,
+                           m_allocator.heapIndex( vertexMemory ) };
+  };
 
-  void* data;
-  vkMapMemory( m_device, m_stageBufferMemory, 0, bufferSize, 0, &data );
-  memcpy( data, indices.data(), (size_t)bufferSize );
-  vkUnmapMemory( m_device, m_stageBufferMemory );
+  for ( auto page = static_cast<uint32_t>( m_pageResidency.size() ); page < m_geometry.pageCount(); page++ )
+  {
+    // the recorded scene pass bound the old buffers, a reloaded page has new ones
+    m_pageResidency.push_back( m_residency.add(
+      "geometry page " + std::to_string( page ),
+      pageMemory( page ),
+      [this, page] { m_geometry.evictPage( page ); },
+      [this, page, pageMemory] {
+        m_geometry.reloadPage( page );
+        invalidateScenePass();
+        return pageMemory( page );
+      } ) );
+  }
+}
 
-  createBuffer( bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                m_indicesBuffer,
-                m_indicesBufferMemory );
+void VulkanBase::updateResidency()
+{
+  PROFILE_FUNCTION();
+  registerGeometryPages();
+  m_residency.update( m_frameNumber, m_framesInFlight );
 
-  copyBuffer( m_stageBuffer, m_indicesBuffer, bufferSize );
+  // everything the scene pass binds, evicted ones come back before the uploads of this frame are flushed
+  if ( !m_sceneDraws.empty() )
+  {
+    m_residency.use( m_textureResidency );
+  }
+  for ( auto page : m_scenePages )
+  {
+    m_residency.use( m_pageResidency[page] );
+  }
+}
 
-  vkDestroyBuffer( m_device, m_stageBuffer, nullptr );
-  vkFreeMemory( m_device, m_stageBufferMemory, nullptr );
+void VulkanBase::setResidencyWatermarks( double high, double low )
+{
+  m_residency.setWatermarks( high, low );
 }
 
-void VulkanBase::updateUniformBuffer( uint32_t imageIndex )
+void VulkanBase::updateUniformBuffer( uint32_t frameIndex )
 {
+  PROFILE_FUNCTION();
   static auto startTime = std::chrono::high_resolution_clock::now();
 
   auto currentTime = std::chrono::high_resolution_clock::now();
   float time = std::chrono::duration<float, std::chrono::seconds::period>( currentTime - startTime ).count();
+  if ( m_fixedTimestep )
+  {
+    // the same frame always looks the same, no matter how long it took to get there
+    time = static_cast<float>( m_frameNumber ) * *m_fixedTimestep;
+  }
+  m_frameNumber++;
+
+  auto rotation = glm::rotate( glm::mat4( 1.0f ), time * glm::radians( 90.0f ), glm::vec3( 0.0f, 0.0f, 1.0f ) );
 
   UniformBufferoObject ubo{};
-  ubo.model = glm::rotate( glm::mat4( 1.0f ), time * glm::radians( 90.0f ), glm::vec3( 0.0f, 0.0f, 1.0f ) );
   ubo.view = glm::lookAt( glm::vec3( 3.0f, 3.0f, 3.0f ), glm::vec3( 0.0f, 0.0f, 0.0f ), glm::vec3( 0.0f, 0.0f, 1.0f ) );
   ubo.proj =
     glm::perspective( glm::radians( 65.0f ), m_swapChainExtent.width / (float)m_swapChainExtent.height, 0.1f, 10.0f );
   ubo.proj[1][1] *= -1;
 
-  memcpy( m_uniformBuffersMapped[imageIndex], &ubo, sizeof( ubo ) );
+  // the slot's previous frame retired before we got here, so its whole region can be handed out again
+  auto& frame = m_frames.at( frameIndex );
+  frame.uniformAllocator.reset();
+  frame.drawUniformOffsets.clear();
+
+  // any number of draws fits, a slot that outgrew its buffer gets one at least twice the size before it is written
+  auto alignment = m_physicalDeviceProps.limits.minUniformBufferOffsetAlignment;
+  VkDeviceSize stride = ( sizeof( UniformBufferoObject ) + alignment - 1 ) & ~( alignment - 1 );
+  VkDeviceSize needed = stride * m_sceneDraws.size();
+  if ( needed > frame.uniformAllocator.capacity() )
+  {
+    growFrameUniforms( frame, std::max( needed, frame.uniformAllocator.capacity() * 2 ) );
+  }
+
+  // the only place the scale lives, the vertex shaders read it from the uniforms, the texture spans the whole mesh
+  constexpr float sceneMeshExtent = 3.0f;
+  ubo.meshExtent = sceneMeshExtent;
+  auto viewProj = ubo.proj * ubo.view;
+  float maxScreenPixels = 0.0f;
+
+  for ( size_t i = 0; i < m_sceneDraws.size(); i++ )
+  {
+    auto allocation = frame.uniformAllocator.allocate( sizeof( UniformBufferoObject ) );
+    // the slot was grown to fit every draw, running out anyway means the stride above is wrong
+    if ( !allocation )
+    {
+      throw std::runtime_error( "frame uniform buffer is too small for the scene draws!" );
+    }
+
+    const auto& dequantize = m_geometry.mesh( m_sceneDraws[i].mesh ).dequantize;
+    ubo.model = m_sceneDraws[i].model * rotation;
+
+    // projected size of the mesh's bounding sphere, anything reaching behind the near plane wants full detail
+    auto center = viewProj * ubo.model[3];
+    auto radius = 0.5f * sceneMeshExtent * glm::length( glm::vec3( ubo.model[0] ) );
+    if ( center.w <= radius )
+    {
+      maxScreenPixels = std::numeric_limits<float>::max();
+    }
+    else
+    {
+      // the diameter in ndc covers half as many pixels as it has ndc units
+      auto pixels = radius * std::abs( ubo.proj[1][1] ) / center.w * m_swapChainExtent.height;
+      maxScreenPixels = std::max( maxScreenPixels, pixels );
+    }
+    ubo.dequantizeScale = glm::vec4( dequantize.scale, 0.0f );
+    ubo.dequantizeOffset = glm::vec4( dequantize.offset, 0.0f );
+    // the index lives in the uniforms, a cached scene pass keeps working when a texture moves to another slot
+    ubo.textureIndex = m_bindless ? m_textureSlots.at( m_sceneDraws[i].texture ) : 0;
+    memcpy( allocation->mapped, &ubo, sizeof( ubo ) );
+    frame.drawUniformOffsets.push_back( static_cast<uint32_t>( allocation->offset ) );
+  }
+
+  m_uniformBytesUsed = frame.uniformAllocator.used();
+
+  // lands in the texture loader's next update, a frame late
+  auto texture = m_textures.info( m_sceneTexture );
+  if ( !m_sceneDraws.empty() && texture.state == TextureState::Resident )
+  {
+    m_textures.requestLevel( m_sceneTexture,
+                             mipForScreenSize( texture.width, texture.height, texture.mipLevels, maxScreenPixels ) );
+  }
 }
 
 void VulkanBase::createDescriptorSetLayout()
 {
+  PROFILE_FUNCTION();
   VkDescriptorSetLayoutBinding uboLayoutBinding{};
   uboLayoutBinding.binding = 0;
   uboLayoutBinding.descriptorCount = 1;
-  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
   uboLayoutBinding.pImmutableSamplers = nullptr;
-  uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  // the bindless fragment shader reads the draw's texture index from it
+  uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
   VkDescriptorSetLayoutBinding samplerLayoutBinding{};
   samplerLayoutBinding.binding = 1;
@@ -584,12 +1159,18 @@ void VulkanBase::createDescriptorSetLayout()
   {
     throw std::runtime_error( "failed to create descriptor set layout!" );
   }
+
+  if ( m_bindless )
+  {
+    m_bindlessTable.init( m_device, m_physicalDevice, m_textureSampler );
+  }
 }
 
 void VulkanBase::createDescriptorPool()
 {
+  PROFILE_FUNCTION();
   std::array<VkDescriptorPoolSize, 2> poolSizes{
-    VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MAX_FRAMES_IN_FLIGHT },
+    VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, MAX_FRAMES_IN_FLIGHT },
     VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_FRAMES_IN_FLIGHT * 2 } };
 
   VkDescriptorPoolCreateInfo poolInfo{};
@@ -605,31 +1186,6 @@ void VulkanBase::createDescriptorPool()
   }
 }
 
-void VulkanBase::copyBufferToImage( VkBuffer buffer, VkImage image, uint32_t width, uint32_t height )
-{
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-  VkBufferImageCopy region{};
-  region.bufferOffset = 0;
-  region.bufferRowLength = 0;
-  region.bufferImageHeight = 0;
-  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  region.imageSubresource.mipLevel = 0;
-  region.imageSubresource.baseArrayLayer = 0;
-  region.imageSubresource.layerCount = 1;
-  region.imageOffset = { 0, 0, 0 };
-  region.imageExtent = { width, height, 1 };
-
-  vkCmdCopyBufferToImage( commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region );
-
-  endSingleTimeCommands( commandBuffer );
-}
-
-void VulkanBase::createTextureImageView()
-{
-  m_textureView = createImageView( m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT );
-}
-
 auto VulkanBase::beginSingleTimeCommands() -> VkCommandBuffer
 {
   VkCommandBufferAllocateInfo allocInfo{};
@@ -654,105 +1210,52 @@ void VulkanBase::endSingleTimeCommands( VkCommandBuffer commandBuffer )
 {
   vkEndCommandBuffer( commandBuffer );
 
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffer;
-
-  vkQueueSubmit( m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
-  vkQueueWaitIdle( m_graphicsQueue );
+  // only wait for this submission, frames already queued keep running
+  auto value = m_timeline.submit( m_graphicsQueue, { &commandBuffer, 1 } );
+  m_timeline.wait( value );
 
   vkFreeCommandBuffers( m_device, m_commandPool, 1, &commandBuffer );
 }
 
-void VulkanBase::transitionImageLayout( VkImage image,
-                                        VkFormat format,
-                                        VkImageLayout oldLayout,
-                                        VkImageLayout newLayout )
-{
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-  VkImageMemoryBarrier barrier{};
-  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  barrier.oldLayout = oldLayout;
-  barrier.newLayout = newLayout;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.image = image;
-  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = 1;
-  barrier.subresourceRange.baseArrayLayer = 0;
-  barrier.subresourceRange.layerCount = 1;
-
-  VkPipelineStageFlags sourceStage;
-  VkPipelineStageFlags destinationStage;
-
-  if ( oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL )
-  {
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-    sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-  }
-  else if ( oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL )
-  {
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-  }
-  else
-  {
-    throw std::invalid_argument( "unsupported layout transition!" );
-  }
-
-  vkCmdPipelineBarrier( commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier );
-
-  endSingleTimeCommands( commandBuffer );
-}
-
 void VulkanBase::createDescriptorSets()
 {
-  std::vector<VkDescriptorSetLayout> layouts( MAX_FRAMES_IN_FLIGHT, m_descriptorSetLayout );
-  VkDescriptorSetAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocInfo.descriptorPool = m_descriptorPool;
-  allocInfo.descriptorSetCount = static_cast<uint32_t>( MAX_FRAMES_IN_FLIGHT );
-  allocInfo.pSetLayouts = layouts.data();
-
-  m_descriptorSets.resize( MAX_FRAMES_IN_FLIGHT );
-  if ( vkAllocateDescriptorSets( m_device, &allocInfo, m_descriptorSets.data() ) != VK_SUCCESS )
+  for ( auto& frame : m_frames )
   {
-    throw std::runtime_error( "failed to allocate descriptor sets!" );
-  }
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+    if ( vkAllocateDescriptorSets( m_device, &allocInfo, &frame.descriptorSet ) != VK_SUCCESS )
+    {
+      throw std::runtime_error( "failed to allocate descriptor sets!" );
+    }
 
-  for ( size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++ )
-  {
     VkDescriptorBufferInfo bufferInfo{};
-    bufferInfo.buffer = m_uniformBuffers[i];
+    // the per draw dynamic offset picks the data, the set is only rewritten when the slot's buffer grows
+    bufferInfo.buffer = frame.uniformBuffer;
     bufferInfo.offset = 0;
     bufferInfo.range = sizeof( UniformBufferoObject );
 
     VkDescriptorImageInfo imageInfo{};
     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView = m_textureView;
+    imageInfo.imageView = m_textures.view( m_sceneTexture );
     imageInfo.sampler = m_textureSampler;
+    frame.textureGeneration = m_textures.generation();
 
     std::array<VkWriteDescriptorSet, 2> descriptorWrites{
       VkWriteDescriptorSet{
         .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .dstSet = m_descriptorSets[i],
+        .dstSet = frame.descriptorSet,
         .dstBinding = 0,
         .dstArrayElement = 0,
         .descriptorCount = 1,
-        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
         .pBufferInfo = &bufferInfo,
       },
       VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                            .dstSet = m_descriptorSets[i],
+                            .dstSet = frame.descriptorSet,
                             .dstBinding = 1,
                             .dstArrayElement = 0,
                             .descriptorCount = 1,
@@ -764,36 +1267,123 @@ void VulkanBase::createDescriptorSets()
   }
 }
 
+void VulkanBase::writeTextureDescriptors( FrameContext& frame )
+{
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo.imageView = m_textures.view( m_sceneTexture );
+  imageInfo.sampler = m_textureSampler;
+
+  VkWriteDescriptorSet write{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                              .dstSet = frame.descriptorSet,
+                              .dstBinding = 1,
+                              .dstArrayElement = 0,
+                              .descriptorCount = 1,
+                              .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                              .pImageInfo = &imageInfo };
+  vkUpdateDescriptorSets( m_device, 1, &write, 0, nullptr );
+  frame.textureGeneration = m_textures.generation();
+
+  // secondaries that bound the set are invalid once it is updated, the slot's generation can never match again
+  frame.sceneGeneration = 0;
+}
+
 void VulkanBase::cleanSwapchain()
 {
-  vkDestroyImage( m_device, m_depthImage, nullptr );
-  vkDestroyImageView( m_device, m_depthView, nullptr );
-  vkFreeMemory( m_device, m_depthMemory, nullptr );
+  // everything sized to the window, the transient depth image included
+  m_renderGraph.destroy();
+
+  m_barriers.forget( m_viewport.image );
+  vkDestroyImageView( m_device, m_viewport.imageView, nullptr );
+  vkDestroyImage( m_device, m_viewport.image, nullptr );
+  m_allocator.free( m_viewport.memory );
+
+  for ( auto imageView : m_swapChainImageViews )
+  {
+    vkDestroyImageView( m_device, imageView, nullptr );
+  }
+  for ( auto image : m_swapChainImages )
+  {
+    m_barriers.forget( image );
+  }
+
+  vkDestroySwapchainKHR( m_device, m_swapChain, nullptr );
+}
+
+void VulkanBase::retireSwapchains()
+{
+  // presents on a queue complete in order, every signaled fence at the front is done with its swapchain and semaphore
+  while ( !m_presentFences.empty() && vkGetFenceStatus( m_device, m_presentFences.front().fence ) == VK_SUCCESS )
+  {
+    auto fence = m_presentFences.front().fence;
+    vkResetFences( m_device, 1, &fence );
+    m_freePresentFences.push_back( fence );
+    m_presentFences.pop_front();
+  }
+
+  for ( auto it = m_retiredSwapchains.begin(); it != m_retiredSwapchains.end(); )
+  {
+    bool done;
+    if ( m_swapchainMaintenance1 )
+    {
+      done = std::none_of( m_presentFences.begin(), m_presentFences.end(), [&]( const auto& present ) {
+        return present.swapchain == it->swapchain;
+      } );
+    }
+    else
+    {
+      // the present engine gives no signal, a full ring of frames from the newer swapchains has to be presented
+      // first, and the deletion queue then waits for the newest of them to retire
+      it->framesLeft -= std::min( it->framesLeft, 1u );
+      done = it->framesLeft == 0;
+    }
+
+    if ( !done )
+    {
+      ++it;
+      continue;
+    }
+
+    m_deletionQueue.push( [this, retired = std::move( *it )]() mutable { destroyRetiredSwapchain( retired ); } );
+    it = m_retiredSwapchains.erase( it );
+  }
+}
 
-  vkDestroyImage( m_device, m_textureImage, nullptr );
-  vkDestroyImageView( m_device, m_textureView, nullptr );
-  vkFreeMemory( m_device, m_textureImageMemory, nullptr );
+void VulkanBase::destroyRetiredSwapchain( RetiredSwapchain& retired )
+{
+  for ( auto imageView : retired.imageViews )
+  {
+    vkDestroyImageView( m_device, imageView, nullptr );
+  }
+  vkDestroySwapchainKHR( m_device, retired.swapchain, nullptr );
+  for ( auto semaphore : retired.renderingFinishedSemaphores )
+  {
+    vkDestroySemaphore( m_device, semaphore, nullptr );
+  }
+}
 
-  // destroy uniform buffers
-  for ( auto i = 0u; i < m_uniformBuffers.size(); i++ )
+auto VulkanBase::acquirePresentFence() -> VkFence
+{
+  if ( !m_freePresentFences.empty() )
   {
-    vkDestroyBuffer( m_device, m_uniformBuffers.at( i ), nullptr );
-    vkFreeMemory( m_device, m_uniformBuffersMemory.at( i ), nullptr );
+    auto fence = m_freePresentFences.back();
+    m_freePresentFences.pop_back();
+    return fence;
   }
 
-  vkDestroyDescriptorPool( m_device, m_descriptorPool, nullptr );
-  vkDestroyDescriptorSetLayout( m_device, m_descriptorSetLayout, nullptr );
-
-  for ( auto imageView : m_swapChainImageViews )
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkFence fence;
+  if ( vkCreateFence( m_device, &fenceInfo, nullptr, &fence ) != VK_SUCCESS )
   {
-    vkDestroyImageView( m_device, imageView, nullptr );
+    throw std::runtime_error( "failed to create present fence!" );
   }
-
-  vkDestroySwapchainKHR( m_device, m_swapChain, nullptr );
+  return fence;
 }
 
 void VulkanBase::createSurface()
 {
+  PROFILE_FUNCTION();
   if ( SDL_Vulkan_CreateSurface( window, m_instance, &m_surface ) != SDL_TRUE )
   {
     throw std::runtime_error( "could not create surface" );
@@ -802,36 +1392,50 @@ void VulkanBase::createSurface()
 
 void VulkanBase::createSyncObj()
 {
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  for ( auto& frame : m_frames )
+  {
+    if ( vkCreateSemaphore( m_device, &semaphoreInfo, nullptr, &frame.imageAvailableSemaphore ) != VK_SUCCESS )
+    {
+      throw std::runtime_error( "failed to create sempahores" );
+    }
+    frame.timelineValue = 0;
+  }
+
+  createPresentSemaphores();
+}
+
+void VulkanBase::createPresentSemaphores()
+{
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  // present keeps waiting on the rendering finished semaphore until the image comes back, so these stay tied to the
+  // swapchain image, sharing them per frame slot could re-signal one that is still pending
   auto size = m_swapChainImages.size();
-  m_inFlightFences.resize( size, VK_NULL_HANDLE );
-  m_imagesInFlight.resize( size, VK_NULL_HANDLE );
-  m_imageAvailableSemaphores.resize( size );
-  m_renderingFinishedSemaphores.resize( size );
-  for ( auto i = 0u; i < size; i++ )
-  {
-    VkSemaphoreCreateInfo semaphoreInfo{};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-    if ( vkCreateSemaphore( m_device, &semaphoreInfo, nullptr, &m_imageAvailableSemaphores.at( i ) ) != VK_SUCCESS ||
-         vkCreateSemaphore( m_device, &semaphoreInfo, nullptr, &m_renderingFinishedSemaphores.at( i ) ) != VK_SUCCESS ||
-         vkCreateFence( m_device, &fenceInfo, nullptr, &m_inFlightFences.at( i ) ) != VK_SUCCESS )
+  m_imagesInFlight.resize( size, 0u );
+  while ( m_renderingFinishedSemaphores.size() < size )
+  {
+    VkSemaphore semaphore;
+    if ( vkCreateSemaphore( m_device, &semaphoreInfo, nullptr, &semaphore ) != VK_SUCCESS )
     {
       throw std::runtime_error( "failed to create sempahores" );
     }
+    m_renderingFinishedSemaphores.push_back( semaphore );
   }
 }
 
 void VulkanBase::createLogicalDevice()
 {
+  PROFILE_FUNCTION();
   // get the indices of the phisycal device we picked earlier
   QueueFamilyIndices indices = findQueueFamilies( m_physicalDevice );
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+  std::set<uint32_t> uniqueQueueFamilies = {
+    indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
 
   float queuePriority = 1.0f;
   for ( uint32_t queueFamily : uniqueQueueFamilies )
@@ -845,20 +1449,81 @@ void VulkanBase::createLogicalDevice()
   }
 
   // specify the features
+  VkPhysicalDeviceFeatures supportedFeatures{};
+  vkGetPhysicalDeviceFeatures( m_physicalDevice, &supportedFeatures );
+  m_samplerAnisotropy = supportedFeatures.samplerAnisotropy == VK_TRUE;
+  m_textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+
   VkPhysicalDeviceFeatures deviceFeatures{};
-  VkPhysicalDeviceDynamicRenderingFeatures dynamicRendering{};
-  dynamicRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
-  dynamicRendering.dynamicRendering = VK_TRUE;
+  deviceFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+  deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+  // every barrier is recorded with vkCmdPipelineBarrier2 and every submission goes through vkQueueSubmit2
+  VkPhysicalDeviceVulkan13Features vulkan13Features{};
+  vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+  vulkan13Features.dynamicRendering = VK_TRUE;
+  vulkan13Features.synchronization2 = VK_TRUE;
+
+  VkPhysicalDeviceVulkan12Features vulkan12Features{};
+  vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12Features.pNext = &vulkan13Features;
+  vulkan12Features.timelineSemaphore = VK_TRUE;
+  // the upload manager resets its timestamp queries from the host, the transfer queue cannot
+  vulkan12Features.hostQueryReset = VK_TRUE;
+
+  // descriptor indexing is optional, without it every frame slot's set carries the scene texture as before
+  VkPhysicalDeviceVulkan12Features supported12{};
+  supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  VkPhysicalDeviceFeatures2 supported2{};
+  supported2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  supported2.pNext = &supported12;
+  vkGetPhysicalDeviceFeatures2( m_physicalDevice, &supported2 );
+  m_bindless = BindlessTable::supported( supported12 );
+  if ( m_bindless )
+  {
+    BindlessTable::enableFeatures( vulkan12Features );
+  }
+
+  // present fences tell when a retired swapchain and its semaphores are free, without them retiring takes a full ring
+  VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenance1{};
+  swapchainMaintenance1.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+  if ( m_surfaceMaintenance1 && hasDeviceExtension( m_physicalDevice, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME ) )
+  {
+    VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT supportedMaintenance1{};
+    supportedMaintenance1.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+    supported2.pNext = &supportedMaintenance1;
+    vkGetPhysicalDeviceFeatures2( m_physicalDevice, &supported2 );
+    m_swapchainMaintenance1 = supportedMaintenance1.swapchainMaintenance1 == VK_TRUE;
+  }
+  if ( m_swapchainMaintenance1 )
+  {
+    swapchainMaintenance1.swapchainMaintenance1 = VK_TRUE;
+    vulkan13Features.pNext = &swapchainMaintenance1;
+  }
 
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-  createInfo.pNext = &dynamicRendering;
+  createInfo.pNext = &vulkan12Features;
   createInfo.queueCreateInfoCount = queueCreateInfos.size();
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
   createInfo.pEnabledFeatures = &deviceFeatures;
 
-  createInfo.enabledExtensionCount = 1;
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  // headless never creates a swapchain, dynamic rendering is core, the budget extension is optional
+  std::vector<const char*> extensions;
+  if ( !m_headless )
+  {
+    extensions.push_back( VK_KHR_SWAPCHAIN_EXTENSION_NAME );
+  }
+  bool memoryBudget = hasDeviceExtension( m_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME );
+  if ( memoryBudget )
+  {
+    extensions.push_back( VK_EXT_MEMORY_BUDGET_EXTENSION_NAME );
+  }
+  if ( m_swapchainMaintenance1 )
+  {
+    extensions.push_back( VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME );
+  }
+  createInfo.enabledExtensionCount = static_cast<uint32_t>( extensions.size() );
+  createInfo.ppEnabledExtensionNames = extensions.data();
 
   // enable validation layers
   if ( enableValidationLayers )
@@ -878,10 +1543,40 @@ void VulkanBase::createLogicalDevice()
 
   vkGetDeviceQueue( m_device, indices.graphicsFamily.value(), 0, &m_graphicsQueue );
   vkGetDeviceQueue( m_device, indices.presentFamily.value(), 0, &m_presentQueue );
+  vkGetDeviceQueue( m_device, indices.transferFamily.value(), 0, &m_transferQueue );
+
+  m_timeline.init( m_device );
+  m_allocator.init( m_device, m_physicalDevice );
+  m_deletionQueue.init( m_timeline );
+  m_renderGraph.init( m_device, m_allocator, m_barriers, m_deletionQueue );
+  m_residency.init( m_physicalDevice, m_allocator, memoryBudget );
+  m_allocator.setOutOfMemoryHandler(
+    [this]( uint32_t heapIndex, VkDeviceSize size ) { return m_residency.makeRoom( heapIndex, size ); } );
+
+  // the valid timestamp bits are per queue family, the profiler writes on the graphics queue and the upload manager
+  // times its copies on the transfer queue
+  uint32_t queueFamilyCount{ 0u };
+  vkGetPhysicalDeviceQueueFamilyProperties( m_physicalDevice, &queueFamilyCount, nullptr );
+  std::vector<VkQueueFamilyProperties> queueFamilies( queueFamilyCount );
+  vkGetPhysicalDeviceQueueFamilyProperties( m_physicalDevice, &queueFamilyCount, queueFamilies.data() );
+
+  UploadQueues uploadQueues{ m_graphicsQueue,
+                             indices.graphicsFamily.value(),
+                             m_transferQueue,
+                             indices.transferFamily.value(),
+                             queueFamilies[indices.transferFamily.value()].timestampValidBits,
+                             m_physicalDeviceProps.limits.timestampPeriod };
+  m_uploads.init( m_device, m_allocator, m_timeline, uploadQueues );
+
+  m_gpuProfiler.init( m_device,
+                      m_physicalDeviceProps.limits.timestampPeriod,
+                      queueFamilies[indices.graphicsFamily.value()].timestampValidBits,
+                      MAX_FRAMES_IN_FLIGHT );
 }
 
 void VulkanBase::pickPhysicalDevice()
 {
+  PROFILE_FUNCTION();
   // this should choose the physical device (GPU) we are going to use for the rendering
   uint32_t deviceCount{ 0u };
   vkEnumeratePhysicalDevices( m_instance, &deviceCount, nullptr );
@@ -908,6 +1603,11 @@ void VulkanBase::pickPhysicalDevice()
       break;
     }
   }
+
+  if ( m_physicalDevice == VK_NULL_HANDLE )
+  {
+    throw std::runtime_error( "failed to find a suitable GPU!" );
+  }
 }
 
 bool VulkanBase::isDeviceSuitable( VkPhysicalDevice& device )
@@ -916,7 +1616,26 @@ bool VulkanBase::isDeviceSuitable( VkPhysicalDevice& device )
   vkGetPhysicalDeviceProperties( device, &m_physicalDeviceProps );
   vkGetPhysicalDeviceFeatures( device, &m_physicalDeviceFeatures );
   vkGetPhysicalDeviceMemoryProperties( device, &m_physicalDeviceMemoryProps );
+
+  // frames and uploads are tracked with a timeline semaphore, barriers are recorded with synchronization2
+  VkPhysicalDeviceVulkan13Features vulkan13Features{};
+  vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+  VkPhysicalDeviceVulkan12Features vulkan12Features{};
+  vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12Features.pNext = &vulkan13Features;
+  VkPhysicalDeviceFeatures2 features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features2.pNext = &vulkan12Features;
+  vkGetPhysicalDeviceFeatures2( device, &features2 );
+
   auto indices = findQueueFamilies( device );
+  bool requiredFeatures = vulkan12Features.timelineSemaphore && vulkan12Features.hostQueryReset &&
+                          vulkan13Features.dynamicRendering && vulkan13Features.synchronization2;
+
+  // nothing gets presented and any device type will do, mesa's lavapipe shows up as a cpu device
+  if ( m_headless )
+    return requiredFeatures && indices.isComplete();
+
   auto extensionsSupported = checkDeviceExtensionSupport( device );
 
   // check to see swap chain support
@@ -928,12 +1647,37 @@ bool VulkanBase::isDeviceSuitable( VkPhysicalDevice& device )
   }
 
   if ( m_physicalDeviceProps.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
-       m_physicalDeviceFeatures.geometryShader && indices.isComplete() && extensionsSupported && swapChainAdequate )
+       m_physicalDeviceFeatures.geometryShader && requiredFeatures && indices.isComplete() &&
+       extensionsSupported && swapChainAdequate )
     return true;
 
   return false;
 }
 
+bool VulkanBase::hasDeviceExtension( VkPhysicalDevice& device, const char* name )
+{
+  uint32_t extensionCount{ 0u };
+  vkEnumerateDeviceExtensionProperties( device, nullptr, &extensionCount, nullptr );
+  std::vector<VkExtensionProperties> availableExtensions( extensionCount );
+  vkEnumerateDeviceExtensionProperties( device, nullptr, &extensionCount, availableExtensions.data() );
+
+  return std::any_of( availableExtensions.begin(), availableExtensions.end(), [name]( const auto& extension ) {
+    return std::string_view{ extension.extensionName } == name;
+  } );
+}
+
+bool VulkanBase::hasInstanceExtension( const char* name )
+{
+  uint32_t extensionCount{ 0u };
+  vkEnumerateInstanceExtensionProperties( nullptr, &extensionCount, nullptr );
+  std::vector<VkExtensionProperties> availableExtensions( extensionCount );
+  vkEnumerateInstanceExtensionProperties( nullptr, &extensionCount, availableExtensions.data() );
+
+  return std::any_of( availableExtensions.begin(), availableExtensions.end(), [name]( const auto& extension ) {
+    return std::string_view{ extension.extensionName } == name;
+  } );
+}
+
 bool VulkanBase::checkDeviceExtensionSupport( VkPhysicalDevice& device )
 {
   // get all the extensions of the device
@@ -1015,8 +1759,9 @@ auto VulkanBase::chooseSwapPresentMode( const std::vector<VkPresentModeKHR>& ava
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
-void VulkanBase::createSwapChain()
+void VulkanBase::createSwapChain( VkSwapchainKHR oldSwapchain )
 {
+  PROFILE_FUNCTION();
   SwapChainSupportDetails swapChainSupport = querySwapChainSupport( m_physicalDevice );
   auto surfaceFormat = chooseSwapSurfaceFormat( swapChainSupport.formats );
   auto presentMode = chooseSwapPresentMode( swapChainSupport.presentModes );
@@ -1061,7 +1806,8 @@ void VulkanBase::createSwapChain()
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
 
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  // images the old one already handed out can still be presented, the driver may reuse its resources
+  createInfo.oldSwapchain = oldSwapchain;
 
   if ( vkCreateSwapchainKHR( m_device, &createInfo, nullptr, &m_swapChain ) != VK_SUCCESS )
   {
@@ -1071,6 +1817,10 @@ void VulkanBase::createSwapChain()
   vkGetSwapchainImagesKHR( m_device, m_swapChain, &imageCount, nullptr );
   m_swapChainImages.resize( imageCount );
   vkGetSwapchainImagesKHR( m_device, m_swapChain, &imageCount, m_swapChainImages.data() );
+  for ( auto image : m_swapChainImages )
+  {
+    m_barriers.track( image, VK_IMAGE_ASPECT_COLOR_BIT );
+  }
 
   m_swapChainImageFormat = surfaceFormat.format;
   m_swapChainExtent = extent;
@@ -1078,6 +1828,7 @@ void VulkanBase::createSwapChain()
 
 void VulkanBase::createImageViews()
 {
+  PROFILE_FUNCTION();
   m_swapChainImageViews.resize( m_swapChainImages.size() );
   for ( auto i = 0u; i < m_swapChainImageViews.size(); i++ )
   {
@@ -1086,87 +1837,65 @@ void VulkanBase::createImageViews()
   }
 }
 
-void VulkanBase::createDepthResources()
+void VulkanBase::loadTextures()
 {
-  auto depthFormat = findDepthFormat();
-  VkImageCreateInfo imageInfo{};
-  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-  imageInfo.imageType = VK_IMAGE_TYPE_2D;
-  imageInfo.extent.width = m_swapChainExtent.width;
-  imageInfo.extent.height = m_swapChainExtent.height;
-  imageInfo.extent.depth = 1;
-  imageInfo.mipLevels = 1;
-  imageInfo.arrayLayers = 1;
-  imageInfo.format = depthFormat;
-  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-  createImage( m_swapChainExtent.width,
-               m_swapChainExtent.height,
-               depthFormat,
-               VK_IMAGE_TILING_OPTIMAL,
-               VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-               m_depthImage,
-               m_depthMemory );
+  PROFILE_FUNCTION();
+  m_textures.init( m_device, m_physicalDevice, m_allocator, m_uploads, m_deletionQueue );
 
-  m_depthView = createImageView( m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT );
+  // written by texture_compressor, its mips are already in the file so nothing is filtered at load time
+  const char* compressed = ASSET_ROOT "test.ktx2";
+  bool useCompressed = m_textureCompressionBC && std::filesystem::exists( compressed );
+  m_sceneTexture = m_textures.load( useCompressed ? compressed : ASSET_ROOT "test.jpg", true, true );
 }
 
-void VulkanBase::createTextureImage()
+void VulkanBase::updateTextures( FrameContext& frame )
 {
-#define pic "D:/Github/cpp_playground/test.jpg"
-  int texWidth, texHeight, texChannels;
-  stbi_uc* pixels = stbi_load( pic, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha );
-
-  if ( !pixels )
+  m_textures.update();
+  if ( m_textures.info( m_sceneTexture ).state == TextureState::Resident )
   {
-    spdlog::error( stbi_failure_reason() );
-    throw std::runtime_error( "failed to load texture image!" );
+    const auto& memory = m_textures.memory( m_sceneTexture );
+    m_residency.setMemory( m_textureResidency, { memory.size, m_allocator.heapIndex( memory ) } );
   }
 
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-  createBuffer( imageSize,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                m_stageBuffer,
-                m_stageBufferMemory );
-
-  void* data;
-  vkMapMemory( m_device, m_stageBufferMemory, 0, imageSize, 0, &data );
-  memcpy( data, pixels, static_cast<size_t>( imageSize ) );
-  vkUnmapMemory( m_device, m_stageBufferMemory );
+  if ( m_bindless )
+  {
+    updateBindlessTextures();
+    return;
+  }
 
-  stbi_image_free( pixels );
+  // the slot's last submission retired, its set can be rewritten without waiting on the others
+  if ( frame.textureGeneration != m_textures.generation() )
+  {
+    writeTextureDescriptors( frame );
+  }
+}
 
-  createImage( texWidth,
-               texHeight,
-               VK_FORMAT_R8G8B8A8_SRGB,
-               VK_IMAGE_TILING_OPTIMAL,
-               VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-               m_textureImage,
-               m_textureImageMemory );
+void VulkanBase::updateBindlessTextures()
+{
+  auto count = m_textures.stats().textureCount;
+  m_textureSlots.resize( count, UINT32_MAX );
+  m_slotViews.resize( count, VK_NULL_HANDLE );
 
-  transitionImageLayout(
-    m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL );
-  copyBufferToImage(
-    m_stageBuffer, m_textureImage, static_cast<uint32_t>( texWidth ), static_cast<uint32_t>( texHeight ) );
-  transitionImageLayout( m_textureImage,
-                         VK_FORMAT_R8G8B8A8_SRGB,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL );
+  for ( TextureHandle texture = 0; texture < count; texture++ )
+  {
+    auto view = m_textures.view( texture );
+    if ( view == m_slotViews[texture] )
+      continue;
 
-  vkDestroyBuffer( m_device, m_stageBuffer, nullptr );
-  vkFreeMemory( m_device, m_stageBufferMemory, nullptr );
+    // frames in flight read the old slot, this frame's uniforms already point at the new one
+    auto oldSlot = m_textureSlots[texture];
+    m_textureSlots[texture] = m_bindlessTable.addTexture( view );
+    m_slotViews[texture] = view;
+    if ( oldSlot != UINT32_MAX )
+    {
+      m_deletionQueue.push( [this, oldSlot]() { m_bindlessTable.removeTexture( oldSlot ); } );
+    }
+  }
 }
 
 void VulkanBase::createTextureSamplers()
 {
+  PROFILE_FUNCTION();
   VkPhysicalDeviceProperties properties{};
   vkGetPhysicalDeviceProperties( m_physicalDevice, &properties );
 
@@ -1177,13 +1906,17 @@ void VulkanBase::createTextureSamplers()
   samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
   samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
   samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  samplerInfo.anisotropyEnable = VK_FALSE;
-  samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+  samplerInfo.anisotropyEnable = m_samplerAnisotropy ? VK_TRUE : VK_FALSE;
+  samplerInfo.maxAnisotropy = m_samplerAnisotropy ? properties.limits.maxSamplerAnisotropy : 1.0f;
   samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
   samplerInfo.unnormalizedCoordinates = VK_FALSE;
   samplerInfo.compareEnable = VK_FALSE;
   samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
   samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  // the whole chain of whatever texture ends up bound, the view limits it to the levels it has
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+  samplerInfo.mipLodBias = 0.0f;
 
   if ( vkCreateSampler( m_device, &samplerInfo, nullptr, &m_textureSampler ) != VK_SUCCESS )
   {
@@ -1193,9 +1926,9 @@ void VulkanBase::createTextureSamplers()
 
 void VulkanBase::createBuffer( VkDeviceSize size,
                                VkBufferUsageFlags usage,
-                               VkMemoryPropertyFlags properties,
+                               MemoryUsage memoryUsage,
                                VkBuffer& buffer,
-                               VkDeviceMemory& bufferMemory )
+                               GpuAllocation& bufferMemory )
 {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1208,20 +1941,7 @@ void VulkanBase::createBuffer( VkDeviceSize size,
     throw std::runtime_error( "failed to create buffer!" );
   }
 
-  VkMemoryRequirements memRequirements;
-  vkGetBufferMemoryRequirements( m_device, buffer, &memRequirements );
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType( memRequirements.memoryTypeBits, properties );
-
-  if ( vkAllocateMemory( m_device, &allocInfo, nullptr, &bufferMemory ) != VK_SUCCESS )
-  {
-    throw std::runtime_error( "failed to allocate buffer memory!" );
-  }
-
-  vkBindBufferMemory( m_device, buffer, bufferMemory, 0 );
+  bufferMemory = m_allocator.allocateBuffer( buffer, memoryUsage );
 }
 
 auto VulkanBase::chooseSwapSurfaceFormat( const std::vector<VkSurfaceFormatKHR>& availableFormats )
@@ -1240,14 +1960,42 @@ auto VulkanBase::chooseSwapSurfaceFormat( const std::vector<VkSurfaceFormatKHR>&
 
 void VulkanBase::run()
 {
+  PROFILE_THREAD( "main" );
+
   initVulkan();
-  mainLoop();
+  if ( m_headless )
+    headlessLoop();
+  else
+    mainLoop();
+  cleanup();
 }
 
 void VulkanBase::createGraphicsPipeline()
 {
-  auto vertShaderCode = readFile( "D:/Github/cpp_playground/vert.spv" );
-  auto fragShaderCode = readFile( "D:/Github/cpp_playground/frag.spv" );
+  PROFILE_FUNCTION();
+  // set 0 is per frame slot and rebound per draw for its dynamic offset, set 1 is bound once per pass
+  std::array<VkDescriptorSetLayout, 2> setLayouts{ m_descriptorSetLayout, m_bindlessTable.layout() };
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{ .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                                                 .setLayoutCount = m_bindless ? 2u : 1u,
+                                                 .pSetLayouts = setLayouts.data() };
+
+  if ( vkCreatePipelineLayout( m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout ) != VK_SUCCESS )
+  {
+    throw std::runtime_error( "failed to create pipeline layout!" );
+  }
+
+  for ( uint32_t layout = 0; layout < vertexLayoutCount; layout++ )
+  {
+    m_scenePipelines[layout] = createScenePipeline( static_cast<VertexLayout>( layout ) );
+  }
+}
+
+auto VulkanBase::createScenePipeline( VertexLayout layout ) -> VkPipeline
+{
+  // the layouts only differ in their vertex input and the vertex shader that decodes it
+  const char* vertexShaders[vertexLayoutCount] = { SHADER_ROOT "vert.spv", SHADER_ROOT "vert_compact.spv" };
+  auto vertShaderCode = readFile( vertexShaders[static_cast<size_t>( layout )] );
+  auto fragShaderCode = readFile( m_bindless ? SHADER_ROOT "frag_bindless.spv" : SHADER_ROOT "frag.spv" );
 
   auto vertModule = createShaderModule( vertShaderCode );
   auto fragModule = createShaderModule( fragShaderCode );
@@ -1266,15 +2014,14 @@ void VulkanBase::createGraphicsPipeline()
 
   VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-  auto bindingDesc = Vertex::getBindingDescription();
-  auto attribDesc = Vertex::getAttributeDescriptions();
+  auto vertexInput = vertexInputDescription( layout );
 
   VkPipelineVertexInputStateCreateInfo vertexInputInfo{
     .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
     .vertexBindingDescriptionCount = 1,
-    .pVertexBindingDescriptions = &bindingDesc,
-    .vertexAttributeDescriptionCount = static_cast<uint32_t>( attribDesc.size() ),
-    .pVertexAttributeDescriptions = attribDesc.data(),
+    .pVertexBindingDescriptions = &vertexInput.binding,
+    .vertexAttributeDescriptionCount = static_cast<uint32_t>( vertexInput.attributes.size() ),
+    .pVertexAttributeDescriptions = vertexInput.attributes.data(),
   };
 
   VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -1324,15 +2071,6 @@ void VulkanBase::createGraphicsPipeline()
   dynamicState.dynamicStateCount = static_cast<uint32_t>( dynamicStates.size() );
   dynamicState.pDynamicStates = dynamicStates.data();
 
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo{ .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-                                                 .setLayoutCount = 1,
-                                                 .pSetLayouts = &m_descriptorSetLayout };
-
-  if ( vkCreatePipelineLayout( m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout ) != VK_SUCCESS )
-  {
-    throw std::runtime_error( "failed to create pipeline layout!" );
-  }
-
   VkPipelineRenderingCreateInfo renderingInfo{};
   renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
   renderingInfo.colorAttachmentCount = 1;
@@ -1367,13 +2105,14 @@ void VulkanBase::createGraphicsPipeline()
     .basePipelineHandle = VK_NULL_HANDLE,
   };
 
-  if ( vkCreateGraphicsPipelines( m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline ) !=
-       VK_SUCCESS )
+  VkPipeline pipeline;
+  if ( vkCreateGraphicsPipelines( m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline ) != VK_SUCCESS )
   {
     throw std::runtime_error( "failed to create graphics pipeline!" );
   }
   vkDestroyShaderModule( m_device, vertModule, nullptr );
   vkDestroyShaderModule( m_device, fragModule, nullptr );
+  return pipeline;
 }
 
 auto VulkanBase::createShaderModule( const std::vector<char>& code ) const -> VkShaderModule
@@ -1524,6 +2263,7 @@ void VulkanBase::createImguiPipeline()
 
 void VulkanBase::createInstance()
 {
+  PROFILE_FUNCTION();
   if ( enableValidationLayers && !checkValidationLayerSupport() )
   {
     throw std::runtime_error( "validation layers requested but not available!!!" );
@@ -1573,6 +2313,7 @@ void VulkanBase::createInstance()
 
 void VulkanBase::initWindow()
 {
+  PROFILE_FUNCTION();
   if ( SDL_Init( SDL_INIT_VIDEO | SDL_INIT_EVENTS ) != 0 )
   {
     spdlog::error( "SDL_Init Error: {}", SDL_GetError() );
@@ -1589,13 +2330,55 @@ void VulkanBase::initWindow()
     SDL_CreateWindow( "kogayonon", 100, 100, 800, 800, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_SHOWN );
 }
 
+void VulkanBase::waitForFrame()
+{
+  PROFILE_FUNCTION();
+  if ( m_requestedFramesInFlight != m_framesInFlight )
+  {
+    m_timeline.waitIdle();
+    destroyFrameContexts();
+    m_framesInFlight = m_requestedFramesInFlight;
+    m_currentFrame = 0;
+    createFrameContexts();
+  }
+
+  if ( m_capQueuedFrames )
+  {
+    // everything submitted so far has to retire, the frame we are about to record will be the only one queued
+    m_timeline.waitIdle();
+  }
+  else
+  {
+    m_timeline.wait( m_frames.at( m_currentFrame ).timelineValue );
+  }
+}
+
 void VulkanBase::drawFrame()
 {
-  vkWaitForFences( m_device, 1, &m_inFlightFences.at( m_currentFrame ), VK_TRUE, UINT64_MAX );
+  PROFILE_FUNCTION();
+  // already satisfied when the low latency loop waited before polling input
+  waitForFrame();
+
+  // before the uniforms are sized for the draw list and before anything is recorded with it
+  auto layout = m_compactVertices ? VertexLayout::Compact : VertexLayout::Standard;
+  if ( layout != m_sceneLayout )
+  {
+    m_sceneLayout = layout;
+    setSceneDraws( { DrawCommand{ sceneMesh( layout ) } } );
+  }
+
+  auto& frame = m_frames.at( m_currentFrame );
+  m_deletionQueue.collect();
+
+  // uploads recorded since the last frame go out ahead of it
+  updateResidency();
+  updateTextures( frame );
+  m_uploads.collect();
+  m_uploads.flush();
 
   uint32_t imageIndex;
   auto result = vkAcquireNextImageKHR(
-    m_device, m_swapChain, UINT64_MAX, m_imageAvailableSemaphores.at( m_currentFrame ), VK_NULL_HANDLE, &imageIndex );
+    m_device, m_swapChain, UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex );
 
   if ( result == VK_ERROR_OUT_OF_DATE_KHR )
   {
@@ -1607,28 +2390,25 @@ void VulkanBase::drawFrame()
     throw std::runtime_error( "failed to acquire swap chain image!" );
   }
 
-  vkResetFences( m_device, 1, &m_inFlightFences.at( m_currentFrame ) );
-  updateUniformBuffer( imageIndex );
-  // vkResetCommandBuffer( m_commandBuffers.at( m_currentFrame ), 0 );
-  recordCommandBuffer( m_commandBuffers.at( m_currentFrame ), imageIndex );
+  // with more frame slots than swapchain images an older slot can still be rendering into this image
+  m_timeline.wait( m_imagesInFlight.at( imageIndex ) );
 
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  updateUniformBuffer( m_currentFrame );
+  vkResetCommandPool( m_device, frame.commandPool, 0 );
+  recordCommandBuffer( frame, imageIndex );
 
-  VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = &m_imageAvailableSemaphores.at( m_currentFrame );
-  submitInfo.pWaitDstStageMask = waitStages;
+  SemaphoreWait imageAvailable{ frame.imageAvailableSemaphore, 0, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT };
+  frame.timelineValue = m_timeline.submit( m_graphicsQueue,
+                                           { &frame.commandBuffer, 1 },
+                                           { &imageAvailable, 1 },
+                                           { &m_renderingFinishedSemaphores.at( imageIndex ), 1 } );
+  m_imagesInFlight.at( imageIndex ) = frame.timelineValue;
 
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &m_commandBuffers.at( m_currentFrame );
-
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = &m_renderingFinishedSemaphores.at( imageIndex );
-
-  if ( vkQueueSubmit( m_graphicsQueue, 1, &submitInfo, m_inFlightFences.at( m_currentFrame ) ) != VK_SUCCESS )
+  if ( m_pendingInputTime )
   {
-    throw std::runtime_error( "failed to submit draw command buffer!" );
+    auto latency = std::chrono::steady_clock::now() - *m_pendingInputTime;
+    m_inputToSubmitMs.push( std::chrono::duration<double, std::milli>( latency ).count() );
+    m_pendingInputTime.reset();
   }
 
   VkPresentInfoKHR presentInfo{};
@@ -1642,43 +2422,217 @@ void VulkanBase::drawFrame()
 
   presentInfo.pImageIndices = &imageIndex;
 
+  VkSwapchainPresentFenceInfoEXT presentFenceInfo{};
+  VkFence presentFence{ VK_NULL_HANDLE };
+  if ( m_swapchainMaintenance1 )
+  {
+    presentFence = acquirePresentFence();
+    presentFenceInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT;
+    presentFenceInfo.swapchainCount = 1;
+    presentFenceInfo.pFences = &presentFence;
+    presentInfo.pNext = &presentFenceInfo;
+    m_presentFences.push_back( { presentFence, m_swapChain } );
+  }
+
   vkQueuePresentKHR( m_presentQueue, &presentInfo );
+  retireSwapchains();
+
+  m_currentFrame = ( m_currentFrame + 1 ) % m_framesInFlight;
+}
+
+static bool isInputEvent( const SDL_Event& e )
+{
+  switch ( e.type )
+  {
+  case SDL_KEYDOWN:
+  case SDL_KEYUP:
+  case SDL_TEXTINPUT:
+  case SDL_MOUSEMOTION:
+  case SDL_MOUSEBUTTONDOWN:
+  case SDL_MOUSEBUTTONUP:
+  case SDL_MOUSEWHEEL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void VulkanBase::setLatencyMode( LatencyMode mode, bool capQueuedFrames )
+{
+  m_latencyMode = mode;
+  m_capQueuedFrames = capQueuedFrames;
+  m_inputToSubmitMs.clear();
+}
+
+void VulkanBase::pollEvents()
+{
+  SDL_Event e;
+  while ( SDL_PollEvent( &e ) )
+  {
+    if ( isInputEvent( e ) && !m_pendingInputTime )
+    {
+      // the event may have waited in the sdl queue for a while, its timestamp is in SDL_GetTicks milliseconds
+      auto queuedFor = std::chrono::milliseconds( SDL_GetTicks() - e.common.timestamp );
+      m_pendingInputTime = std::chrono::steady_clock::now() - queuedFor;
+    }
 
-  m_currentFrame = ( m_currentFrame + 1 ) % 2;
+    ImGui_ImplSDL2_ProcessEvent( &e );
+    switch ( e.type )
+    {
+    case SDL_KEYDOWN:
+      if ( e.key.keysym.scancode == SDL_SCANCODE_DELETE )
+      {
+        m_running = false;
+      }
+#ifdef ENABLE_CPU_PROFILER
+      if ( e.key.keysym.scancode == SDL_SCANCODE_F12 )
+      {
+        if ( CpuProfiler::writeChromeTrace( "cpu_trace.json" ) )
+          spdlog::info( "wrote cpu_trace.json" );
+        else
+          spdlog::warn( "could not write cpu_trace.json" );
+      }
+#endif
+      break;
+    case SDL_WINDOWEVENT:
+      if ( e.window.event == SDL_WINDOWEVENT_RESIZED )
+      {
+        recreateSwapchain();
+      }
+      break;
+    case SDL_QUIT:
+      m_running = false;
+    }
+  }
 }
 
 void VulkanBase::mainLoop()
 {
   while ( m_running )
   {
-    drawFrame();
-    SDL_Event e;
-    while ( SDL_PollEvent( &e ) )
+    if ( m_latencyMode == LatencyMode::LowLatency )
     {
-      ImGui_ImplSDL2_ProcessEvent( &e );
-      switch ( e.type )
+      waitForFrame();
+      pollEvents();
+      if ( m_running )
       {
-      case SDL_KEYDOWN:
-        if ( e.key.keysym.scancode == SDL_SCANCODE_DELETE )
-        {
-          m_running = false;
-        }
-        break;
-      case SDL_WINDOWEVENT:
-        if ( e.window.event == SDL_WINDOWEVENT_RESIZED )
-        {
-          recreateSwapchain();
-        }
-        break;
-      case SDL_QUIT:
-        m_running = false;
+        drawFrame();
       }
     }
+    else
+    {
+      drawFrame();
+      pollEvents();
+    }
+  }
+
+  vkDeviceWaitIdle( m_device );
+}
+
+void VulkanBase::drawOffscreenFrame()
+{
+  PROFILE_FUNCTION();
+  waitForFrame();
+
+  auto& frame = m_frames.at( m_currentFrame );
+  m_deletionQueue.collect();
+
+  updateResidency();
+  updateTextures( frame );
+  m_uploads.collect();
+  m_uploads.flush();
+
+  updateUniformBuffer( m_currentFrame );
+  vkResetCommandPool( m_device, frame.commandPool, 0 );
+  recordCommandBuffer( frame, 0 );
+
+  // nothing to acquire or present, the timeline value alone tracks the frame
+  frame.timelineValue = m_timeline.submit( m_graphicsQueue, { &frame.commandBuffer, 1 } );
+
+  m_currentFrame = ( m_currentFrame + 1 ) % m_framesInFlight;
+}
+
+void VulkanBase::headlessLoop()
+{
+  auto start = std::chrono::steady_clock::now();
+  for ( uint32_t i = 0; i < m_headlessConfig.frameCount; i++ )
+  {
+    drawOffscreenFrame();
+  }
+  m_timeline.waitIdle();
+
+  auto elapsed = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+  spdlog::info( "headless: {} frames in {:.2f} ms, {:.3f} ms per frame, record avg {:.3f} ms",
+                m_headlessConfig.frameCount,
+                elapsed,
+                elapsed / std::max( m_headlessConfig.frameCount, 1u ),
+                m_recordMs.average() );
+  for ( const auto& scope : m_gpuProfiler.scopes() )
+  {
+    spdlog::info( "gpu {}: avg {:.3f} ms, p99 {:.3f} ms", scope.name, scope.ms.average(), scope.ms.percentile( 99.0 ) );
+  }
+
+  if ( !m_headlessConfig.readbackPath.empty() )
+  {
+    readbackViewport( m_headlessConfig.readbackPath );
   }
 
   vkDeviceWaitIdle( m_device );
 }
 
+void VulkanBase::readbackViewport( const std::string& path )
+{
+  auto width = m_swapChainExtent.width;
+  auto height = m_swapChainExtent.height;
+  VkDeviceSize size = static_cast<VkDeviceSize>( width ) * height * 4;
+
+  VkBuffer readbackBuffer;
+  GpuAllocation readbackMemory;
+  createBuffer( size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::Readback, readbackBuffer, readbackMemory );
+
+  auto commandBuffer = beginSingleTimeCommands();
+
+  m_barriers.use( m_viewport.image, ImageUse::TransferSrc );
+  m_barriers.flush( commandBuffer );
+
+  VkBufferImageCopy region{};
+  region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+  region.imageExtent = { width, height, 1 };
+  vkCmdCopyImageToBuffer(
+    commandBuffer, m_viewport.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region );
+
+  // synchronization2 like the tracker's barriers in the same command buffer
+  VkBufferMemoryBarrier2 toHost{};
+  toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+  toHost.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+  toHost.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  toHost.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+  toHost.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+  toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.buffer = readbackBuffer;
+  toHost.size = VK_WHOLE_SIZE;
+
+  VkDependencyInfo dependency{};
+  dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+  dependency.bufferMemoryBarrierCount = 1;
+  dependency.pBufferMemoryBarriers = &toHost;
+  vkCmdPipelineBarrier2( commandBuffer, &dependency );
+
+  endSingleTimeCommands( commandBuffer );
+
+  // the offscreen target is R8G8B8A8 so the bytes go to the png as they are
+  auto written = stbi_write_png(
+    path.c_str(), static_cast<int>( width ), static_cast<int>( height ), 4, readbackMemory.mapped, width * 4 );
+  if ( written )
+    spdlog::info( "wrote {}", path );
+  else
+    spdlog::error( "could not write {}", path );
+
+  vkDestroyBuffer( m_device, readbackBuffer, nullptr );
+  m_allocator.free( readbackMemory );
+}
+
 void VulkanBase::setupDebug()
 {
   if ( !enableValidationLayers )
@@ -1750,8 +2704,12 @@ auto VulkanBase::findQueueFamilies( VkPhysicalDevice& device ) -> QueueFamilyInd
       indices.graphicsFamily = i;
     }
 
+    // there is no surface when headless, the present family is only there to satisfy isComplete
     VkBool32 presentSupport{ false };
-    vkGetPhysicalDeviceSurfaceSupportKHR( device, i, m_surface, &presentSupport );
+    if ( m_headless )
+      presentSupport = ( queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT ) != 0;
+    else
+      vkGetPhysicalDeviceSurfaceSupportKHR( device, i, m_surface, &presentSupport );
 
     if ( presentSupport )
     {
@@ -1764,36 +2722,99 @@ auto VulkanBase::findQueueFamilies( VkPhysicalDevice& device ) -> QueueFamilyInd
 
     i++;
   }
+
+  // a family that can copy but not draw is the dma engine on most discrete cards, uploads there run beside
+  // rendering, the fewer other capabilities the better and the graphics family is the fallback
+  uint32_t bestFlags = 0;
+  for ( uint32_t family = 0; family < queueFamilyCount; family++ )
+  {
+    auto flags = queueFamilies[family].queueFlags;
+    if ( !( flags & VK_QUEUE_TRANSFER_BIT ) || ( flags & VK_QUEUE_GRAPHICS_BIT ) )
+      continue;
+
+    auto extra = flags & ( VK_QUEUE_COMPUTE_BIT | VK_QUEUE_SPARSE_BINDING_BIT );
+    if ( !indices.transferFamily || std::popcount( extra ) < std::popcount( bestFlags ) )
+    {
+      indices.transferFamily = family;
+      bestFlags = extra;
+    }
+  }
+  if ( !indices.transferFamily )
+  {
+    indices.transferFamily = indices.graphicsFamily;
+  }
   return indices;
 }
 
 void VulkanBase::cleanup()
 {
-  ImGui_ImplVulkan_Shutdown();
-  ImGui_ImplSDL2_Shutdown();
-  ImGui::DestroyContext();
+  // the frame slots, uploads and the readback may all still be in flight
+  vkDeviceWaitIdle( m_device );
+
+  // presents may outlive vkDeviceWaitIdle, where there are present fences they say when the last ones are done
+  for ( const auto& present : m_presentFences )
+  {
+    vkWaitForFences( m_device, 1, &present.fence, VK_TRUE, UINT64_MAX );
+  }
+  for ( const auto& present : m_presentFences )
+  {
+    vkDestroyFence( m_device, present.fence, nullptr );
+  }
+  for ( auto fence : m_freePresentFences )
+  {
+    vkDestroyFence( m_device, fence, nullptr );
+  }
+  m_presentFences.clear();
+  m_freePresentFences.clear();
+  for ( auto& retired : m_retiredSwapchains )
+  {
+    destroyRetiredSwapchain( retired );
+  }
+  m_retiredSwapchains.clear();
+
+  // retired viewport textures are imgui descriptor sets, they go while imgui is still around
+  m_deletionQueue.flush();
+
+  if ( !m_headless )
+  {
+    ImGui_ImplVulkan_Shutdown();
+    ImGui_ImplSDL2_Shutdown();
+    ImGui::DestroyContext();
+    vkDestroyDescriptorPool( m_device, m_imguiPool, nullptr );
+  }
 
   cleanSwapchain();
-  vkDestroyBuffer( m_device, m_vertexBuffer, nullptr );
-  vkFreeMemory( m_device, m_vertexBufferMemory, nullptr );
-  vkFreeMemory( m_device, m_indicesBufferMemory, nullptr );
-  vkDestroyBuffer( m_device, m_indicesBuffer, nullptr );
 
+  // the frame slots hold descriptor sets from the pool below, so they go first
+  destroyFrameContexts();
+  vkDestroyCommandPool( m_device, m_commandPool, nullptr );
+  m_geometry.destroy();
+  for ( auto pipeline : m_scenePipelines )
+  {
+    vkDestroyPipeline( m_device, pipeline, nullptr );
+  }
+  vkDestroyPipelineLayout( m_device, m_pipelineLayout, nullptr );
+
+  // the table's layout holds the sampler as an immutable one
+  if ( m_bindless )
+  {
+    m_bindlessTable.destroy();
+  }
   vkDestroySampler( m_device, m_textureSampler, nullptr );
-  vkDestroyImage( m_device, m_textureImage, nullptr );
-  vkDestroyImageView( m_device, m_textureView, nullptr );
-  vkFreeMemory( m_device, m_textureImageMemory, nullptr );
+  m_textures.destroy();
 
-  for ( size_t i = 0; i < 3; i++ )
+  for ( auto semaphore : m_renderingFinishedSemaphores )
   {
-    vkDestroyBuffer( m_device, m_uniformBuffers[i], nullptr );
-    vkFreeMemory( m_device, m_uniformBuffersMemory[i], nullptr );
+    vkDestroySemaphore( m_device, semaphore, nullptr );
   }
 
   vkDestroyDescriptorPool( m_device, m_descriptorPool, nullptr );
-
   vkDestroyDescriptorSetLayout( m_device, m_descriptorSetLayout, nullptr );
 
+  m_gpuProfiler.destroy();
+  m_uploads.destroy();
+  m_allocator.destroy();
+  m_timeline.destroy();
   vkDestroyDevice( m_device, nullptr );
 
   if ( enableValidationLayers )
@@ -1803,22 +2824,41 @@ void VulkanBase::cleanup()
 
   vkDestroySurfaceKHR( m_instance, m_surface, nullptr );
   vkDestroyInstance( m_instance, nullptr );
-  SDL_DestroyWindow( window );
+  if ( window )
+  {
+    SDL_DestroyWindow( window );
+  }
 
   SDL_Quit();
 }
 
 auto VulkanBase::getRequiredExtensions() -> std::vector<const char*>
 {
+  // the surface extensions come from sdl, headless has no window to ask
   uint32_t extensionCount{ 0u };
-  SDL_Vulkan_GetInstanceExtensions( window, &extensionCount, nullptr );
+  if ( !m_headless )
+  {
+    SDL_Vulkan_GetInstanceExtensions( window, &extensionCount, nullptr );
+  }
   spdlog::info( extensionCount );
   std::vector<const char*> extensions( extensionCount );
-  SDL_Vulkan_GetInstanceExtensions( window, &extensionCount, extensions.data() );
+  if ( !m_headless )
+  {
+    SDL_Vulkan_GetInstanceExtensions( window, &extensionCount, extensions.data() );
+  }
 
   if ( enableValidationLayers )
     extensions.push_back( VK_EXT_DEBUG_UTILS_EXTENSION_NAME );
 
+  // VK_EXT_swapchain_maintenance1 needs these on the instance, it is only enabled when the device has it as well
+  m_surfaceMaintenance1 = !m_headless && hasInstanceExtension( VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME ) &&
+                          hasInstanceExtension( VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME );
+  if ( m_surfaceMaintenance1 )
+  {
+    extensions.push_back( VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME );
+    extensions.push_back( VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME );
+  }
+
   return extensions;
 }
 
@@ -1829,7 +2869,8 @@ void VulkanBase::createImage( uint32_t width,
                               VkImageUsageFlags usage,
                               VkMemoryPropertyFlags properties,
                               VkImage& image,
-                              VkDeviceMemory& imageMemory )
+                              GpuAllocation& imageMemory,
+                              uint32_t mipLevels )
 {
   VkImageCreateInfo imageInfo{};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1837,7 +2878,7 @@ void VulkanBase::createImage( uint32_t width,
   imageInfo.extent.width = width;
   imageInfo.extent.height = height;
   imageInfo.extent.depth = 1;
-  imageInfo.mipLevels = 1;
+  imageInfo.mipLevels = mipLevels;
   imageInfo.arrayLayers = 1;
   imageInfo.format = format;
   imageInfo.tiling = tiling;
@@ -1851,36 +2892,12 @@ void VulkanBase::createImage( uint32_t width,
     throw std::runtime_error( "failed to create image!" );
   }
 
-  VkMemoryRequirements memRequirements;
-  vkGetImageMemoryRequirements( m_device, image, &memRequirements );
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType( memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-
-  if ( vkAllocateMemory( m_device, &allocInfo, nullptr, &imageMemory ) != VK_SUCCESS )
-  {
-    throw std::runtime_error( "failed to allocate image memory!" );
-  }
-
-  vkBindImageMemory( m_device, image, imageMemory, 0 );
+  imageMemory = m_allocator.allocateImage( image, tiling, properties );
 }
 
 auto VulkanBase::findMemoryType( uint32_t typeFilter, VkMemoryPropertyFlags properties ) -> uint32_t
 {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties( m_physicalDevice, &memProperties );
-
-  for ( uint32_t i = 0; i < memProperties.memoryTypeCount; i++ )
-  {
-    if ( ( typeFilter & ( 1 << i ) ) && ( memProperties.memoryTypes[i].propertyFlags & properties ) == properties )
-    {
-      return i;
-    }
-  }
-
-  throw std::runtime_error( "failed to find suitable memory type!" );
+  return m_allocator.findMemoryType( typeFilter, properties );
 }
 
 auto VulkanBase::findSupportedFormat( const std::vector<VkFormat>& candidates,
@@ -1912,7 +2929,10 @@ auto VulkanBase::findDepthFormat() -> VkFormat
                               VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT );
 }
 
-auto VulkanBase::createImageView( VkImage image, VkFormat format, VkImageAspectFlags aspectFlags ) -> VkImageView
+auto VulkanBase::createImageView( VkImage image,
+                                  VkFormat format,
+                                  VkImageAspectFlags aspectFlags,
+                                  uint32_t mipLevels ) -> VkImageView
 {
   VkImageViewCreateInfo viewInfo{};
   viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -1921,7 +2941,7 @@ auto VulkanBase::createImageView( VkImage image, VkFormat format, VkImageAspectF
   viewInfo.format = format;
   viewInfo.subresourceRange.aspectMask = aspectFlags;
   viewInfo.subresourceRange.baseMipLevel = 0;
-  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.levelCount = mipLevels;
   viewInfo.subresourceRange.baseArrayLayer = 0;
   viewInfo.subresourceRange.layerCount = 1;
 
@@ -1,5 +1,10 @@
 #pragma once
 #include <array>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <optional>
+#include <string>
 #include <glm/glm.hpp>
 // #define GLFW_INCLUDE_VULKAN
 // #include <GLFW/glfw3.h>
@@ -12,60 +17,132 @@
 #include <imgui_impl_sdl2.h>
 #include <imgui_impl_vulkan.h>
 #include <imgui_internal.h>
+#include "barrier_tracker.hpp"
+#include "bindless_table.hpp"
+#include "cpu_profiler.hpp"
+#include "deletion_queue.hpp"
+#include "frame_stats.hpp"
+#include "geometry_pool.hpp"
+#include "gpu_allocator.hpp"
+#include "gpu_profiler.hpp"
+#include "linear_allocator.hpp"
+#include "render_graph.hpp"
+#include "residency_manager.hpp"
+#include "texture_loader.hpp"
+#include "timeline_scheduler.hpp"
+#include "upload_manager.hpp"
+#include "vertex_layout.hpp"
+#include "worker_pool.hpp"
 
 #define MAX_FRAMES_IN_FLIGHT 3
+// initial size per frame slot, room for 4096 draws at the common 256 byte uniform offset alignment, a slot whose draws
+// do not fit grows
+#define FRAME_UNIFORM_BYTES ( 1024 * 1024 )
 
-struct Viewport
+enum class LatencyMode
 {
-  VkImage image;
-  VkImageView imageView;
-  VkDeviceMemory memory;
+  // record and present first, drain input afterwards, input is at least one frame old when it gets recorded
+  Throughput,
+  // wait for the frame slot, then poll input, update and record, input is as fresh as the slot allows
+  LowLatency
 };
 
-struct UniformBufferoObject
+enum class RecordingMode
 {
-  glm::mat4 model;
-  glm::mat4 view;
-  glm::mat4 proj;
+  // everything is recorded on the main thread into the frame's primary buffer
+  Serial,
+  // scene draws are split over the worker pool into secondary buffers, the main thread builds imgui meanwhile
+  Parallel
 };
 
-struct Vertex
+// render into the viewport image without a window or swapchain, for tests on machines without a display
+struct HeadlessConfig
 {
-  glm::vec3 pos;
-  glm::vec3 color;
-  glm::vec2 texCoord;
-
-  static VkVertexInputBindingDescription getBindingDescription()
-  {
-    VkVertexInputBindingDescription bindingDescription{};
-    bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof( Vertex );
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  uint32_t width{ 1280u };
+  uint32_t height{ 720u };
+  uint32_t frameCount{ 100u };
+  // the last frame is written there as a png when it is not empty
+  std::string readbackPath;
+};
 
-    return bindingDescription;
-  }
+struct DrawCommand
+{
+  // the offsets into the geometry pool come from the mesh when the draw is recorded
+  MeshHandle mesh;
+  // placement of this draw, the animation is applied on top of it
+  glm::mat4 model{ 1.0f };
+  // only the bindless pipelines sample it, the per frame descriptor sets always hold the scene texture
+  TextureHandle texture{ 0u };
+};
 
-  static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
-  {
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+struct Viewport
+{
+  VkImage image;
+  VkImageView imageView;
+  GpuAllocation memory;
+};
 
-    attributeDescriptions[0].binding = 0;
-    attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[0].offset = offsetof( Vertex, pos );
+// everything a single frame slot owns, the cpu records into slot N while the gpu may still be busy with the
+// other slots of the ring
+struct FrameContext
+{
+  VkCommandPool commandPool{ VK_NULL_HANDLE };
+  VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+
+  // one pool and secondary buffer per worker, a pool is only ever touched by the task recording into it
+  std::vector<VkCommandPool> workerPools;
+  std::vector<VkCommandBuffer> workerCommandBuffers;
+
+  // how many of the worker buffers hold the scene pass and which scene generation they were recorded for
+  uint32_t sceneChunks{ 0u };
+  uint64_t sceneGeneration{ 0u };
+  // texture loader generation the descriptor set was written for
+  uint64_t textureGeneration{ 0u };
+
+  // this slot's uniform buffer, replaced by a larger one when the draws outgrow it, and the dynamic offset of every
+  // scene draw in it
+  VkBuffer uniformBuffer{ VK_NULL_HANDLE };
+  GpuAllocation uniformMemory;
+  LinearAllocator uniformAllocator;
+  std::vector<uint32_t> drawUniformOffsets;
+
+  VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+
+  // timeline value signaled when the last submission recorded from this slot retires
+  uint64_t timelineValue{ 0u };
+  VkSemaphore imageAvailableSemaphore{ VK_NULL_HANDLE };
+};
 
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset = offsetof( Vertex, color );
+// a swapchain recreateSwapchain replaced, presents queued to it may still wait on its semaphores after the frames
+// that rendered into it retired
+struct RetiredSwapchain
+{
+  VkSwapchainKHR swapchain{ VK_NULL_HANDLE };
+  std::vector<VkImageView> imageViews;
+  std::vector<VkSemaphore> renderingFinishedSemaphores;
+  // without present fences, frames still to be presented from newer swapchains before it goes to the deletion queue
+  uint32_t framesLeft{ 0u };
+};
 
-    attributeDescriptions[2].binding = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset = offsetof( Vertex, texCoord );
+struct PresentFence
+{
+  VkFence fence;
+  VkSwapchainKHR swapchain;
+};
 
-    return attributeDescriptions;
-  }
+struct UniformBufferoObject
+{
+  glm::mat4 model;
+  glm::mat4 view;
+  glm::mat4 proj;
+  // of the mesh being drawn, only the vertex shaders of quantized layouts read it
+  glm::vec4 dequantizeScale;
+  glm::vec4 dequantizeOffset;
+  // slot of the draw's texture in the bindless table, only the bindless fragment shader reads it
+  uint32_t textureIndex;
+  // the vertex shaders scale the unit meshes up by it before the model matrix
+  float meshExtent;
+  uint32_t padding[2];
 };
 
 const std::vector<Vertex> vertices = { { { -0.5f, -0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f } },
@@ -93,6 +170,8 @@ struct QueueFamilyIndices
 {
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
+  // not part of isComplete, falls back to the graphics family
+  std::optional<uint32_t> transferFamily;
 
   bool isComplete() const
   {
@@ -116,8 +195,8 @@ public:
   void initImgui();
   void recreateSwapchain();
 
-  void createVertexBuffer();
-  void createIndexBuffer();
+  // uploads the demo quads into the geometry pool, once in every vertex layout
+  void createSceneGeometry();
 
   // generic buffer funcs
   auto beginSingleTimeCommands() -> VkCommandBuffer;
@@ -125,64 +204,136 @@ public:
   //_______
 
   // images
-  void transitionImageLayout( VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout );
-  void copyBufferToImage( VkBuffer buffer, VkImage image, uint32_t width, uint32_t height );
-  void createTextureImageView();
-  void createTextureImage();
+  // starts decoding the scene texture, the block compressed test.ktx2 when the device can sample it
+  void loadTextures();
+  // lands finished decodes and points the frame's descriptor set, or the bindless table, at whatever changed since it
+  // was written
+  void updateTextures( FrameContext& frame );
   void createTextureSamplers();
   //___
 
-  void updateUniformBuffer( uint32_t imageIndex );
+  void updateUniformBuffer( uint32_t frameIndex );
 
   void createDescriptorSetLayout();
   void createDescriptorPool();
   void createDescriptorSets();
+  // binding 1 of a frame slot that is not in flight, its cached scene pass gets recorded again
+  void writeTextureDescriptors( FrameContext& frame );
+  // gives every texture whose view changed a new slot in the bindless table, the old slot is freed once the frames
+  // that may still read it have retired
+  void updateBindlessTextures();
+
+  // frame ring
+  void createFrameContexts();
+  void destroyFrameContexts();
+  void setFramesInFlight( uint32_t count );
+  //___
 
   void cleanSwapchain();
+  // once per present, hands the swapchains no present can still use to the deletion queue
+  void retireSwapchains();
+  void destroyRetiredSwapchain( RetiredSwapchain& retired );
+  auto acquirePresentFence() -> VkFence;
   void createSurface();
   void createSyncObj();
+  void createPresentSemaphores();
   void createLogicalDevice();
   void pickPhysicalDevice();
   bool isDeviceSuitable( VkPhysicalDevice& device );
   bool checkDeviceExtensionSupport( VkPhysicalDevice& device );
+  bool hasDeviceExtension( VkPhysicalDevice& device, const char* name );
+  bool hasInstanceExtension( const char* name );
 
   auto querySwapChainSupport( VkPhysicalDevice& device ) -> SwapChainSupportDetails;
   auto chooseSwapExtent( const VkSurfaceCapabilitiesKHR& capabilities ) -> VkExtent2D;
   auto chooseSwapPresentMode( const std::vector<VkPresentModeKHR>& availablePresentModes ) -> VkPresentModeKHR;
   auto chooseSwapSurfaceFormat( const std::vector<VkSurfaceFormatKHR>& availableFormats ) -> VkSurfaceFormatKHR;
-  void createSwapChain();
+  void createSwapChain( VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE );
   void createImageViews();
-  void createDepthResources();
 
   void createBuffer( VkDeviceSize size,
                      VkBufferUsageFlags usage,
-                     VkMemoryPropertyFlags properties,
+                     MemoryUsage memoryUsage,
                      VkBuffer& buffer,
-                     VkDeviceMemory& bufferMemory );
-
-  void copyBuffer( VkBuffer src, VkBuffer dst, VkDeviceSize size );
+                     GpuAllocation& bufferMemory );
 
   void run();
+  // has to be called before run()
+  void setHeadless( const HeadlessConfig& config );
   void frameRender( ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data );
   void framePresent( ImGui_ImplVulkanH_Window* wd );
   void initVulkan();
 
   void createUniformBuffers();
-
-  void recordCommandBuffer( VkCommandBuffer& commandBuffer, uint32_t imageIndex );
+  void createFrameUniforms( FrameContext& frame, VkDeviceSize bytes );
+  void destroyFrameUniforms( FrameContext& frame );
+  // the slot must not be in flight, its old buffer is destroyed right away and its set is rewritten
+  void growFrameUniforms( FrameContext& frame, VkDeviceSize bytes );
+
+  void buildImgui();
+  void recordScenePass( VkCommandBuffer cmd, const FrameContext& frame, size_t firstDraw, size_t drawCount );
+  void recordSceneChunk( FrameContext& frame, size_t chunk, size_t firstDraw, size_t drawCount, VkFormat depthFormat );
+  auto recordSceneSecondaries( FrameContext& frame, size_t maxChunks ) -> std::vector<std::future<void>>;
+  // anything baked into the recorded scene pass changed, every frame slot records it again
+  void invalidateScenePass();
+
+  // residency, the scene resources are evicted under memory pressure and reloaded the next frame they are drawn
+  void registerResidentResources();
+  // geometry pool pages created since the last call, addMesh may have opened new ones
+  void registerGeometryPages();
+  void updateResidency();
+  void setSceneDraws( std::vector<DrawCommand> draws );
+  auto sceneMesh( VertexLayout layout = VertexLayout::Standard ) const -> MeshHandle;
+  // into the geometry pool, quantized first for the compact layout, positions have to stay inside the unit cube
+  auto addSceneMesh( const std::vector<Vertex>& meshVertices,
+                     const std::vector<uint16_t>& meshIndices,
+                     VertexLayout layout ) -> MeshHandle;
+  // decoded like the scene texture but never streamed, only the bindless pipelines sample it through DrawCommand
+  auto loadSceneTexture( std::string path ) -> TextureHandle;
+  auto textureStats() const -> TextureStats;
+  // initial size of every frame slot's uniform buffer, has to be called before run(), slots grow past it as needed
+  void setFrameUniformBytes( VkDeviceSize bytes );
+  // fractions of each heap's budget, evicting starts above high and stops below low
+  void setResidencyWatermarks( double high, double low );
+  // animate by frame number instead of wall clock time
+  void setFixedTimestep( float seconds );
+
+  auto lastRecordMs() const -> double;
+  auto gpuProfiler() const -> const GpuProfiler&;
+  auto deviceName() const -> const char*;
+  void recordCommandBuffer( FrameContext& frame, uint32_t imageIndex );
+  // the passes of the render graph
+  void recordViewportPass( VkCommandBuffer cmd,
+                           FrameContext& frame,
+                           VkImageView depthView,
+                           bool sceneInSecondaries,
+                           std::vector<std::future<void>>& sceneTasks );
+  void recordPresentPass( VkCommandBuffer cmd, uint32_t imageIndex );
   void createCommandBuffer();
   void createCommandPool();
 
   void createGraphicsPipeline();
+  auto createScenePipeline( VertexLayout layout ) -> VkPipeline;
   auto createShaderModule( const std::vector<char>& code ) const -> VkShaderModule;
 
   void createImguiPipeline();
 
   void createInstance();
   void initWindow();
+  void waitForFrame();
   void drawFrame();
+  void pollEvents();
   void mainLoop();
 
+  // headless
+  void setupOffscreenTarget();
+  void drawOffscreenFrame();
+  void headlessLoop();
+  void readbackViewport( const std::string& path );
+  //___
+
+  void setLatencyMode( LatencyMode mode, bool capQueuedFrames = false );
+
   auto findQueueFamilies( VkPhysicalDevice& device ) -> QueueFamilyIndices;
 
   void cleanup();
@@ -229,7 +380,8 @@ public:
                     VkImageUsageFlags usage,
                     VkMemoryPropertyFlags properties,
                     VkImage& image,
-                    VkDeviceMemory& imageMemory );
+                    GpuAllocation& imageMemory,
+                    uint32_t mipLevels = 1 );
 
   auto findMemoryType( uint32_t typeFilter, VkMemoryPropertyFlags properties ) -> uint32_t;
 
@@ -239,7 +391,8 @@ public:
 
   auto findDepthFormat() -> VkFormat;
 
-  auto createImageView( VkImage image, VkFormat format, VkImageAspectFlags aspectFlags ) -> VkImageView;
+  auto createImageView( VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1 )
+    -> VkImageView;
 
   void DestroyDebugUtilsMessengerEXT( VkInstance instance,
                                       VkDebugUtilsMessengerEXT debugMessenger,
@@ -270,7 +423,7 @@ public:
   }
 
 private:
-  SDL_Window* window;
+  SDL_Window* window{ nullptr };
   VkInstance m_instance;
   VkDebugUtilsMessengerEXT debugMessenger;
 
@@ -282,60 +435,119 @@ private:
 
   VkQueue m_graphicsQueue;
   VkQueue m_presentQueue;
+  VkQueue m_transferQueue;
 
   // wd surface
-  VkSurfaceKHR m_surface;
+  VkSurfaceKHR m_surface{ VK_NULL_HANDLE };
 
-  VkSwapchainKHR m_swapChain;
+  VkSwapchainKHR m_swapChain{ VK_NULL_HANDLE };
   std::vector<VkImage> m_swapChainImages;
 
-  VkImage m_depthImage;
-  VkImageView m_depthView;
-  VkDeviceMemory m_depthMemory;
-
   VkFormat m_swapChainImageFormat;
   VkExtent2D m_swapChainExtent;
   std::vector<VkImageView> m_swapChainImageViews;
   VkDescriptorSetLayout m_descriptorSetLayout;
 
-  VkPipeline m_graphicsPipeline;
+  // indexed by VertexLayout
+  std::array<VkPipeline, vertexLayoutCount> m_scenePipelines{};
   VkPipelineLayout m_pipelineLayout;
 
   VkPipeline m_imguiPipeline;
   VkPipelineLayout m_imguiPipelineLayout;
 
   VkCommandPool m_commandPool;
-  std::vector<VkCommandBuffer> m_commandBuffers;
 
-  // sync
-  std::vector<VkSemaphore> m_imageAvailableSemaphores;
-  std::vector<VkSemaphore> m_renderingFinishedSemaphores;
-  std::vector<VkFence> m_inFlightFences;
-  std::vector<VkFence> m_imagesInFlight;
+  // frame ring, m_framesInFlight slots are live, the requested depth is applied at the start of the next frame
+  std::vector<FrameContext> m_frames;
+  VkDeviceSize m_uniformBytesUsed{ 0u };
+  // raised to the largest slot buffer so far, a rebuilt ring starts out with room for the draws it had
+  VkDeviceSize m_frameUniformBytes{ FRAME_UNIFORM_BYTES };
+  uint32_t m_framesInFlight{ MAX_FRAMES_IN_FLIGHT };
+  uint32_t m_requestedFramesInFlight{ MAX_FRAMES_IN_FLIGHT };
 
-  VkBuffer m_vertexBuffer;
-  VkDeviceMemory m_vertexBufferMemory;
-
-  VkBuffer m_indicesBuffer;
-  VkDeviceMemory m_indicesBufferMemory;
-
-  VkBuffer m_stageBuffer;
-  VkDeviceMemory m_stageBufferMemory;
-  VkImage m_textureImage;
-  VkDeviceMemory m_textureImageMemory;
-  VkImageView m_textureView;
+  // sync, these belong to the swapchain images and not to the frame slots
+  std::vector<VkSemaphore> m_renderingFinishedSemaphores;
+  std::vector<uint64_t> m_imagesInFlight;
+  std::vector<RetiredSwapchain> m_retiredSwapchains;
+  // VK_EXT_swapchain_maintenance1 signals one of these per present, oldest first, signaled ones are reused
+  bool m_surfaceMaintenance1{ false };
+  bool m_swapchainMaintenance1{ false };
+  std::deque<PresentFence> m_presentFences;
+  std::vector<VkFence> m_freePresentFences;
+
+  // every graphics queue submission signals this
+  TimelineScheduler m_timeline;
+  // layouts of the viewport, depth and swapchain images across the frames recorded so far
+  BarrierTracker m_barriers;
+  // resources the frames in flight may still use, destroyed once their timeline value retires
+  DeletionQueue m_deletionQueue;
+  // declared by recordCommandBuffer every frame, owns the transient depth image
+  RenderGraph m_renderGraph;
+  GpuAllocator m_allocator;
+  UploadManager m_uploads;
+  ResidencyManager m_residency;
+  ResidencyHandle m_textureResidency{};
+  // indexed by geometry pool page
+  std::vector<ResidencyHandle> m_pageResidency;
+  float m_residencyHighWatermark{ 0.9f };
+  GpuProfiler m_gpuProfiler;
+
+  std::vector<DrawCommand> m_sceneDraws;
+  RecordingMode m_recordingMode{ RecordingMode::Serial };
+  bool m_cacheScenePass{ true };
+  // starts above the frame slots' 0 so a fresh slot always records
+  uint64_t m_sceneGeneration{ 1u };
+  uint64_t m_sceneRecordCount{ 0u };
+  WorkerPool m_workers;
+  RollingStats<256> m_recordMs;
+
+  // vertices and indices of every mesh, draws bind a page once and carry their offsets into it
+  GeometryPool m_geometry;
+  std::array<MeshHandle, vertexLayoutCount> m_sceneMeshes{};
+  // pages the scene draws read, each frame uses every one of them
+  std::vector<uint32_t> m_scenePages;
+  // what the stats window asks for and what the demo draw list uses, drawFrame applies the change at its top
+  bool m_compactVertices{ false };
+  VertexLayout m_sceneLayout{ VertexLayout::Standard };
+
+  TextureLoader m_textures;
+  TextureHandle m_sceneTexture{};
+  // streamed textures together, the slider in the stats window moves it
+  int m_textureBudgetMb{ static_cast<int>( TextureLoader::defaultStreamingBudget / ( 1024 * 1024 ) ) };
   VkSampler m_textureSampler;
-
-  std::vector<VkBuffer> m_uniformBuffers;
-  std::vector<VkDeviceMemory> m_uniformBuffersMemory;
-  std::vector<void*> m_uniformBuffersMapped;
+  // enabled on the device when it supports it, the sampler uses the device's limit
+  bool m_samplerAnisotropy{ false };
+  // the BC formats can only be sampled when the device enables them
+  bool m_textureCompressionBC{ false };
+  // set 1 of the scene pipelines when the device supports descriptor indexing, the draws pick their texture out of
+  // it by index and the per frame sets only carry the uniforms
+  bool m_bindless{ false };
+  BindlessTable m_bindlessTable;
+  // indexed by TextureHandle, the slot of each texture and the view it was written with
+  std::vector<BindlessIndex> m_textureSlots;
+  std::vector<VkImageView> m_slotViews;
 
   VkDescriptorPool m_descriptorPool;
-  VkDescriptorPool m_imguiPool;
-  std::vector<VkDescriptorSet> m_descriptorSets;
+  VkDescriptorPool m_imguiPool{ VK_NULL_HANDLE };
   uint32_t m_currentFrame{ 0u };
 
   Viewport m_viewport;
+  // imgui's descriptor set for the viewport image, made on first use
+  VkDescriptorSet m_viewportTexture{ VK_NULL_HANDLE };
+  uint32_t m_swapchainRecreations{ 0u };
 
   bool m_running{ true };
+
+  bool m_headless{ false };
+  HeadlessConfig m_headlessConfig;
+  std::optional<float> m_fixedTimestep;
+  uint64_t m_frameNumber{ 0u };
+
+  // latency
+  LatencyMode m_latencyMode{ LatencyMode::Throughput };
+  // only the frame being recorded is queued on the gpu, trades throughput for the freshest input
+  bool m_capQueuedFrames{ false };
+  // when the oldest input event not yet seen by a submitted frame was generated
+  std::optional<std::chrono::steady_clock::time_point> m_pendingInputTime;
+  RollingStats<256> m_inputToSubmitMs;
 };
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "worker_pool.hpp"
+#include <algorithm>
+#include "cpu_profiler.hpp"
+
+WorkerPool::WorkerPool( size_t threadCount )
+{
+  if ( threadCount == 0 )
+  {
+    auto cores = static_cast<size_t>( std::thread::hardware_concurrency() );
+    threadCount = std::max<size_t>( cores, 2 ) - 1;
+  }
+
+  m_threads.reserve( threadCount );
+  for ( size_t i = 0; i < threadCount; i++ )
+  {
+    m_threads.emplace_back( [this]() { workerLoop(); } );
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard lock{ m_mutex };
+    m_stopping = true;
+  }
+  m_condition.notify_all();
+
+  for ( auto& thread : m_threads )
+  {
+    thread.join();
+  }
+}
+
+auto WorkerPool::size() const -> size_t
+{
+  return m_threads.size();
+}
+
+void WorkerPool::parallelFor( size_t count, const std::function<void( size_t )>& func )
+{
+  std::vector<std::future<void>> futures;
+  futures.reserve( count );
+  for ( size_t i = 0; i < count; i++ )
+  {
+    futures.push_back( submit( [&func, i]() { func( i ); } ) );
+  }
+
+  waitAll( futures );
+}
+
+void WorkerPool::waitAll( std::vector<std::future<void>>& futures )
+{
+  for ( auto& future : futures )
+  {
+    future.wait();
+  }
+  for ( auto& future : futures )
+  {
+    future.get();
+  }
+}
+
+void WorkerPool::workerLoop()
+{
+  PROFILE_THREAD( "worker" );
+
+  while ( true )
+  {
+    std::function<void()> task;
+    {
+      std::unique_lock lock{ m_mutex };
+      m_condition.wait( lock, [this]() { return m_stopping || !m_tasks.empty(); } );
+      if ( m_stopping && m_tasks.empty() )
+        return;
+
+      task = std::move( m_tasks.front() );
+      m_tasks.pop();
+    }
+    task();
+  }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads pulling tasks from a shared queue
+class WorkerPool
+{
+public:
+  // 0 picks one thread per core, leaving one for the main thread
+  explicit WorkerPool( size_t threadCount = 0 );
+  ~WorkerPool();
+
+  WorkerPool( const WorkerPool& ) = delete;
+  WorkerPool& operator=( const WorkerPool& ) = delete;
+
+  auto size() const -> size_t;
+
+  template <typename Func>
+  auto submit( Func&& func ) -> std::future<std::invoke_result_t<Func>>
+  {
+    using Result = std::invoke_result_t<Func>;
+    auto task = std::make_shared<std::packaged_task<Result()>>( std::forward<Func>( func ) );
+    auto future = task->get_future();
+    {
+      std::lock_guard lock{ m_mutex };
+      m_tasks.emplace( [task]() { ( *task )(); } );
+    }
+    m_condition.notify_one();
+    return future;
+  }
+
+  // runs func( i ) for every i in [0, count) and blocks until all of them are done, rethrows the first exception
+  void parallelFor( size_t count, const std::function<void( size_t )>& func );
+
+  // waits for every future before rethrowing, so nothing is left running that references the caller's stack
+  static void waitAll( std::vector<std::future<void>>& futures );
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> m_threads;
+  std::queue<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stopping{ false };
+};